@@ -0,0 +1,303 @@
+//! Micro-benchmarks of the REPRL harness in src/reprl/reprl.c.
+//!
+//! The benchmark binary is its own engine: the workers start it again with
+//! REPRL_HARNESS_CHILD set and it then speaks the plain HELO/cexe protocol and
+//! writes synthetic coverage into struct shmem_data. That way only the cost of
+//! the harness is measured, not the one of a JavaScript engine.
+//!
+//!     cargo bench --bench reprl_harness
+//!
+//! HARNESS_EDGES sets the number of edges of the fake engine (default 1 << 20),
+//! HARNESS_SECONDS the duration of every throughput run (default 1) and
+//! HARNESS_MAX_WORKERS the largest worker count of the scaling run (default 128).
+//!
+//! A script "d <permille>" makes the fake engine hit that fraction of all edges,
+//! "d 0" hits none.
+
+use std::collections::HashMap;
+use std::ffi::CString;
+use std::ptr;
+use std::time::{Duration, Instant};
+
+const CHILD_ENV: &str = "REPRL_HARNESS_CHILD";
+const CTRL_IN: i32 = 100;   // REPRL_CHILD_CTRL_IN
+const CTRL_OUT: i32 = 101;  // REPRL_CHILD_CTRL_OUT
+const DATA_IN: i32 = 102;   // REPRL_CHILD_DATA_IN
+const TIMEOUT_MS: i32 = 1000;
+const DENSITIES: [u32; 5] = [1, 10, 100, 500, 1000];
+
+// Mirrors struct edge_set in reprl.h
+#[repr(C)]
+struct EdgeSet {
+    count: u32,
+    edge_indices: *mut u32,
+}
+
+// Mirrors struct reprl_config in reprl.h
+#[repr(C)]
+struct ReprlConfig {
+    engine: *const i8,
+    binary: *const i8,
+    extra_args: *const *const i8,
+    wasm_baseline: i32,
+    print_bytecode: i32,
+    capture_stdout: i32,
+    capture_stderr: i32,
+    spawn_timeout_ms: i32,
+    channel_capacity: [u64; 4],
+}
+
+// src/build.rs only links the reprl static library into the dfuzz lib, which this benchmark does not use
+#[link(name = "reprl", kind = "static")]
+unsafe extern "C" {
+    fn reprl_init_with_config(worker_id: i32, config: *const ReprlConfig) -> i32;
+    fn spawn(worker_id: i32);
+    fn execute_script(script: *mut i8, timeout: i32, fresh_instance: i32, worker_id: i32) -> i32;
+    fn cov_evaluate(worker_id: usize, edges: *mut EdgeSet) -> i32;
+    fn coverage_clear_bitmap(worker_id: i32);
+    fn coverage_finish_initialization(worker_id: usize, should_track_edges: i32);
+}
+
+fn env_or<T: std::str::FromStr>(name: &str, default: T) -> T {
+    std::env::var(name).ok().and_then(|v| v.parse().ok()).unwrap_or(default)
+}
+
+fn main() {
+    if std::env::var_os(CHILD_ENV).is_some() {
+        fake_engine();
+    }
+    let num_edges: u32 = env_or("HARNESS_EDGES", 1 << 20);
+    let seconds: f64 = env_or("HARNESS_SECONDS", 1.0);
+    let max_workers: usize = env_or("HARNESS_MAX_WORKERS", 128);
+    let duration = Duration::from_secs_f64(seconds);
+
+    // Inherited by the engines through the environment copied in reprl_init_with_config
+    std::env::set_var(CHILD_ENV, "1");
+    std::env::set_var("HARNESS_EDGES", num_edges.to_string());
+    let binary = CString::new(std::env::current_exe().unwrap().to_string_lossy().as_bytes()).unwrap();
+    let engine = CString::new("v8").unwrap();
+
+    let mut init_times = Vec::new();
+    for worker_id in 0..max_workers.max(1) {
+        let start = Instant::now();
+        init_worker(worker_id, &engine, &binary);
+        init_times.push(start.elapsed());
+    }
+
+    println!();
+    println!("[HARNESS] {} edges, {} byte bitmap, {:.1}s per run", num_edges, num_edges.div_ceil(8), seconds);
+    report_latency("init + spawn", &mut init_times);
+
+    let script = CString::new("d 0").unwrap();
+    let mut latencies = Vec::new();
+    let start = Instant::now();
+    while start.elapsed() < duration {
+        let before = Instant::now();
+        run(&script, 0, 0);
+        latencies.push(before.elapsed());
+    }
+    println!("[HARNESS] 1 worker: {:.0} execs/s", latencies.len() as f64 / start.elapsed().as_secs_f64());
+    report_latency("reprl_execute round trip", &mut latencies);
+
+    let mut respawns = Vec::new();
+    let start = Instant::now();
+    while start.elapsed() < duration {
+        let before = Instant::now();
+        run(&script, 1, 0);
+        respawns.push(before.elapsed());
+    }
+    report_latency("respawn + execute", &mut respawns);
+
+    let bitmap_bytes = num_edges.div_ceil(8) as f64;
+    for permille in DENSITIES {
+        let script = CString::new(format!("d {}", permille)).unwrap();
+        // The first evaluation records the edges as seen, the timed ones only scan the bitmap
+        run(&script, 0, 0);
+        let mut edges = EdgeSet { count: 0, edge_indices: ptr::null_mut() };
+        unsafe { cov_evaluate(0, &mut edges) };
+
+        let mut evaluations = 0u64;
+        let start = Instant::now();
+        while start.elapsed() < duration {
+            for _ in 0..64 {
+                unsafe { cov_evaluate(0, &mut edges) };
+            }
+            evaluations += 64;
+        }
+        let evaluate = start.elapsed().as_secs_f64() / evaluations as f64;
+
+        // Every clear gets a bitmap filled by a real execution, only the clear itself is timed
+        let mut clears = 0u64;
+        let mut clear_time = Duration::ZERO;
+        let start = Instant::now();
+        while start.elapsed() < duration {
+            run(&script, 0, 0);
+            let before = Instant::now();
+            unsafe { coverage_clear_bitmap(0) };
+            clear_time += before.elapsed();
+            clears += 1;
+        }
+        let clear = clear_time.as_secs_f64() / clears as f64;
+
+        println!(
+            "[HARNESS] density {:>5.1}%: internal_evaluate {:>8.2}us ({:>6.2} GB/s), coverage_clear_bitmap {:>8.2}us ({:>6.2} GB/s)",
+            permille as f64 / 10.0,
+            evaluate * 1e6,
+            bitmap_bytes / evaluate / 1e9,
+            clear * 1e6,
+            bitmap_bytes / clear / 1e9,
+        );
+    }
+
+    let mut workers = 1;
+    while workers <= max_workers {
+        let deadline = Instant::now() + duration;
+        let start = Instant::now();
+        let executions: u64 = std::thread::scope(|scope| {
+            let threads: Vec<_> = (0..workers)
+                .map(|worker_id| {
+                    let script = &script;
+                    scope.spawn(move || {
+                        let mut executions = 0u64;
+                        while Instant::now() < deadline {
+                            run(script, 0, worker_id);
+                            executions += 1;
+                        }
+                        executions
+                    })
+                })
+                .collect();
+            threads.into_iter().map(|thread| thread.join().unwrap()).sum()
+        });
+        let rate = executions as f64 / start.elapsed().as_secs_f64();
+        println!("[HARNESS] {:>3} workers: {:>10.0} execs/s, {:>8.0} per worker", workers, rate, rate / workers as f64);
+        workers *= 2;
+    }
+}
+
+fn init_worker(worker_id: usize, engine: &CString, binary: &CString) {
+    let config = ReprlConfig {
+        engine: engine.as_ptr(),
+        binary: binary.as_ptr(),
+        extra_args: ptr::null(),
+        wasm_baseline: 0,
+        print_bytecode: 0,
+        capture_stdout: 0,
+        capture_stderr: 0,
+        spawn_timeout_ms: 0,
+        channel_capacity: [0; 4],
+    };
+    unsafe {
+        if reprl_init_with_config(worker_id as i32, &config) != 0 {
+            panic!("Failed to initialize worker {}", worker_id);
+        }
+        spawn(worker_id as i32);
+        coverage_finish_initialization(worker_id, 0);
+    }
+}
+
+fn run(script: &CString, fresh_instance: i32, worker_id: usize) {
+    let status = unsafe { execute_script(script.as_ptr() as *mut i8, TIMEOUT_MS, fresh_instance, worker_id as i32) };
+    if status != 0 {
+        panic!("Fake engine of worker {} returned status {}", worker_id, status);
+    }
+}
+
+fn report_latency(name: &str, samples: &mut [Duration]) {
+    if samples.is_empty() {
+        return;
+    }
+    samples.sort();
+    let mean = samples.iter().sum::<Duration>() / samples.len() as u32;
+    let percentile = |p: f64| samples[((samples.len() - 1) as f64 * p) as usize];
+    println!(
+        "[HARNESS] {}: mean {:?}, p50 {:?}, p99 {:?}, max {:?} ({} samples)",
+        name, mean, percentile(0.5), percentile(0.99), samples[samples.len() - 1], samples.len()
+    );
+}
+
+fn read_exact(fd: i32, buf: &mut [u8]) {
+    let mut done = 0;
+    while done < buf.len() {
+        let n = unsafe { libc::read(fd, buf[done..].as_mut_ptr() as *mut libc::c_void, buf.len() - done) };
+        if n <= 0 {
+            // The harness went away
+            unsafe { libc::_exit(0) };
+        }
+        done += n as usize;
+    }
+}
+
+fn write_all(fd: i32, buf: &[u8]) {
+    if unsafe { libc::write(fd, buf.as_ptr() as *const libc::c_void, buf.len()) } != buf.len() as isize {
+        unsafe { libc::_exit(1) };
+    }
+}
+
+/// The fake engine. Edge i is hit by "d <permille>" if a hash of i falls below the permille,
+/// so every density hits the same edges on every execution.
+fn fake_engine() -> ! {
+    let num_edges: u32 = env_or("HARNESS_EDGES", 1 << 20);
+    let shm_size: usize = env_or("SHM_SIZE", 0x100000);
+    let shm_name = CString::new(std::env::var("SHM_ID").expect("SHM_ID is not set")).unwrap();
+    let shm = unsafe {
+        let fd = libc::shm_open(shm_name.as_ptr(), libc::O_RDWR, 0o600);
+        let ptr = libc::mmap(ptr::null_mut(), shm_size, libc::PROT_READ | libc::PROT_WRITE, libc::MAP_SHARED, fd, 0);
+        if fd < 0 || ptr == libc::MAP_FAILED {
+            libc::_exit(2);
+        }
+        ptr as *mut u8
+    };
+    let num_edges = num_edges.min(((shm_size - 4) * 8) as u32);
+    // struct shmem_data: num_edges followed by the edge bitmap
+    unsafe { (shm as *mut u32).write(num_edges) };
+    let edges = unsafe { std::slice::from_raw_parts_mut(shm.add(4), num_edges.div_ceil(8) as usize) };
+
+    write_all(CTRL_OUT, b"HELO");
+    let mut helo = [0u8; 4];
+    read_exact(CTRL_IN, &mut helo);
+
+    // Permille -> non-zero bytes of the bitmap
+    let mut patterns: HashMap<u32, Vec<(u32, u8)>> = HashMap::new();
+    let mut script = Vec::new();
+    loop {
+        let mut command = [0u8; 4];
+        read_exact(CTRL_IN, &mut command);
+        if &command != b"cexe" {
+            unsafe { libc::_exit(6) };
+        }
+        let mut length = [0u8; 8];
+        read_exact(CTRL_IN, &mut length);
+        script.resize(u64::from_le_bytes(length) as usize, 0);
+        read_exact(DATA_IN, &mut script);
+
+        let permille = std::str::from_utf8(&script).ok()
+            .and_then(|s| s.trim_end_matches('\0').strip_prefix("d "))
+            .and_then(|s| s.trim().parse::<u32>().ok())
+            .unwrap_or(0);
+        let pattern = patterns.entry(permille).or_insert_with(|| density_pattern(num_edges, permille));
+        for &(offset, value) in pattern.iter() {
+            edges[offset as usize] |= value;
+        }
+        write_all(CTRL_OUT, &0i32.to_le_bytes());
+    }
+}
+
+fn density_pattern(num_edges: u32, permille: u32) -> Vec<(u32, u8)> {
+    let mut pattern: Vec<(u32, u8)> = Vec::new();
+    if permille == 0 {
+        return pattern;
+    }
+    for edge in 0..num_edges {
+        let hash = (edge as u64).wrapping_add(1).wrapping_mul(0x9E3779B97F4A7C15) >> 32;
+        if hash % 1000 >= permille as u64 {
+            continue;
+        }
+        let offset = edge / 8;
+        match pattern.last_mut() {
+            Some((last, value)) if *last == offset => *value |= 1 << (edge % 8),
+            _ => pattern.push((offset, 1 << (edge % 8))),
+        }
+    }
+    pattern
+}
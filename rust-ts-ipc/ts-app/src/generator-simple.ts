@@ -6,7 +6,7 @@
  */
 
 import * as readline from 'readline';
-import { spawn } from 'child_process';
+import { spawn, ChildProcess } from 'child_process';
 import * as path from 'path';
 import * as fs from 'fs';
 
@@ -23,6 +23,17 @@ const rl = readline.createInterface({
 
 let isGenerating = false;
 let generatedCount = 0;
+// The generator of the running batch, killed on stop
+let generatorProcess: ChildProcess | null = null;
+
+// With GENERATOR_FRAMES=1 everything sent to Rust is a binary frame instead of a JSON line:
+// a 20 byte header of little-endian u32 (kind, batch, id, length of the first part, length of the second part)
+// followed by both parts. Test cases carry code and state as raw UTF-8, so no JSON escaping is needed.
+// batch is the one of the generate request, so Rust can drop what is left of a batch it gave up on.
+const binaryFrames = process.env.GENERATOR_FRAMES === '1';
+const FRAME_TEST_CASE = 1;
+const FRAME_MESSAGE = 2;
+const FRAME_HEADER_SIZE = 20;
 
 console.error('[Generator] Simple generator bridge started');
 
@@ -51,12 +62,13 @@ rl.on('line', async (line: string) => {
                     sendMessage({
                         msg_type: 'error',
                         data: 'Generation already in progress'
-                    });
+                    }, msg.data?.batch || 0);
                 }
                 break;
                 
             case 'stop':
                 // Force reset generation state
+                stopGenerator();
                 isGenerating = false;
                 generatedCount = 0;
                 sendMessage({
@@ -80,6 +92,7 @@ rl.on('line', async (line: string) => {
                 
             case 'exit':
                 console.error('[Generator] Exiting');
+                stopGenerator();
                 process.exit(0);
                 break;
                 
@@ -122,8 +135,25 @@ function parseConsoleOutput(buffer: string, testCases: Array<{id: number, filena
     }
 }
 
+// Kills the generator of the running batch together with the processes it started (npx starts tsx)
+function stopGenerator() {
+    if (generatorProcess === null) {
+        return;
+    }
+    const child = generatorProcess;
+    generatorProcess = null;
+    try {
+        if (child.pid !== undefined) {
+            process.kill(-child.pid, 'SIGKILL');
+        }
+    } catch (e) {
+        child.kill('SIGKILL');
+    }
+}
+
 function generateTestCases(request: any) {
     const count = request.count || 10;
+    const batch = request.batch || 0;
     const outputDir = request.outputDir || './generated';
     
     // Ensure output directory exists
@@ -133,8 +163,17 @@ function generateTestCases(request: any) {
     
     const startTime = Date.now();
     
-    // Spawn the actual generator
-    const generatorProcess = spawn('npx', [
+    // Comparison operands the fuzzer saw (CmpDictionary in src/cmplog.rs). The generator finds them as a
+    // JSON array of JS literals in the file named by GENERATOR_DICTIONARY.
+    const env = { ...process.env };
+    if (Array.isArray(request.dictionary) && request.dictionary.length > 0) {
+        const dictionaryFile = path.join(outputDir, 'dictionary.json');
+        fs.writeFileSync(dictionaryFile, JSON.stringify(request.dictionary));
+        env.GENERATOR_DICTIONARY = dictionaryFile;
+    }
+    
+    // Spawn the actual generator, in a process group of its own so stopGenerator() reaches all of it
+    const child = spawn('npx', [
         'tsx',
         'src/index.ts',
         '--count', String(count),
@@ -144,17 +183,31 @@ function generateTestCases(request: any) {
         '--export-mutation', '--console-output'
     ], {
         cwd: "/Users/t/gen3mutator/gen3",
-        stdio: ['ignore', 'pipe', 'pipe']
+        env,
+        stdio: ['ignore', 'pipe', 'pipe'],
+        detached: true
     });
+    generatorProcess = child;
     
     let outputBuffer = '';
     let testCases: Array<{id: number, filename: string, code: string, state: string}> = [];
+    // Test cases are sent as soon as they are parsed, so the fuzzer can execute while we generate
+    let sentCount = 0;
+    const sendParsed = () => {
+        while (sentCount < testCases.length) {
+            sendTestCase(testCases[sentCount++], batch);
+        }
+    };
     
-    generatorProcess.stdout.on('data', (data) => {
+    child.stdout!.on('data', (data) => {
+        if (generatorProcess !== child) {
+            return;
+        }
         outputBuffer += data.toString();
         
         // Parse JS content and mutation JSON from console output
         parseConsoleOutput(outputBuffer, testCases, count);
+        sendParsed();
         
         // Send progress updates
         if (testCases.length > generatedCount) {
@@ -166,14 +219,19 @@ function generateTestCases(request: any) {
                         generated: generatedCount,
                         total: count
                     }
-                });
+                }, batch);
             }
         }
     });
     
   
     
-    generatorProcess.on('close', (code) => {
+    child.on('close', (code) => {
+        // A stopped batch already handed the state over to the next one
+        if (generatorProcess !== child) {
+            return;
+        }
+        generatorProcess = null;
         const elapsedTime = (Date.now() - startTime) / 1000;
         
         if (code === 0) {
@@ -181,18 +239,8 @@ function generateTestCases(request: any) {
                 // Parse any remaining content in the buffer
                 parseConsoleOutput(outputBuffer, testCases, count);
                 
-                // Send test cases from parsed console output
-                testCases.forEach((testCase) => {
-                    sendMessage({
-                        msg_type: 'test_case',
-                        data: {
-                            id: testCase.id,
-                            filename: testCase.filename,
-                            code: testCase.code,
-                            state: testCase.state
-                        }
-                    });
-                });
+                // Send the test cases that were not sent while parsing
+                sendParsed();
                 
                 // Send completion
                 sendMessage({
@@ -203,36 +251,74 @@ function generateTestCases(request: any) {
                         rate: testCases.length / elapsedTime,
                         outputDir
                     }
-                });
+                }, batch);
             } catch (error) {
                 sendMessage({
                     msg_type: 'error',
                     data: `Failed to parse generated content: ${error}`
-                });
+                }, batch);
             }
         } else {
             sendMessage({
                 msg_type: 'error',
                 data: `Generator exited with code ${code}`
-            });
+            }, batch);
         }
         
         isGenerating = false;
     });
     
-    generatorProcess.on('error', (error) => {
+    child.on('error', (error) => {
+        if (generatorProcess !== child) {
+            return;
+        }
+        generatorProcess = null;
         sendMessage({
             msg_type: 'error',
             data: `Failed to start generator: ${error.message}`
-        });
+        }, batch);
         isGenerating = false;
     });
 }
 
-function sendMessage(msg: Message) {
-    console.log(JSON.stringify(msg));
+function sendFrame(kind: number, batch: number, id: number, first: string, second: string) {
+    const firstBytes = Buffer.from(first, 'utf8');
+    const secondBytes = Buffer.from(second, 'utf8');
+    const header = Buffer.alloc(FRAME_HEADER_SIZE);
+    header.writeUInt32LE(kind, 0);
+    header.writeUInt32LE(batch, 4);
+    header.writeUInt32LE(id, 8);
+    header.writeUInt32LE(firstBytes.length, 12);
+    header.writeUInt32LE(secondBytes.length, 16);
+    process.stdout.write(Buffer.concat([header, firstBytes, secondBytes]));
+}
+
+function sendTestCase(testCase: {id: number, filename: string, code: string, state: string}, batch: number) {
+    if (binaryFrames) {
+        sendFrame(FRAME_TEST_CASE, batch, testCase.id, testCase.code, testCase.state);
+        return;
+    }
+    sendMessage({
+        msg_type: 'test_case',
+        data: {
+            batch,
+            id: testCase.id,
+            filename: testCase.filename,
+            code: testCase.code,
+            state: testCase.state
+        }
+    });
+}
+
+function sendMessage(msg: Message, batch: number = 0) {
+    if (binaryFrames) {
+        sendFrame(FRAME_MESSAGE, batch, 0, JSON.stringify(msg), '');
+    } else {
+        console.log(JSON.stringify(msg));
+    }
 }
 
 process.on('SIGINT', () => {
+    stopGenerator();
     process.exit(0);
 });
\ No newline at end of file
@@ -0,0 +1,94 @@
+use std::collections::{HashSet, VecDeque};
+use crate::coverage::*;
+
+/// Comparison operands of this worker's executions, handed to the generator as literals.
+///
+/// The engine logs the operands of its comparisons into the ring of struct shmem_cmplog
+/// (REPRL_CMPLOG=1). The C core drains the ring and drops operand pairs it handed out before,
+/// this keeps the most recent distinct values so that magic values a check compares against
+/// show up in generated programs instead of having to be hit by chance.
+pub struct CmpDictionary {
+    worker_id: usize,
+    // Oldest first
+    values: VecDeque<i64>,
+    known: HashSet<i64>,
+    capacity: usize,
+    // Whether values changed since the last take_update
+    changed: bool,
+}
+
+impl CmpDictionary {
+    const DEFAULT_CAPACITY: usize = 256;
+
+    /// None unless the engine of the worker writes the comparison log
+    pub fn new(worker_id: usize) -> Option<Self> {
+        if unsafe { cov_cmplog_enabled(worker_id as i32) } == 0 {
+            return None;
+        }
+        Some(Self::with_capacity(worker_id, Self::DEFAULT_CAPACITY))
+    }
+
+    fn with_capacity(worker_id: usize, capacity: usize) -> Self {
+        CmpDictionary { worker_id, values: VecDeque::new(), known: HashSet::new(), capacity: capacity.max(1), changed: false }
+    }
+
+    /// Takes over the operands logged since the last call, returns the number of new values
+    pub fn absorb(&mut self) -> usize {
+        let events = unsafe {
+            let events = cov_fetch_cmp_events(self.worker_id as i32);
+            let count = fetch_event_count(self.worker_id as i32) as usize;
+            if events.is_null() || count == 0 {
+                return 0;
+            }
+            std::slice::from_raw_parts(events, count)
+        };
+        let mut added = 0;
+        for event in events {
+            added += self.insert(event.left) as usize + self.insert(event.right) as usize;
+        }
+        added
+    }
+
+    fn insert(&mut self, value: i64) -> bool {
+        // Loop counters and flags, any program produces them without help
+        if (-1..=1).contains(&value) || !self.known.insert(value) {
+            return false;
+        }
+        if self.values.len() == self.capacity {
+            if let Some(oldest) = self.values.pop_front() {
+                self.known.remove(&oldest);
+            }
+        }
+        self.values.push_back(value);
+        self.changed = true;
+        true
+    }
+
+    /// The values as JS literals, newest first, if they changed since the last call
+    pub fn take_update(&mut self) -> Option<Vec<String>> {
+        if !self.changed {
+            return None;
+        }
+        self.changed = false;
+        Some(self.values.iter().rev().map(|value| value.to_string()).collect())
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_dictionary_keeps_recent_distinct_values() {
+        let mut dictionary = CmpDictionary::with_capacity(0, 3);
+        for value in [0x41424344, 1, 0x41424344, -7, 1000, 0, 1 << 40] {
+            dictionary.insert(value);
+        }
+        // 0x41424344 was the oldest when the fourth distinct value arrived
+        assert_eq!(dictionary.take_update(), Some(vec![(1i64 << 40).to_string(), "1000".to_string(), "-7".to_string()]));
+        assert_eq!(dictionary.take_update(), None);
+        assert!(!dictionary.insert(1000));
+        assert!(dictionary.insert(0x41424344));
+        assert_eq!(dictionary.take_update().map(|values| values.len()), Some(3));
+    }
+}
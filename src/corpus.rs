@@ -6,14 +6,15 @@ use std::collections::{HashSet};
 use std::collections::hash_map::DefaultHasher;
 use std::fs::OpenOptions;
 use std::io::Write;
-use crate::corpus_aspect::{BytecodeAnalysis, BytecodeCollector};
+use crate::corpus_aspect::{BytecodeAnalysis, BytecodeCollector, BytecodePool};
+use crate::corpus_arena::ProgramText;
 
 #[derive(Clone)]
 pub struct CorpusEntry {
     pub index: u32,
     pub times_used: u32,
-    pub program_ir: String,
-    pub js_code: String,
+    pub program_ir: ProgramText,  // Shared with the other workers once the master interned it
+    pub js_code: ProgramText,
     pub coverage_found: u32,
     pub success_count: u32,
     pub error_count: u32,    // Track errors when using this entry
@@ -30,10 +31,100 @@ pub struct CorpusEntry {
     pub has_novel_bytecode: bool,  // Flag indicating if this entry has novel bytecode patterns
 
 }
+/// Fenwick tree over the selection weights of the corpus entries, indexed by
+/// their position in `CorpusManager::entries`. Changing one weight and drawing
+/// a weighted sample are both O(log n).
+#[derive(Clone, Default)]
+struct SelectionTree {
+    tree: Vec<f64>,     // 1-based, tree[i] holds the sum of weights (i - lowbit(i), i]
+    weights: Vec<f64>,
+    updates: usize,
+}
+
+impl SelectionTree {
+    // Rebuild from the raw weights every so often so rounding errors of the
+    // incremental updates cannot pile up
+    const REBUILD_INTERVAL: usize = 1 << 16;
+
+    fn rebuild(&mut self, weights: Vec<f64>) {
+        let mut tree = vec![0.0; weights.len() + 1];
+        for i in 1..tree.len() {
+            tree[i] += weights[i - 1];
+            let parent = i + (i & i.wrapping_neg());
+            if parent < tree.len() {
+                tree[parent] += tree[i];
+            }
+        }
+        self.tree = tree;
+        self.weights = weights;
+        self.updates = 0;
+    }
+
+    fn prefix(&self, mut i: usize) -> f64 {
+        let mut sum = 0.0;
+        while i > 0 {
+            sum += self.tree[i];
+            i &= i - 1;
+        }
+        sum
+    }
+
+    fn push(&mut self, weight: f64) {
+        if self.tree.is_empty() {
+            self.tree.push(0.0);
+        }
+        let i = self.tree.len();
+        let lowbit = i & i.wrapping_neg();
+        let node = weight + self.prefix(i - 1) - self.prefix(i - lowbit);
+        self.tree.push(node);
+        self.weights.push(weight);
+    }
+
+    fn set(&mut self, pos: usize, weight: f64) {
+        let delta = weight - self.weights[pos];
+        self.weights[pos] = weight;
+        self.updates += 1;
+        if self.updates >= Self::REBUILD_INTERVAL {
+            let weights = std::mem::take(&mut self.weights);
+            self.rebuild(weights);
+            return;
+        }
+        let mut i = pos + 1;
+        while i < self.tree.len() {
+            self.tree[i] += delta;
+            i += i & i.wrapping_neg();
+        }
+    }
+
+    fn total(&self) -> f64 {
+        self.prefix(self.weights.len())
+    }
+
+    /// Position of the entry whose cumulative weight range contains `target`
+    fn find(&self, mut target: f64) -> usize {
+        let n = self.weights.len();
+        let mut pos = 0;
+        let mut step = if n == 0 { 0 } else { 1 << (usize::BITS - 1 - n.leading_zeros()) };
+        while step > 0 {
+            let next = pos + step;
+            if next <= n && self.tree[next] <= target {
+                pos = next;
+                target -= self.tree[next];
+            }
+            step >>= 1;
+        }
+        pos.min(n.saturating_sub(1))
+    }
+}
+
 #[derive(Clone)]
 pub struct CorpusManager {
     pub worker_id: usize,
+    // Only mutate through the CorpusManager methods, they keep `selection` in sync
     pub entries: VecDeque<CorpusEntry>,
+    selection: SelectionTree,
+    positions: HashMap<u32, usize>,  // entry index -> position in entries
+    next_index: u32,
     max_size: usize,
     min_energy: f64,
     total_coverage: HashMap<u64, u64>,
@@ -45,11 +136,11 @@ pub struct CorpusManager {
 }
 
 impl CorpusEntry {
-    pub fn new(program_ir: String, js_code: String) -> Self {
+    pub fn new(program_ir: impl Into<ProgramText>, js_code: impl Into<ProgramText>) -> Self {
         Self {
             index: 0 as u32,
-            program_ir: program_ir,
-            js_code: js_code,
+            program_ir: program_ir.into(),
+            js_code: js_code.into(),
             times_used: 0,
             coverage_found: 0,
             success_count: 0,
@@ -71,6 +162,27 @@ impl CorpusEntry {
     
   
  
+    /// Weight of this entry for select_next_input
+    pub fn selection_score(&self) -> f64 {
+        // Prioritize smaller code size (inverse relationship)
+        let size_factor = 1.0 / (1.0 + self.js_code.len() as f64 * 0.001);
+
+        // Reward success count and coverage found
+        let success_factor = 1.0 + self.success_count as f64 * 0.2;
+        let coverage_factor = 1.0 + self.coverage_found as f64 * 0.1;
+
+        // Penalize errors and timeouts
+        let error_penalty = 1.0 / (1.0 + self.error_count as f64 * 0.3);
+        let timeout_penalty = 1.0 / (1.0 + self.timeout_count as f64 * 0.4);
+
+        // Penalize overused entries (stronger penalty)
+        let usage_penalty = 1.0 / (1.0 + self.times_used as f64 * 0.2);
+
+        let score = self.performance_score * size_factor * success_factor * coverage_factor *
+                    error_penalty * timeout_penalty * usage_penalty;
+        if score > 0.0 { score } else { 0.0 }
+    }
+
     pub fn print(self, prefix: String) {
         println!("{} Index: {}", prefix, self.index);
     }
@@ -96,6 +208,9 @@ impl CorpusManager {
         Self {
             worker_id,
             entries: VecDeque::new(),
+            selection: SelectionTree::default(),
+            positions: HashMap::new(),
+            next_index: 0,
             max_size,
             min_energy: 0.1,
             total_coverage: HashMap::new(),
@@ -112,8 +227,25 @@ impl CorpusManager {
         }
     }
   
+    fn entry_mut(&mut self, index: u32) -> Option<&mut CorpusEntry> {
+        let pos = *self.positions.get(&index)?;
+        self.entries.get_mut(pos)
+    }
+
+    /// Push the current score of the entry at `pos` into the selection tree
+    fn refresh_selection_weight(&mut self, pos: usize) {
+        let weight = self.entries[pos].selection_score();
+        self.selection.set(pos, weight);
+    }
+
+    fn refresh_selection_weight_of(&mut self, index: u32) {
+        if let Some(&pos) = self.positions.get(&index) {
+            self.refresh_selection_weight(pos);
+        }
+    }
+
     pub fn update_feature_frequency(&mut self, index: u32, features: &[u64]) {
-        if let Some(entry) = self.entries.iter_mut().find(|e| e.index == index) {
+        if let Some(entry) = self.entry_mut(index) {
             for &feature in features {
                 *entry.feature_frequency.entry(feature).or_insert(0) += 1;
             }
@@ -124,7 +256,9 @@ impl CorpusManager {
 
 
     pub fn add_entry(&mut self, mut entry: CorpusEntry) {
-        entry.index = self.entries.len() as u32;
+        // Indices stay unique across deletions
+        entry.index = self.next_index;
+        self.next_index += 1;
         entry.times_used = 0;
         entry.success_count = 0;
         entry.error_count = 0;
@@ -138,6 +272,8 @@ impl CorpusManager {
         entry.feature_frequency = HashMap::new();
         entry.module_performance = HashMap::new();
         entry.module_features = HashMap::new();
+        self.positions.insert(entry.index, self.entries.len());
+        self.selection.push(entry.selection_score());
         self.entries.push_back(entry);
         
         //println!("[CORPUS DEBUG] Added new entry. Total entries: {}", self.entries.len());
@@ -146,7 +282,7 @@ impl CorpusManager {
         }
     }
     pub fn update_entry_success(&mut self, index: u32, new_coverage: u32) {
-        if let Some(entry) = self.entries.iter_mut().find(|e| e.index == index) {
+        if let Some(entry) = self.entry_mut(index) {
             entry.success_count += 1;
             entry.last_coverage_found = Instant::now();
             entry.coverage_found += new_coverage;
@@ -155,16 +291,21 @@ impl CorpusManager {
         } else {
             //println!("[CORPUS DEBUG] Failed to update entry {}: not found", index);
         }
+        self.refresh_selection_weight_of(index);
         self.last_new_coverage = Instant::now();
         self.total_coverage.insert(index as u64, new_coverage as u64);
     }
    
    
     pub fn delete_entry(&mut self, index: u32) {
-        // Find the position of the entry in the VecDeque
-        if let Some(pos) = self.entries.iter().position(|e| e.index == index) {
-            // Remove entry at that position
+        if let Some(pos) = self.positions.remove(&index) {
+            // Remove entry at that position, everything behind it shifts down
+            // so the positions and the selection tree are rebuilt
             self.entries.remove(pos);
+            for (pos, entry) in self.entries.iter().enumerate().skip(pos) {
+                self.positions.insert(entry.index, pos);
+            }
+            self.selection.rebuild(self.entries.iter().map(|e| e.selection_score()).collect());
         }
     }
    
@@ -176,7 +317,7 @@ impl CorpusManager {
         let index = rng.gen_range(0..self.entries.len());
         Some(self.entries[index].clone())
     }
-    pub fn select_next_input(&mut self) -> Option<CorpusEntry> {
+    pub fn select_next_input(&mut self) -> Option<&CorpusEntry> {
         // return None;
         let mut rng = rand::thread_rng();
         
@@ -194,58 +335,17 @@ impl CorpusManager {
             return None;
         }
         
-        // Calculate scores for each entry
-        let scores: Vec<_> = self.entries.iter().enumerate()
-            .map(|(idx, entry)| {
-                let mut score = entry.performance_score;
-                
-                // Prioritize smaller code size (inverse relationship)
-                let size_factor = 1.0 / (1.0 + entry.js_code.len() as f64 * 0.001);
-                
-                // Reward success count and coverage found
-                let success_factor = 1.0 + entry.success_count as f64 * 0.2;
-                let coverage_factor = 1.0 + entry.coverage_found as f64 * 0.1;
-                
-                // Penalize errors and timeouts
-                let error_penalty = 1.0 / (1.0 + entry.error_count as f64 * 0.3);
-                let timeout_penalty = 1.0 / (1.0 + entry.timeout_count as f64 * 0.4);
-                
-                // Penalize overused entries (stronger penalty)
-                let usage_penalty = 1.0 / (1.0 + entry.times_used as f64 * 0.2);
-                
-                // Calculate final score combining all factors
-                score *= size_factor * success_factor * coverage_factor * error_penalty * timeout_penalty * usage_penalty;
-                
-                (idx, score)
-            })
-            .collect();
-
-        // Select entry based on scores
-        let total_score: f64 = scores.iter().map(|(_, score)| *score).sum();
-        if total_score <= 0.0 {
+        // Select entry based on scores, the tree holds the selection_score of every entry
+        let total_score = self.selection.total();
+        if !(total_score > 0.0) {
             //println!("[CORPUS DEBUG] Cannot select entry: total score is zero");
             return None;
         }
 
-        let mut selection = rng.gen::<f64>() * total_score;
-        for (idx, score) in scores {
-            selection -= score;
-            if selection <= 0.0 {
-                self.entries[idx].times_used += 1;
-                let selected_entry = self.entries[idx].clone();
-                
-                // Log every 1000 selections
-                if self.selection_counter % 10000 == 0 {
-                    //println!("[CORPUS DEBUG] Selected entry {} (score: {:.2}). Times used: {}", 
-                            // selected_entry.index, score, selected_entry.times_used);
-                }
-                
-                return Some(selected_entry);
-            }
-        }
-
-        //println!("[CORPUS DEBUG] Failed to select entry despite having entries. This shouldn't happen.");
-        None
+        let idx = self.selection.find(rng.gen::<f64>() * total_score);
+        self.entries[idx].times_used += 1;
+        self.refresh_selection_weight(idx);
+        Some(&self.entries[idx])
     }
 
     
@@ -436,7 +536,7 @@ impl CorpusManager {
         
         let mut rng = rand::thread_rng();
         let index = rng.gen_range(0..self.entries.len());
-        self.entries[index].program_ir.clone()
+        self.entries[index].program_ir.to_string()
     }
 
     pub fn dump_stats_to_json(&self) {
@@ -694,17 +794,7 @@ impl CorpusManager {
         // Calculate scores for all entries
         let mut entry_scores: Vec<(u32, f64, usize)> = self.entries.iter().enumerate()
             .map(|(idx, entry)| {
-                let size_factor = 1.0 / (1.0 + entry.js_code.len() as f64 * 0.001);
-                let success_factor = 1.0 + entry.success_count as f64 * 0.2;
-                let coverage_factor = 1.0 + entry.coverage_found as f64 * 0.1;
-                let error_penalty = 1.0 / (1.0 + entry.error_count as f64 * 0.3);
-                let timeout_penalty = 1.0 / (1.0 + entry.timeout_count as f64 * 0.4);
-                let usage_penalty = 1.0 / (1.0 + entry.times_used as f64 * 0.2);
-                
-                let score = entry.performance_score * size_factor * success_factor * 
-                           coverage_factor * error_penalty * timeout_penalty * usage_penalty;
-                
-                (entry.index, score, idx)
+                (entry.index, entry.selection_score(), idx)
             })
             .collect();
         
@@ -754,7 +844,7 @@ impl CorpusManager {
     }
 
     pub fn update_entry_error(&mut self, index: u32) {
-        if let Some(entry) = self.entries.iter_mut().find(|e| e.index == index) {
+        if let Some(entry) = self.entry_mut(index) {
             entry.error_count += 1;
             entry.last_used = Instant::now();
             
@@ -766,13 +856,14 @@ impl CorpusManager {
         } else {
             //println!("[CORPUS DEBUG] Failed to update error for entry {}: not found", index);
         }
+        self.refresh_selection_weight_of(index);
         
         // Record this mutation as unsuccessful
         self.record_mutation_result(false);
     }
     
     pub fn update_entry_timeout(&mut self, index: u32) {
-        if let Some(entry) = self.entries.iter_mut().find(|e| e.index == index) {
+        if let Some(entry) = self.entry_mut(index) {
             entry.timeout_count += 1;
             entry.last_used = Instant::now();
             
@@ -784,6 +875,7 @@ impl CorpusManager {
         } else {
             //println!("[CORPUS DEBUG] Failed to update timeout for entry {}: not found", index);
         }
+        self.refresh_selection_weight_of(index);
         
         // Record this mutation as unsuccessful
         self.record_mutation_result(false);
@@ -791,16 +883,8 @@ impl CorpusManager {
 
     /// Initialize bytecode collector for this corpus manager
     pub fn init_bytecode_collector(&mut self) {
-        // Initialize the special worker 101 for bytecode collection if not already done
-        // static mut BYTECODE_WORKER_INITIALIZED: bool = false;
-        unsafe {
-            // if !BYTECODE_WORKER_INITIALIZED {
-                crate::coverage::init_reprl_safe(100 + self.worker_id as usize);
-                // BYTECODE_WORKER_INITIALIZED = true;
-                println!("[BYTECODE] Initialized worker 101 for bytecode collection");
-            // }
-        }
-        
+        // The engines are shared by all workers, see BytecodePool
+        BytecodePool::global();
         self.bytecode_collector = Some(BytecodeCollector::new(self.worker_id));
     }
 
@@ -808,7 +892,7 @@ impl CorpusManager {
     /// Returns true if the entry should be kept due to novel bytecode patterns
     pub fn analyze_bytecode_novelty(&mut self, entry: &mut CorpusEntry) -> bool {
         if let Some(ref mut collector) = self.bytecode_collector {
-            match collector.analyze_js_bytecode(&entry.js_code, self.worker_id as u32) {
+            match collector.analyze_js_bytecode(&entry.js_code) {
                 Ok((analysis, is_novel)) => {
                     entry.bytecode_analysis = Some(analysis);
                     entry.has_novel_bytecode = is_novel;
@@ -841,4 +925,61 @@ impl CorpusManager {
         self.analyze_bytecode_novelty(entry)
     }
 
-}
\ No newline at end of file
+}
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn manager_with(codes: &[&str]) -> CorpusManager {
+        let mut corpus = CorpusManager::new(0, 100);
+        for code in codes {
+            corpus.add_entry(CorpusEntry::new(String::new(), code.to_string()));
+        }
+        corpus
+    }
+
+    fn assert_tree_matches(corpus: &CorpusManager) {
+        let expected: f64 = corpus.entries.iter().map(|e| e.selection_score()).sum();
+        assert!((corpus.selection.total() - expected).abs() < 1e-9);
+        for (pos, entry) in corpus.entries.iter().enumerate() {
+            assert_eq!(corpus.positions[&entry.index], pos);
+        }
+    }
+
+    #[test]
+    fn test_selection_tree_tracks_updates() {
+        let mut corpus = manager_with(&["a", "bb", "ccc", "dddd", "eeeee"]);
+        assert_tree_matches(&corpus);
+
+        corpus.update_entry_success(1, 10);
+        corpus.update_entry_error(2);
+        corpus.update_entry_timeout(3);
+        for _ in 0..50 {
+            assert!(corpus.select_next_input().is_some());
+        }
+        assert_tree_matches(&corpus);
+
+        corpus.delete_entry(1);
+        assert_tree_matches(&corpus);
+        corpus.add_entry(CorpusEntry::new(String::new(), "f".to_string()));
+        assert_eq!(corpus.entries.back().unwrap().index, 5);
+        corpus.update_entry_success(4, 1);
+        assert_tree_matches(&corpus);
+    }
+
+    #[test]
+    fn test_selection_follows_weights() {
+        let mut tree = SelectionTree::default();
+        for weight in [1.0, 0.0, 3.0, 0.0, 4.0] {
+            tree.push(weight);
+        }
+        assert_eq!(tree.find(0.5), 0);
+        assert_eq!(tree.find(1.0), 2);
+        assert_eq!(tree.find(3.99), 2);
+        assert_eq!(tree.find(4.0), 4);
+        assert_eq!(tree.find(7.99), 4);
+        tree.set(2, 0.0);
+        assert_eq!(tree.find(1.5), 4);
+        assert!((tree.total() - 5.0).abs() < 1e-12);
+    }
+}
@@ -0,0 +1,216 @@
+use std::fmt;
+use std::ops::Deref;
+use std::sync::atomic::{AtomicUsize, Ordering};
+use std::sync::{Mutex, OnceLock};
+
+/// Location of one entry in the arena blob, the program IR is followed by the JS code
+#[derive(Clone, Copy)]
+#[repr(C)]
+struct ArenaRecord {
+    offset: u64,
+    ir_len: u32,
+    js_len: u32,
+}
+
+/// Append-only store for the program text of the corpus.
+///
+/// The text lives in one mmap'd blob, each entry is an offset and two lengths
+/// in a parallel record table. The master appends, every worker reads the
+/// same bytes without copying them. An entry becomes visible once `len` is
+/// bumped, published bytes are never written again.
+pub struct CorpusArena {
+    blob: *mut u8,
+    blob_size: usize,
+    records: *mut ArenaRecord,
+    max_records: usize,
+    len: AtomicUsize,
+    tail: Mutex<usize>,  // Next free byte in the blob, also serializes the writers
+}
+
+unsafe impl Send for CorpusArena {}
+unsafe impl Sync for CorpusArena {}
+
+impl CorpusArena {
+    const DEFAULT_SIZE_MB: usize = 1024;
+    const MAX_RECORDS: usize = 1 << 22;
+
+    /// The arena of this process, shared by the master and all workers.
+    /// Its size is taken from CORPUS_ARENA_MB.
+    pub fn global() -> &'static CorpusArena {
+        static ARENA: OnceLock<CorpusArena> = OnceLock::new();
+        ARENA.get_or_init(|| {
+            let size_mb = std::env::var("CORPUS_ARENA_MB").ok().and_then(|v| v.parse().ok()).unwrap_or(Self::DEFAULT_SIZE_MB);
+            CorpusArena::new(size_mb << 20, Self::MAX_RECORDS)
+        })
+    }
+
+    /// Reserves the address space, pages are only backed once entries are written to them
+    pub fn new(blob_size: usize, max_records: usize) -> Self {
+        let blob = map_reserved(blob_size.max(1)) as *mut u8;
+        let records = map_reserved(max_records.max(1) * std::mem::size_of::<ArenaRecord>()) as *mut ArenaRecord;
+        CorpusArena {
+            blob,
+            blob_size: blob_size.max(1),
+            records,
+            max_records: max_records.max(1),
+            len: AtomicUsize::new(0),
+            tail: Mutex::new(0),
+        }
+    }
+
+    /// Number of published entries
+    pub fn len(&self) -> usize {
+        self.len.load(Ordering::Acquire)
+    }
+
+    /// Copies an entry into the arena and publishes it.
+    /// Returns None if the arena is full.
+    pub fn append(&self, program_ir: &str, js_code: &str) -> Option<u32> {
+        let mut tail = self.tail.lock().unwrap();
+        let id = self.len.load(Ordering::Relaxed);
+        let size = program_ir.len() + js_code.len();
+        if id >= self.max_records || *tail + size > self.blob_size
+            || program_ir.len() > u32::MAX as usize || js_code.len() > u32::MAX as usize {
+            return None;
+        }
+        unsafe {
+            let dst = self.blob.add(*tail);
+            std::ptr::copy_nonoverlapping(program_ir.as_ptr(), dst, program_ir.len());
+            std::ptr::copy_nonoverlapping(js_code.as_ptr(), dst.add(program_ir.len()), js_code.len());
+            self.records.add(id).write(ArenaRecord {
+                offset: *tail as u64,
+                ir_len: program_ir.len() as u32,
+                js_len: js_code.len() as u32,
+            });
+        }
+        *tail += size;
+        self.len.store(id + 1, Ordering::Release);
+        Some(id as u32)
+    }
+
+    /// Program IR and JS code of a published entry
+    pub fn get(&self, id: u32) -> Option<(&str, &str)> {
+        if id as usize >= self.len() {
+            return None;
+        }
+        unsafe {
+            let record = self.records.add(id as usize).read();
+            let start = self.blob.add(record.offset as usize);
+            let program_ir = std::slice::from_raw_parts(start, record.ir_len as usize);
+            let js_code = std::slice::from_raw_parts(start.add(record.ir_len as usize), record.js_len as usize);
+            // Both were copied from a &str
+            Some((std::str::from_utf8_unchecked(program_ir), std::str::from_utf8_unchecked(js_code)))
+        }
+    }
+}
+
+impl Drop for CorpusArena {
+    fn drop(&mut self) {
+        unsafe {
+            libc::munmap(self.blob as *mut libc::c_void, self.blob_size);
+            libc::munmap(self.records as *mut libc::c_void, self.max_records * std::mem::size_of::<ArenaRecord>());
+        }
+    }
+}
+
+fn map_reserved(size: usize) -> *mut libc::c_void {
+    let ptr = unsafe {
+        libc::mmap(
+            std::ptr::null_mut(),
+            size,
+            libc::PROT_READ | libc::PROT_WRITE,
+            libc::MAP_PRIVATE | libc::MAP_ANONYMOUS | libc::MAP_NORESERVE,
+            -1,
+            0,
+        )
+    };
+    if ptr == libc::MAP_FAILED {
+        panic!("Failed to map {} bytes for the corpus arena: {}", size, std::io::Error::last_os_error());
+    }
+    ptr
+}
+
+/// Program text of a corpus entry, either owned by the entry or borrowed from
+/// the global arena. Cloning a shared text only copies the reference.
+#[derive(Clone)]
+pub enum ProgramText {
+    Owned(String),
+    Shared(&'static str),
+}
+
+impl ProgramText {
+    pub fn as_str(&self) -> &str {
+        match self {
+            ProgramText::Owned(text) => text,
+            ProgramText::Shared(text) => text,
+        }
+    }
+
+    /// Program IR and JS code of a global arena entry
+    pub fn shared(id: u32) -> Option<(ProgramText, ProgramText)> {
+        let (program_ir, js_code) = CorpusArena::global().get(id)?;
+        Some((ProgramText::Shared(program_ir), ProgramText::Shared(js_code)))
+    }
+
+    /// Moves an entry into the global arena, falls back to the owned texts if it is full
+    pub fn intern(program_ir: String, js_code: String) -> (ProgramText, ProgramText) {
+        match CorpusArena::global().append(&program_ir, &js_code).and_then(ProgramText::shared) {
+            Some(texts) => texts,
+            None => (ProgramText::Owned(program_ir), ProgramText::Owned(js_code)),
+        }
+    }
+}
+
+impl Deref for ProgramText {
+    type Target = str;
+
+    fn deref(&self) -> &str {
+        self.as_str()
+    }
+}
+
+impl From<String> for ProgramText {
+    fn from(text: String) -> Self {
+        ProgramText::Owned(text)
+    }
+}
+
+impl From<&str> for ProgramText {
+    fn from(text: &str) -> Self {
+        ProgramText::Owned(text.to_string())
+    }
+}
+
+impl fmt::Display for ProgramText {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        f.write_str(self.as_str())
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_arena_append_and_get() {
+        let arena = CorpusArena::new(64, 4);
+        assert_eq!(arena.append("{\"ir\":1}", "var a = 1;"), Some(0));
+        assert_eq!(arena.append("", "print(a);"), Some(1));
+        assert_eq!(arena.len(), 2);
+        assert_eq!(arena.get(0), Some(("{\"ir\":1}", "var a = 1;")));
+        assert_eq!(arena.get(1), Some(("", "print(a);")));
+        assert_eq!(arena.get(2), None);
+    }
+
+    #[test]
+    fn test_arena_full() {
+        let arena = CorpusArena::new(16, 2);
+        assert_eq!(arena.append("", "0123456789"), Some(0));
+        // Out of bytes, then out of records
+        assert_eq!(arena.append("", "0123456789"), None);
+        assert_eq!(arena.append("", "x"), Some(1));
+        assert_eq!(arena.append("", "y"), None);
+        assert_eq!(arena.len(), 2);
+        assert_eq!(arena.get(1), Some(("", "x")));
+    }
+}
@@ -1,8 +1,12 @@
 use std::collections::{HashMap, HashSet};
 use std::hash::{Hash, Hasher};
 use std::collections::hash_map::DefaultHasher;
+use std::sync::mpsc::{channel, sync_channel, Receiver, Sender, SyncSender};
+use std::sync::{Arc, Mutex, OnceLock};
+use std::thread;
 use regex::Regex;
 use lazy_static::lazy_static;
+use crate::coverage::{bytecode_worker_id, init_reprl_safe, Executor, OutputReader, CHANNEL_STDOUT};
 
 #[derive(Debug, Clone)]
 pub struct BytecodePattern {
@@ -201,14 +205,40 @@ impl BytecodeAnalysis {
     }
 }
 
-pub fn parse_bytecode_output(output: &str) -> Result<BytecodeAnalysis, String> {
-    let mut instructions = Vec::new();
-    let lines: Vec<&str> = output.lines().collect();
-    
-    // Just scan through all lines looking for bytecode instructions
-    for line in lines {
+/// Parses bytecode output piece by piece as the engine prints it, so the output never has to be copied
+/// into one string first. Lines may be split across chunks.
+#[derive(Default)]
+pub struct BytecodeParser {
+    // Start of a line whose end is in a later chunk
+    pending: Vec<u8>,
+    instructions: Vec<BytecodePattern>,
+}
+
+impl BytecodeParser {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    pub fn feed(&mut self, chunk: &[u8]) {
+        let mut rest = chunk;
+        while let Some(newline) = rest.iter().position(|&b| b == b'\n') {
+            if self.pending.is_empty() {
+                self.parse_line(&rest[..newline]);
+            } else {
+                let mut line = std::mem::take(&mut self.pending);
+                line.extend_from_slice(&rest[..newline]);
+                self.parse_line(&line);
+            }
+            rest = &rest[newline + 1..];
+        }
+        self.pending.extend_from_slice(rest);
+    }
+
+    fn parse_line(&mut self, line: &[u8]) {
+        let line = line.strip_suffix(b"\r").unwrap_or(line);
+        let line = String::from_utf8_lossy(line);
         // Try to parse as instruction - look for the specific pattern: 0x{hex} @ {num} : {hex} {instruction} {operands}
-        if let Some(instr_cap) = BYTECODE_INSTRUCTION_REGEX.captures(line) {
+        if let Some(instr_cap) = BYTECODE_INSTRUCTION_REGEX.captures(&line) {
             let instruction = instr_cap[1].to_string();
             let operands_str = instr_cap[2].trim();
             let operands: Vec<String> = if operands_str.is_empty() {
@@ -220,25 +250,124 @@ pub fn parse_bytecode_output(output: &str) -> Result<BytecodeAnalysis, String> {
                     .collect()
             };
             
-            instructions.push(BytecodePattern::new(instruction, operands));
+            self.instructions.push(BytecodePattern::new(instruction, operands));
         }
     }
-    
-    if instructions.is_empty() {
-        return Err("No bytecode instructions found in output".to_string());
-    }
-    // Create a single function containing all found instructions
-    let function = BytecodeFunction::new(
-        "extracted_bytecode".to_string(),
-        instructions.len() as u32,
-        0, // parameter_count
-        0, // register_count
-        0, // frame_size
-        instructions,
-        Vec::new(), // constants
-    );
-    
-    Ok(BytecodeAnalysis::new(vec![function]))
+
+    pub fn finish(mut self) -> Result<BytecodeAnalysis, String> {
+        if !self.pending.is_empty() {
+            let line = std::mem::take(&mut self.pending);
+            self.parse_line(&line);
+        }
+        if self.instructions.is_empty() {
+            return Err("No bytecode instructions found in output".to_string());
+        }
+        // Create a single function containing all found instructions
+        let function = BytecodeFunction::new(
+            "extracted_bytecode".to_string(),
+            self.instructions.len() as u32,
+            0, // parameter_count
+            0, // register_count
+            0, // frame_size
+            self.instructions,
+            Vec::new(), // constants
+        );
+        
+        Ok(BytecodeAnalysis::new(vec![function]))
+    }
+}
+
+pub fn parse_bytecode_output(output: &str) -> Result<BytecodeAnalysis, String> {
+    let mut parser = BytecodeParser::new();
+    parser.feed(output.as_bytes());
+    parser.finish()
+}
+
+struct BytecodeRequest {
+    js_code: String,
+    reply: Sender<Result<BytecodeAnalysis, String>>,
+}
+
+const BYTECODE_TIMEOUT_MS: i32 = 5000;
+
+/// Engines that print bytecode, shared by all workers. The number of engines is BYTECODE_POOL_SIZE (default 2).
+/// Requests queue up to twice the pool size; beyond that analyze() gives up right away instead of stalling the
+/// worker, so turning on BYTECODE_COLLECTOR costs at most a few engines instead of one per worker.
+pub struct BytecodePool {
+    queue: SyncSender<BytecodeRequest>,
+}
+
+impl BytecodePool {
+    /// The pool of this process, started on first use
+    pub fn global() -> &'static BytecodePool {
+        static POOL: OnceLock<BytecodePool> = OnceLock::new();
+        POOL.get_or_init(|| {
+            let size = std::env::var("BYTECODE_POOL_SIZE").ok().and_then(|v| v.parse().ok()).unwrap_or(2usize).max(1);
+            BytecodePool::start(size)
+        })
+    }
+
+    fn start(size: usize) -> Self {
+        let (queue, requests) = sync_channel(size * 2);
+        let requests = Arc::new(Mutex::new(requests));
+        for slot in 0..size {
+            let requests = requests.clone();
+            thread::spawn(move || Self::serve(slot, requests));
+        }
+        println!("[BYTECODE] Started {} engines for bytecode collection", size);
+        BytecodePool { queue }
+    }
+
+    fn serve(slot: usize, requests: Arc<Mutex<Receiver<BytecodeRequest>>>) {
+        let worker_id = bytecode_worker_id(slot);
+        // init() exits the process without an engine, answer the requests with an error instead
+        let configured = std::env::var("TARGET").is_ok() && std::env::var("BIN").is_ok();
+        if configured {
+            init_reprl_safe(worker_id);
+        }
+        let mut executor = if configured { Executor::new(1) } else { None };
+        loop {
+            let request = match requests.lock().unwrap().recv() {
+                Ok(request) => request,
+                Err(_) => return,
+            };
+            let result = match executor.as_mut() {
+                Some(executor) => Self::run(executor, worker_id, &request.js_code),
+                None => Err("No engine for bytecode collection".to_string()),
+            };
+            let _ = request.reply.send(result);
+        }
+    }
+
+    // Parses the output while the engine is still printing it
+    fn run(executor: &mut Executor, worker_id: usize, js_code: &str) -> Result<BytecodeAnalysis, String> {
+        if !executor.submit(worker_id, js_code, BYTECODE_TIMEOUT_MS) {
+            return Err("Failed to start the bytecode engine".to_string());
+        }
+        let mut parser = BytecodeParser::new();
+        let mut output = OutputReader::new(worker_id, CHANNEL_STDOUT);
+        loop {
+            let completions = executor.wait(1)
+                .map_err(|e| format!("Failed to wait for the bytecode engine: {}", e))?;
+            while let Some(chunk) = output.read() {
+                parser.feed(chunk);
+            }
+            if let Some(completion) = completions.first() {
+                if completion.status != 0 {
+                    return Err(format!("Script execution failed with result: {}", completion.status));
+                }
+                break;
+            }
+        }
+        parser.finish()
+    }
+
+    /// Analyzes the script on the next free engine. None if the queue is full.
+    pub fn analyze(&self, js_code: &str) -> Option<Result<BytecodeAnalysis, String>> {
+        let (reply, result) = channel();
+        self.queue.try_send(BytecodeRequest { js_code: js_code.to_string(), reply }).ok()?;
+        result.recv().ok()
+    }
 }
 
 #[derive(Clone)]
@@ -255,38 +384,13 @@ impl BytecodeCollector {
         }
     }
     
-    pub fn analyze_js_bytecode(&mut self, js_code: &str,worker_id: u32) -> Result<(BytecodeAnalysis, bool), String> {
-        // Execute the JS code with the bytecode worker (worker_id 101)
-        let bytecode_worker_id = (worker_id as i32) + 100;
-        
-        // Execute and capture output
-        let result = unsafe {
-            crate::execute_script(
-                js_code.as_ptr() as *mut i8,
-                5000, // 5 second timeout
-                0,    // fresh instance
-                bytecode_worker_id
-            )
-        };
-        
-        if result != 0 {
-            return Err(format!("Script execution failed with result: {}", result));
-        }
-        
-        // Fetch stdout which contains bytecode output
-        let output = unsafe {
-            let output_ptr = crate::reprl_fetch_stdout(bytecode_worker_id);
-           
-            if output_ptr.is_null() {
-                return Err("Failed to fetch stdout".to_string());
-            }
-            std::ffi::CStr::from_ptr(output_ptr).to_string_lossy().to_string()
+    pub fn analyze_js_bytecode(&mut self, js_code: &str) -> Result<(BytecodeAnalysis, bool), String> {
+        // Execute the JS code on the shared bytecode pool and parse its output while it is printed
+        let analysis = match BytecodePool::global().analyze(js_code) {
+            Some(result) => result?,
+            None => return Err("All bytecode engines are busy".to_string()),
         };
         
-        // println!("DEBUG: Output: {:?}", output);
-        // Parse bytecode from output
-        let analysis = parse_bytecode_output(&output)?;
-        
         // Check if this analysis contains novel patterns
         let is_novel = self.global_collector.check_novelty(&analysis);
         
@@ -390,6 +494,43 @@ Frame size 32
         assert!(analysis.unique_instructions.contains("Mov"));
     }
 
+    #[test]
+    fn test_parser_joins_lines_split_across_chunks() {
+        let mut parser = BytecodeParser::new();
+        parser.feed(b"         0xc6600100074 @    0 : 13 00             LdaCon");
+        parser.feed(b"stant [0]\n         0xc6600100076 @    2 : cf                Star1\n");
+
+        let analysis = parser.finish().unwrap();
+        let instructions: Vec<&str> = analysis.functions[0].instructions
+            .iter()
+            .map(|p| p.instruction.as_str())
+            .collect();
+        assert_eq!(instructions, vec!["LdaConstant", "Star1"]);
+        assert_eq!(analysis.functions[0].instructions[0].operands, vec!["[0]".to_string()]);
+    }
+
+    #[test]
+    fn test_parser_finish_flushes_last_line() {
+        let mut parser = BytecodeParser::new();
+        parser.feed(b"         0xc6600100076 @    2 : cf                Star1\n");
+        parser.feed(b"   21 S> 0xc660010008c @   24 : b5                Return");
+
+        let analysis = parser.finish().unwrap();
+        assert_eq!(analysis.functions[0].instructions.len(), 2);
+        assert_eq!(analysis.functions[0].instructions[1].instruction, "Return");
+    }
+
+    #[test]
+    fn test_pool_rejects_requests_when_queue_is_full() {
+        // No engine takes requests from this queue, so the one slot stays taken
+        let (queue, _requests) = sync_channel(1);
+        let pool = BytecodePool { queue };
+        let (reply, _result) = channel();
+        pool.queue.try_send(BytecodeRequest { js_code: String::new(), reply }).unwrap();
+
+        assert!(pool.analyze("var x = 1;").is_none());
+    }
+
     #[test]
     fn test_bytecode_pattern_creation() {
         let instruction = "LdaConstant".to_string();
@@ -1,10 +1,15 @@
 use std::fs;
+use std::io;
 use std::path::{Path, PathBuf};
 use std::collections::HashSet;
 
+use std::cell::Cell;
+use std::ffi::CString;
 use std::ptr;
 
 // Define the EdgeSet struct for coverage tracking
+// The indices are borrowed from the worker's edge arena in the C core. They stay valid until
+// cov_reset_edge_arena() is called for that worker and must never be freed on the Rust side.
 #[repr(C)]
 #[derive(Debug, Clone)]
 pub struct EdgeSet {
@@ -16,8 +21,40 @@ impl  EdgeSet {
    pub fn new() -> Self {
     EdgeSet { count: 0, edge_indices: ptr::null_mut() }
    }
+
+   pub fn as_slice(&self) -> &[u32] {
+    if self.count == 0 || self.edge_indices.is_null() {
+        return &[];
+    }
+    unsafe { std::slice::from_raw_parts(self.edge_indices, self.count as usize) }
+   }
   
 }
+// Result of cov_evaluate_counts: edge_hit_count[i] is the hit count bucket (a single bit, see the
+// count_class tables in reprl.c) reached by the i-th edge of the accompanying EdgeSet.
+// Borrowed from the edge arena just like EdgeSet.
+#[repr(C)]
+#[derive(Debug, Clone)]
+pub struct EdgeCounts {
+    pub count: u32,
+    pub edge_hit_count: *mut u32,
+    // Edges of the set that were not hit before, the others only reached a new bucket
+    pub new_edges: u32,
+}
+
+impl EdgeCounts {
+   pub fn new() -> Self {
+    EdgeCounts { count: 0, edge_hit_count: ptr::null_mut(), new_edges: 0 }
+   }
+
+   pub fn as_slice(&self) -> &[u32] {
+    if self.count == 0 || self.edge_hit_count.is_null() {
+        return &[];
+    }
+    unsafe { std::slice::from_raw_parts(self.edge_hit_count, self.count as usize) }
+   }
+}
+
 #[derive(PartialEq,Debug)]
 pub enum ResultCode {
     Success,
@@ -26,6 +63,120 @@ pub enum ResultCode {
     Crash,
 }
 
+// Mirrors struct reprl_spawn_stats in reprl.h, times are in microseconds.
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default)]
+pub struct SpawnStats {
+    pub spawns: u64,
+    pub forks: u64,
+    pub standby_promotions: u64,
+    pub failures: u64,
+    pub total_us: u64,
+    pub max_us: u64,
+    pub last_us: u64,
+    pub standby_refills: u64,
+    pub refill_us: u64,
+}
+
+impl SpawnStats {
+    pub fn average_us(&self) -> u64 {
+        if self.spawns == 0 { 0 } else { self.total_us / self.spawns }
+    }
+
+    /// Time to start a standby child, which is not part of average_us. None without standby children.
+    pub fn average_refill_us(&self) -> Option<u64> {
+        if self.standby_refills == 0 { None } else { Some(self.refill_us / self.standby_refills) }
+    }
+}
+
+/// Mirrors REPRL_HISTOGRAM_* in reprl.h
+pub const HISTOGRAM_SUB_BITS: u32 = 3;
+pub const HISTOGRAM_BUCKETS: usize = 38 << HISTOGRAM_SUB_BITS;
+
+/// Execution phases in the order of REPRL_PHASE_* in reprl.h
+pub const PHASE_NAMES: [&str; 7] = ["copy", "clear", "control", "run", "status", "evaluate", "respawn"];
+
+// Mirrors struct reprl_histogram in reprl.h, durations are in nanoseconds.
+#[repr(C)]
+#[derive(Clone, Copy)]
+pub struct PhaseHistogram {
+    pub count: u64,
+    pub total_ns: u64,
+    pub max_ns: u64,
+    pub buckets: [u64; HISTOGRAM_BUCKETS],
+}
+
+impl Default for PhaseHistogram {
+    fn default() -> Self {
+        PhaseHistogram { count: 0, total_ns: 0, max_ns: 0, buckets: [0; HISTOGRAM_BUCKETS] }
+    }
+}
+
+impl PhaseHistogram {
+    pub fn merge(&mut self, other: &PhaseHistogram) {
+        self.count += other.count;
+        self.total_ns += other.total_ns;
+        self.max_ns = self.max_ns.max(other.max_ns);
+        for (bucket, value) in self.buckets.iter_mut().zip(other.buckets.iter()) {
+            *bucket += value;
+        }
+    }
+
+    pub fn mean_ns(&self) -> u64 {
+        if self.count == 0 { 0 } else { self.total_ns / self.count }
+    }
+
+    /// Upper bound of the bucket holding the given percentile (0-100), so at most 12.5% above the real value
+    pub fn percentile_ns(&self, percentile: f64) -> u64 {
+        if self.count == 0 {
+            return 0;
+        }
+        let rank = ((self.count as f64 * percentile / 100.0).ceil() as u64).max(1);
+        let mut seen = 0;
+        for (index, &value) in self.buckets.iter().enumerate() {
+            seen += value;
+            if seen >= rank {
+                return Self::bucket_limit(index).min(self.max_ns);
+            }
+        }
+        self.max_ns
+    }
+
+    fn bucket_limit(index: usize) -> u64 {
+        let sub_buckets = 1usize << HISTOGRAM_SUB_BITS;
+        if index < sub_buckets {
+            return index as u64;
+        }
+        let magnitude = (index >> HISTOGRAM_SUB_BITS) as u32;
+        let sub = (index & (sub_buckets - 1)) as u64;
+        ((sub_buckets as u64 + sub + 1) << (magnitude - 1)) - 1
+    }
+}
+
+// Mirrors struct reprl_config in reprl.h
+#[repr(C)]
+pub struct ReprlConfig {
+    pub engine: *const i8,
+    pub binary: *const i8,
+    pub extra_args: *const *const i8,
+    pub wasm_baseline: i32,
+    pub print_bytecode: i32,
+    pub capture_stdout: i32,
+    pub capture_stderr: i32,
+    pub spawn_timeout_ms: i32,
+    pub channel_capacity: [u64; 4],
+}
+
+// Mirrors struct reprl_completion in reprl.h
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default)]
+pub struct Completion {
+    pub worker_id: i32,
+    pub status: i32,
+    /// In microseconds, measured from the submission
+    pub execution_time: u64,
+}
+
 #[repr(C)]
 #[derive(Debug)]
 pub struct CmpEvent {
@@ -35,18 +186,51 @@ pub struct CmpEvent {
 
 unsafe extern "C" {
     pub fn init(worker_id: i32);
+    pub fn reprl_init_with_config(worker_id: i32, config: *const ReprlConfig) -> i32;
+    pub fn reprl_max_workers() -> i32;
     pub fn spawn(worker_id: i32);
     pub fn execute_script(script: *mut i8, timeout: i32, fresh_instance: i32, worker_id: i32) -> i32;
     pub fn cov_evaluate(worker_id: usize, edges: *mut EdgeSet) -> i32;
+    pub fn cov_evaluate_and_reset(worker_id: usize, edges: *mut EdgeSet) -> i32;
+    pub fn cov_reset_edge_arena(worker_id: usize);
+    pub fn cov_evaluate_counts(worker_id: usize, edges: *mut EdgeSet, counts: *mut EdgeCounts) -> i32;
+    pub fn cov_hitcounts_enabled(worker_id: usize) -> i32;
+    pub fn cov_shared_virgin_enabled(worker_id: usize) -> i32;
+    pub fn cov_merge_edges(worker_id: usize, indices: *const u32, count: u32, merged: *mut EdgeSet) -> i32;
+    pub fn cov_merge_counts(worker_id: usize, indices: *const u32, buckets: *const u32, count: u32) -> i32;
+    pub fn cov_count_hit_edges(worker_id: usize, indices: *const u32, count: u32) -> i32;
+    pub fn cov_set_target_edges(worker_id: i32, indices: *const u32, count: u32) -> i32;
+    pub fn cov_count_target_hits(worker_id: i32) -> i32;
+    pub fn reprl_get_script_buffer(worker_id: i32, size: *mut u64) -> *mut u8;
+    pub fn reprl_execute_in_place(worker_id: i32, length: u64, timeout: i32) -> i32;
+    pub fn reprl_execute_in_place_us(worker_id: i32, length: u64, timeout_us: u64) -> i32;
+    pub fn execute_script_batch(scripts: *const *const i8, lengths: *const u64, timeouts: *const i32, count: i32, statuses: *mut i32, execution_times: *mut u64, new_edges: *mut EdgeSet, worker_id: i32) -> i32;
     pub fn coverage_finish_initialization(worker_id: usize, should_track_edges: i32);
+    pub fn reprl_set_spawn_timeout(worker_id: i32, timeout_ms: u64);
+    pub fn reprl_get_spawn_stats(worker_id: i32, stats: *mut SpawnStats) -> i32;
+    pub fn reprl_get_phase_histograms(worker_id: i32, histograms: *mut PhaseHistogram) -> i32;
+    pub fn coverage_checkpoint_open(worker_id: i32, path: *const i8) -> i32;
+    pub fn coverage_checkpoint(worker_id: i32) -> i64;
+    pub fn coverage_checkpoint_close(worker_id: i32);
+    pub fn coverage_load_checkpoint(worker_id: i32, path: *const i8) -> i32;
+    pub fn coverage_fingerprint(worker_id: i32) -> u64;
+    pub fn reprl_last_execution_time(worker_id: i32) -> u64;
     pub fn reprl_destroy_context(worker_id: usize);
     pub fn cov_clear_edge_data(worker_id: usize, index: u32);
     pub fn cov_set_edge_data(worker_id: usize, index: u32);
     pub fn reprl_fetch_stdout(worker_id: i32) -> *mut i8;
+    pub fn reprl_fetch_output(worker_id: i32, channel: i32, length: *mut u64) -> *const u8;
+    pub fn reprl_read_output(worker_id: i32, channel: i32, offset: *mut u64, length: *mut u64) -> *const u8;
+    pub fn reprl_capture_next_execution(worker_id: i32);
+    pub fn reprl_executor_create(capacity: u32) -> *mut std::ffi::c_void;
+    pub fn reprl_executor_destroy(executor: *mut std::ffi::c_void);
+    pub fn reprl_executor_submit(executor: *mut std::ffi::c_void, worker_id: i32, script: *const i8, length: u64, timeout: i32) -> i32;
+    pub fn reprl_executor_wait(executor: *mut std::ffi::c_void, completions: *mut Completion, max: u32, wait_ms: i32) -> i32;
     pub fn cleanup_reprl(worker_id: i32); 
     pub fn cov_fetch_cmp_events(worker_id: i32) -> *mut CmpEvent;
     pub fn fetch_event_count(worker_id: i32) -> u64;
     pub fn cov_clear_cmp_events(worker_id: i32);
+    pub fn cov_cmplog_enabled(worker_id: i32) -> i32;
 }
 pub fn reset_edge_set(worker_id: usize, edge_set: &mut EdgeSet) {
     for i in 0..edge_set.count {
@@ -65,6 +249,11 @@ pub fn mark_edge_set(worker_id: usize, edge_set: &mut EdgeSet) {
     }
 }
 
+thread_local! {
+    // Set for workers of an engine pool, overrides PROFILE for the engine this thread fuzzes
+    static RESULT_PROFILE: Cell<Option<&'static str>> = Cell::new(None);
+}
+
 pub fn get_result_code(result_code: i32) -> ResultCode {
     if result_code == 0 {
         return ResultCode::Success;
@@ -73,7 +262,10 @@ pub fn get_result_code(result_code: i32) -> ResultCode {
     if result_code == 65536 {
         return ResultCode::Timeout;
     }
-    let profile = std::env::var("PROFILE").unwrap_or_else(|_| "v8".to_string());
+    let profile = match RESULT_PROFILE.with(|profile| profile.get()) {
+        Some(profile) => profile.to_string(),
+        None => std::env::var("PROFILE").unwrap_or_else(|_| "v8".to_string()),
+    };
     if profile == "v8" {
         if result_code == 5 || result_code == 6 || result_code == 11 {
             return ResultCode::Crash;
@@ -101,47 +293,165 @@ pub fn init_reprl_safe(worker_id: usize) {
         coverage_finish_initialization(worker_id, 0);
     }
 }
+
+/// One engine of a worker pool, see EngineConfig::parse_pool
+#[derive(Debug, Clone)]
+pub struct EngineConfig {
+    pub engine: String,
+    pub binary: String,
+    pub args: Vec<String>,
+    pub workers: usize,
+}
+
+impl EngineConfig {
+    /// Parses a pool spec like "v8=/out/d8 --no-lazy-feedback:96,firefox=/out/js:32". Every entry is
+    /// engine[=binary [flags...]]:workers, the binary defaults to $BIN.
+    pub fn parse_pool(spec: &str) -> Result<Vec<EngineConfig>, String> {
+        let mut pool = Vec::new();
+        for entry in spec.split(',').map(str::trim).filter(|entry| !entry.is_empty()) {
+            let (command, workers) = entry.rsplit_once(':')
+                .ok_or_else(|| format!("Pool entry '{}' has no worker count", entry))?;
+            let workers = workers.trim().parse::<usize>()
+                .map_err(|e| format!("Invalid worker count in pool entry '{}': {}", entry, e))?;
+            let (engine, command) = match command.split_once('=') {
+                Some((engine, command)) => (engine.trim(), command.to_string()),
+                None => (command.trim(), std::env::var("BIN").unwrap_or_default()),
+            };
+            if !["v8", "firefox", "jsc"].contains(&engine) {
+                return Err(format!("Unknown engine '{}' in pool entry '{}'", engine, entry));
+            }
+            let mut words = command.split_whitespace().map(str::to_string);
+            let binary = words.next().ok_or_else(|| format!("No binary for pool entry '{}', set BIN or use engine=binary", entry))?;
+            pool.push(EngineConfig { engine: engine.to_string(), binary, args: words.collect(), workers });
+        }
+        if pool.is_empty() {
+            return Err("Empty pool spec".to_string());
+        }
+        Ok(pool)
+    }
+
+    /// The PROFILE name get_result_code uses for this engine
+    pub fn result_profile(&self) -> &'static str {
+        match self.engine.as_str() {
+            "firefox" => "gecko",
+            "jsc" => "jsc",
+            _ => "v8",
+        }
+    }
+}
+
+/// The edges the master has seen from the workers of one engine binary other than its own.
+///
+/// Edge indices are only comparable between instrumented builds of the same binary, so the
+/// virgin map of the master's context only takes the edges of workers running its binary and
+/// every other binary of a --pool gets one of these instead.
+pub struct EdgeDomain {
+    seen: Vec<u64>,
+    // Hit count bucket bits seen per edge, see cov_merge_counts
+    buckets: Vec<u8>,
+}
+
+impl EdgeDomain {
+    pub fn new() -> Self {
+        EdgeDomain { seen: Vec::new(), buckets: Vec::new() }
+    }
+
+    /// Records the bucket bits, buckets[i] belongs to edges[i]. Returns the number of new buckets.
+    pub fn merge_counts(&mut self, edges: &[u32], buckets: &[u32]) -> usize {
+        let mut new_buckets = 0;
+        for (&edge, &bucket) in edges.iter().zip(buckets) {
+            let edge = edge as usize;
+            if edge >= self.buckets.len() {
+                self.buckets.resize(edge + 1, 0);
+            }
+            let novel = bucket as u8 & !self.buckets[edge];
+            self.buckets[edge] |= novel;
+            new_buckets += novel.count_ones() as usize;
+        }
+        new_buckets
+    }
+
+    /// Records the edges, returns the ones that were not seen before
+    pub fn merge(&mut self, edges: &[u32]) -> Vec<u32> {
+        let mut new_edges = Vec::new();
+        for &edge in edges {
+            let word = edge as usize / 64;
+            if word >= self.seen.len() {
+                self.seen.resize(word + 1, 0);
+            }
+            let bit = 1u64 << (edge % 64);
+            if self.seen[word] & bit == 0 {
+                self.seen[word] |= bit;
+                new_edges.push(edge);
+            }
+        }
+        new_edges
+    }
+}
+
+/// Same as init_reprl_safe, but starts the given engine instead of the one from TARGET/BIN.
+/// Results on this thread are classified for that engine from now on.
+pub fn init_reprl_with_engine(worker_id: usize, engine: &EngineConfig) {
+    let engine_name = CString::new(engine.engine.as_str()).unwrap();
+    let binary = CString::new(engine.binary.as_str()).unwrap();
+    let args: Vec<CString> = engine.args.iter().map(|arg| CString::new(arg.as_str()).unwrap()).collect();
+    let mut arg_ptrs: Vec<*const i8> = args.iter().map(|arg| arg.as_ptr() as *const i8).collect();
+    arg_ptrs.push(ptr::null());
+    let config = ReprlConfig {
+        engine: engine_name.as_ptr() as *const i8,
+        binary: binary.as_ptr() as *const i8,
+        extra_args: arg_ptrs.as_ptr(),
+        wasm_baseline: std::env::var("BASELINE").is_ok() as i32,
+        print_bytecode: 0,
+        capture_stdout: CAPTURE_ON_CRASH,
+        capture_stderr: CAPTURE_ON_CRASH,
+        spawn_timeout_ms: 0,
+        channel_capacity: [0; 4],
+    };
+    unsafe {
+        if reprl_init_with_config(worker_id as i32, &config) != 0 {
+            panic!("Failed to initialize {} for worker {}", engine.engine, worker_id);
+        }
+        spawn(worker_id as i32);
+        coverage_finish_initialization(worker_id, 0);
+    }
+    RESULT_PROFILE.with(|profile| profile.set(Some(engine.result_profile())));
+}
 pub fn v8_reprl_check(worker_id: i32){
 
     let test_code = "var x = 1;";
-    let test_code = format!("{}\x00", test_code);
-    let result = unsafe { execute_script(test_code.as_ptr() as *mut i8, 100, 0, worker_id) };
+    let result = execute_str(test_code, 100, worker_id as usize);
     println!("Success result: {}", result);
     assert_eq!(get_result_code(result), ResultCode::Success);
     // Check timeout
     let test_code = "while(true){}";
-    let test_code = format!("{}\x00", test_code);
-    let result = unsafe { execute_script(test_code.as_ptr() as *mut i8, 100, 0, worker_id) };
+    let result = execute_str(test_code, 100, worker_id as usize);
     println!("Timeout result: {}", result);
     assert_eq!(get_result_code(result), ResultCode::Timeout); //timeout code
 
     let test_code = "var x =";
-    let test_code = format!("{}\x00", test_code);
-    let result = unsafe { execute_script(test_code.as_ptr() as *mut i8, 1000, 0, worker_id) };
+    let result = execute_str(test_code, 1000, worker_id as usize);
     println!("Error result: {}", result);
     assert_eq!(get_result_code(result), ResultCode::Error); //error code
 
     let test_code = "fuzzilli('FUZZILLI_CRASH', 0);";
-    let test_code = format!("{}\x00", test_code);
-    let result = unsafe { execute_script(test_code.as_ptr() as *mut i8, 1000, 0, worker_id) };
+    let result = execute_str(test_code, 1000, worker_id as usize);
     println!("Crash result: {}", result);
     assert_eq!(get_result_code(result), ResultCode::Crash);
 
     let test_code = "fuzzilli('FUZZILLI_CRASH', 1);";
-    let test_code = format!("{}\x00", test_code);
-    let result = unsafe { execute_script(test_code.as_ptr() as *mut i8, 1000, 0, worker_id) };
+    let result = execute_str(test_code, 1000, worker_id as usize);
     println!("Crash result: {}", result);
     assert_eq!(get_result_code(result), ResultCode::Crash);
 
     let test_code = "fuzzilli('FUZZILLI_CRASH', 2);";
-    let test_code = format!("{}\x00", test_code);
-    let result = unsafe { execute_script(test_code.as_ptr() as *mut i8, 1000, 0, worker_id) };
+    let result = execute_str(test_code, 1000, worker_id as usize);
     println!("Crash result: {}", result);
     assert_eq!(get_result_code(result), ResultCode::Crash);
 
     // let test_code = "fuzzilli('FUZZILLI_CRASH', 3);";
     // let test_code = format!("{}\x00", test_code);
-    // let result = unsafe { execute_script(test_code.as_ptr() as *mut i8, 1000, 0, worker_id) };
+    // let result = execute_str(test_code, 1000, worker_id as usize);
     // println!("result: {}", result);
     // assert_eq!(get_result_code(result), ResultCode::Crash);
 
@@ -154,34 +464,28 @@ pub fn v8_reprl_check(worker_id: i32){
 }
 pub fn gecko_reprl_check(worker_id: i32){
     let test_code = "var x = 1;";
-    let test_code = format!("{}\x00", test_code);
-    let result = unsafe { execute_script(test_code.as_ptr() as *mut i8, 100, 0, worker_id) };
+    let result = execute_str(test_code, 100, worker_id as usize);
     assert_eq!(get_result_code(result), ResultCode::Success);
     // Check timeout
     let test_code = "while(true){}";
-    let test_code = format!("{}\x00", test_code);
-    let result = unsafe { execute_script(test_code.as_ptr() as *mut i8, 100, 0, worker_id) };
+    let result = execute_str(test_code, 100, worker_id as usize);
     assert_eq!(get_result_code(result), ResultCode::Timeout); //timeout code
 
     let test_code = "var x =";
-    let test_code = format!("{}\x00", test_code);
-    let result = unsafe { execute_script(test_code.as_ptr() as *mut i8, 1000, 0, worker_id) };
+    let result = execute_str(test_code, 1000, worker_id as usize);
     assert_eq!(get_result_code(result), ResultCode::Error); //error code
 
     let test_code = "fuzzilli('FUZZILLI_CRASH', 0);";
-    let test_code = format!("{}\x00", test_code);
     println!("test_code: {}", test_code);
-    let result = unsafe { execute_script(test_code.as_ptr() as *mut i8, 1000, 0, worker_id) };
+    let result = execute_str(test_code, 1000, worker_id as usize);
     assert_eq!(get_result_code(result), ResultCode::Crash);
 
     let test_code = "fuzzilli('FUZZILLI_CRASH', 1);";
-    let test_code = format!("{}\x00", test_code);
-    let result = unsafe { execute_script(test_code.as_ptr() as *mut i8, 1000, 0, worker_id) };
+    let result = execute_str(test_code, 1000, worker_id as usize);
     assert_eq!(get_result_code(result), ResultCode::Crash);
 
     let test_code = "fuzzilli('FUZZILLI_CRASH', 2);";
-    let test_code = format!("{}\x00", test_code);
-    let result = unsafe { execute_script(test_code.as_ptr() as *mut i8, 1000, 0, worker_id) };
+    let result = execute_str(test_code, 1000, worker_id as usize);
     assert_eq!(get_result_code(result), ResultCode::Crash);
 }
 
@@ -194,31 +498,331 @@ pub fn common_subset(set1: &mut [u32], set2: &mut [u32]) -> Vec<u32> {
 }
 
 
+/// Serializes a script straight into the data channel of a worker, so it can be executed without another copy
+pub struct ScriptWriter {
+    buffer: *mut u8,
+    capacity: usize,
+    len: usize,
+    worker_id: usize,
+}
+
+impl ScriptWriter {
+    pub fn new(worker_id: usize) -> Option<Self> {
+        let mut capacity = 0u64;
+        let buffer = unsafe { reprl_get_script_buffer(worker_id as i32, &mut capacity) };
+        if buffer.is_null() {
+            return None;
+        }
+        Some(ScriptWriter { buffer, capacity: capacity as usize, len: 0, worker_id })
+    }
+
+    pub fn len(&self) -> usize {
+        self.len
+    }
+
+    /// Execute the script written so far, timeout in milliseconds like execute_script
+    pub fn execute(self, timeout: i32) -> i32 {
+        unsafe { reprl_execute_in_place(self.worker_id as i32, self.len as u64, timeout) }
+    }
+
+    /// Same as execute, with the timeout in microseconds
+    pub fn execute_us(self, timeout_us: u64) -> i32 {
+        unsafe { reprl_execute_in_place_us(self.worker_id as i32, self.len as u64, timeout_us) }
+    }
+}
+
+impl std::io::Write for ScriptWriter {
+    fn write(&mut self, buf: &[u8]) -> std::io::Result<usize> {
+        let n = buf.len().min(self.capacity - self.len);
+        unsafe { ptr::copy_nonoverlapping(buf.as_ptr(), self.buffer.add(self.len), n) };
+        self.len += n;
+        Ok(n)
+    }
+
+    fn flush(&mut self) -> std::io::Result<()> {
+        Ok(())
+    }
+}
+
+/// Execute a script given as &str. Unlike execute_script, the script doesn't have to be NUL-terminated
+/// (trailing NULs are ignored) and it is copied only once, directly into the data channel.
+pub fn execute_str(script: &str, timeout: i32, worker_id: usize) -> i32 {
+    execute_str_us(script, timeout as u64 * 1000, worker_id)
+}
+
+/// Same as execute_str, with the timeout in microseconds
+pub fn execute_str_us(script: &str, timeout_us: u64, worker_id: usize) -> i32 {
+    use std::io::Write;
+    let mut writer = match ScriptWriter::new(worker_id) {
+        Some(writer) => writer,
+        None => return -1,
+    };
+    if writer.write_all(script.trim_end_matches('\0').as_bytes()).is_err() {
+        // Script is larger than the data channel
+        return -1;
+    }
+    writer.execute_us(timeout_us)
+}
+
+/// Derives the timeout of the next execution from the execution times of a worker, see --adaptive-timeout.
+/// The configured limit is used until enough executions were seen and always stays the upper bound.
+pub struct AdaptiveTimeout {
+    /// Successful executions by execution time, bucket i holds times below 2^i microseconds
+    buckets: [u64; 40],
+    samples: u64,
+    limit_us: u64,
+    current_us: u64,
+}
+
+impl AdaptiveTimeout {
+    /// Executions needed before the timeout drops below the limit
+    const MIN_SAMPLES: u64 = 256;
+    /// The timeout is this multiple of the 99th percentile
+    const FACTOR: u64 = 5;
+    const MIN_TIMEOUT_US: u64 = 1000;
+
+    pub fn new(limit_ms: i32) -> Self {
+        let limit_us = limit_ms.max(1) as u64 * 1000;
+        AdaptiveTimeout { buckets: [0; 40], samples: 0, limit_us, current_us: limit_us }
+    }
+
+    /// Records the time of a successful execution in microseconds
+    pub fn record(&mut self, execution_time_us: u64) {
+        let bucket = (64 - execution_time_us.leading_zeros() as usize).min(self.buckets.len() - 1);
+        self.buckets[bucket] += 1;
+        self.samples += 1;
+        if self.samples >= Self::MIN_SAMPLES && self.samples % 64 == 0 {
+            self.current_us = self.percentile_us(99).saturating_mul(Self::FACTOR).clamp(Self::MIN_TIMEOUT_US, self.limit_us);
+        }
+    }
+
+    /// Upper bound of the bucket holding the given percentile of the recorded executions
+    fn percentile_us(&self, percent: u64) -> u64 {
+        let wanted = (self.samples * percent + 99) / 100;
+        let mut seen = 0;
+        for (bucket, count) in self.buckets.iter().enumerate() {
+            seen += count;
+            if seen >= wanted {
+                return 1u64 << bucket;
+            }
+        }
+        self.limit_us
+    }
+
+    pub fn timeout_us(&self) -> u64 {
+        self.current_us
+    }
+
+    pub fn limit_us(&self) -> u64 {
+        self.limit_us
+    }
+}
+
+/// Returns how quickly this worker gets new engine processes ready, None if it has no REPRL context yet
+pub fn spawn_stats(worker_id: usize) -> Option<SpawnStats> {
+    let mut stats = SpawnStats::default();
+    if unsafe { reprl_get_spawn_stats(worker_id as i32, &mut stats) } != 0 {
+        return None;
+    }
+    Some(stats)
+}
+
+/// Returns a snapshot of the per-phase latency histograms of this worker, None if it was never initialized
+pub fn phase_histograms(worker_id: usize) -> Option<[PhaseHistogram; PHASE_NAMES.len()]> {
+    let mut histograms = [PhaseHistogram::default(); PHASE_NAMES.len()];
+    if unsafe { reprl_get_phase_histograms(worker_id as i32, histograms.as_mut_ptr()) } != 0 {
+        return None;
+    }
+    Some(histograms)
+}
+
+/// Starts checkpointing the virgin bits of this worker to path (plus path.delta), see coverage_checkpoint_open() in reprl.h
+pub fn open_coverage_checkpoint(worker_id: usize, path: &Path) -> bool {
+    let Ok(path) = CString::new(path.to_string_lossy().as_bytes()) else { return false };
+    unsafe { coverage_checkpoint_open(worker_id as i32, path.as_ptr()) == 0 }
+}
+
+/// Replaces the virgin bits of this worker with a checkpoint, returns the number of edges it contains
+pub fn load_coverage_checkpoint(worker_id: usize, path: &Path) -> Option<i32> {
+    let path = CString::new(path.to_string_lossy().as_bytes()).ok()?;
+    let edges = unsafe { coverage_load_checkpoint(worker_id as i32, path.as_ptr()) };
+    if edges < 0 { None } else { Some(edges) }
+}
+
+/// Capture policies for ReprlConfig::capture_stdout/capture_stderr, see REPRL_CAPTURE_* in reprl.h
+pub const CAPTURE_OFF: i32 = 0;
+pub const CAPTURE_ALWAYS: i32 = 1;
+pub const CAPTURE_ON_CRASH: i32 = 2;
+
+/// Output channels for fetch_output, see REPRL_CHANNEL_* in reprl.h
+pub const CHANNEL_FUZZOUT: i32 = 1;
+pub const CHANNEL_STDOUT: i32 = 2;
+pub const CHANNEL_STDERR: i32 = 3;
+
+/// Output of the last execution on the given channel, empty if the channel didn't capture it
+pub fn fetch_output(worker_id: usize, channel: i32) -> String {
+    let mut length = 0u64;
+    unsafe {
+        let data = reprl_fetch_output(worker_id as i32, channel, &mut length);
+        if data.is_null() {
+            return String::new();
+        }
+        String::from_utf8_lossy(std::slice::from_raw_parts(data, length as usize)).into_owned()
+    }
+}
+
+/// Reads an output channel of the current execution of a worker while the engine is still writing it,
+/// see reprl_read_output() in reprl.h. A new reader has to be used for every execution.
+pub struct OutputReader {
+    worker_id: i32,
+    channel: i32,
+    offset: u64,
+}
+
+impl OutputReader {
+    pub fn new(worker_id: usize, channel: i32) -> Self {
+        OutputReader { worker_id: worker_id as i32, channel, offset: 0 }
+    }
+
+    /// Returns what was written since the last call, None if there is nothing new
+    pub fn read(&mut self) -> Option<&[u8]> {
+        let mut length = 0;
+        let data = unsafe { reprl_read_output(self.worker_id, self.channel, &mut self.offset, &mut length) };
+        if data.is_null() || length == 0 {
+            return None;
+        }
+        Some(unsafe { std::slice::from_raw_parts(data, length as usize) })
+    }
+}
+
+/// Executes the script once more with stdout and stderr captured, also on workers that only capture on demand.
+/// Returns both outputs, usually to keep the engine's report next to a crash.
+pub fn execute_captured(script: &str, timeout: i32, worker_id: usize) -> (i32, String, String) {
+    unsafe { reprl_capture_next_execution(worker_id as i32) };
+    let result = execute_str(script, timeout, worker_id);
+    (result, fetch_output(worker_id, CHANNEL_STDOUT), fetch_output(worker_id, CHANNEL_STDERR))
+}
+
+/// Drives the engines of several workers from one thread, see struct reprl_executor in reprl.h.
+/// Every worker can have one execution in flight, the completions arrive in the order the engines finish.
+pub struct Executor {
+    raw: *mut std::ffi::c_void,
+    capacity: usize,
+}
+
+impl Executor {
+    pub fn new(capacity: usize) -> Option<Self> {
+        let raw = unsafe { reprl_executor_create(capacity as u32) };
+        if raw.is_null() { None } else { Some(Executor { raw, capacity }) }
+    }
+
+    /// Starts the script on the engine of the worker. Returns false if it could not be started,
+    /// e.g. because the worker is still executing.
+    pub fn submit(&mut self, worker_id: usize, script: &str, timeout: i32) -> bool {
+        let script = script.trim_end_matches('\0');
+        unsafe { reprl_executor_submit(self.raw, worker_id as i32, script.as_ptr() as *const i8, script.len() as u64, timeout) == 0 }
+    }
+
+    /// Waits for at least one execution to finish, at most wait_ms milliseconds (-1 waits until one does).
+    /// The coverage of a completed execution is evaluated with cov_evaluate on its worker as usual.
+    /// Fails if the engines could not be polled, the executions in flight are then lost.
+    pub fn wait(&mut self, wait_ms: i32) -> io::Result<Vec<Completion>> {
+        let mut completions = vec![Completion::default(); self.capacity];
+        let count = unsafe { reprl_executor_wait(self.raw, completions.as_mut_ptr(), self.capacity as u32, wait_ms) };
+        if count < 0 {
+            return Err(io::Error::new(io::ErrorKind::Other, "Failed to wait for the executions"));
+        }
+        completions.truncate(count as usize);
+        Ok(completions)
+    }
+}
+
+// An executor may move to another thread, it just must not be used from two at once
+unsafe impl Send for Executor {}
+
+impl Drop for Executor {
+    fn drop(&mut self) {
+        unsafe { reprl_executor_destroy(self.raw) };
+    }
+}
+
+/// Result of one script of an execute_batch call
+pub struct BatchResult {
+    pub status: i32,
+    /// Execution time in microseconds
+    pub execution_time: u64,
+    /// Borrowed from the edge arena, see EdgeSet
+    pub new_edges: EdgeSet,
+}
+
+/// Worker ids from here on belong to the bytecode collecting pool, see REPRL_BYTECODE_WORKER_BASE in reprl.h
+pub const BYTECODE_WORKER_BASE: usize = 1024;
+
+/// Id of the REPRL context of one slot of the bytecode pool, see BytecodePool
+pub fn bytecode_worker_id(slot: usize) -> usize {
+    BYTECODE_WORKER_BASE + slot
+}
+
+/// Maximum number of scripts per execute_batch call, see REPRL_MAX_BATCH_SIZE in reprl.h
+pub const MAX_BATCH_SIZE: usize = 256;
+
+/// Execute several scripts with a single REPRL command. The coverage of every script is evaluated right after it ran.
+/// The batch ends early on a timeout or crash, so the result can be shorter than scripts.
+pub fn execute_batch(scripts: &[&str], timeout: i32, worker_id: usize) -> Vec<BatchResult> {
+    let count = scripts.len().min(MAX_BATCH_SIZE);
+    let pointers: Vec<*const i8> = scripts[..count].iter().map(|s| s.as_ptr() as *const i8).collect();
+    // Scripts are passed by length, so a trailing NUL (as expected by execute_script) is not sent along.
+    let lengths: Vec<u64> = scripts[..count].iter().map(|s| s.trim_end_matches('\0').len() as u64).collect();
+    let timeouts = vec![timeout; count];
+    let mut statuses = vec![0i32; count];
+    let mut execution_times = vec![0u64; count];
+    let mut new_edges = vec![EdgeSet::new(); count];
+
+    let executed = unsafe {
+        execute_script_batch(
+            pointers.as_ptr(),
+            lengths.as_ptr(),
+            timeouts.as_ptr(),
+            count as i32,
+            statuses.as_mut_ptr(),
+            execution_times.as_mut_ptr(),
+            new_edges.as_mut_ptr(),
+            worker_id as i32,
+        )
+    };
+    if executed <= 0 {
+        return Vec::new();
+    }
+
+    statuses.into_iter()
+        .zip(execution_times)
+        .zip(new_edges)
+        .take(executed as usize)
+        .map(|((status, execution_time), new_edges)| BatchResult { status, execution_time, new_edges })
+        .collect()
+}
+
 /// Extract coverage of a testcase with proper initialization
 pub fn extract_testcase_coverage(
     js_code: &str,
     worker_id: usize,
     mutated_edges: &EdgeSet,
-) -> EdgeSet {
+) -> Vec<u32> {
     let test_code = js_code;
-    let mut edges = mutated_edges.clone();
+    let mut edges = mutated_edges.as_slice().to_vec();
     
     // Run the test multiple times and collect common edges
     let mut last_common_len = 0;
     for _ in 0..5 {
-        unsafe {
-            crate::execute_script(test_code.as_ptr() as *mut i8, crate::MAX_TIMEOUT, 0, worker_id as i32);
-        }
+        execute_str(test_code, unsafe { crate::MAX_TIMEOUT }, worker_id);
         let mut new_edges = EdgeSet::new();
         unsafe {
             crate::cov_evaluate(worker_id, &mut new_edges);
         }
         reset_edge_set(worker_id, &mut new_edges);
-        // Convert edge indices to Vec<u32> for common_subset calculation
-        let common = if edges.count > 0 && new_edges.count > 0 {
-            let edges_slice = unsafe { std::slice::from_raw_parts_mut(edges.edge_indices, edges.count as usize) };
-            let new_edges_slice = unsafe { std::slice::from_raw_parts_mut(new_edges.edge_indices, new_edges.count as usize) };
-            common_subset(edges_slice, new_edges_slice)
+        let common = if !edges.is_empty() && new_edges.count > 0 {
+            let mut new_edges_slice = new_edges.as_slice().to_vec();
+            common_subset(&mut edges, &mut new_edges_slice)
         } else {
             Vec::new()
         };
@@ -229,9 +833,7 @@ pub fn extract_testcase_coverage(
                break;
             }
             last_common_len = common.len();
-            edges.count = common.len() as u32;
-            edges.edge_indices = common.as_ptr() as *mut u32;
-            std::mem::forget(common); // Prevent deallocation since we're using the raw pointer
+            edges = common;
         }
         
     }
@@ -240,75 +842,68 @@ pub fn extract_testcase_coverage(
 }
 
 
+/// Executes js_code once and checks that it still hits most of the given edges (same 80% threshold as
+/// maintain_coverage_with_mutated_edges). The virgin bits are not touched, so edges that are already known count too.
+pub fn reproduces_edges(js_code: &str, worker_id: usize, edges: &[u32]) -> bool {
+    if edges.is_empty() {
+        return false;
+    }
+    execute_str(js_code, unsafe { crate::MAX_TIMEOUT }, worker_id);
+    let hit = unsafe { cov_count_hit_edges(worker_id, edges.as_ptr(), edges.len() as u32) };
+    hit as f32 / edges.len() as f32 > 0.8
+}
+
 pub fn maintain_coverage_with_mutated_edges(
     js_code: &str,
     worker_id: usize,
     mutated_edges: &EdgeSet,
 ) -> (bool, bool) {
     let test_code = js_code;
-    let mut edges = mutated_edges.clone();
+    let edges = mutated_edges.as_slice();
+    // The original edges are looked up with one AND over the bitmap, see cov_count_target_hits
+    let targets = unsafe { cov_set_target_edges(worker_id as i32, edges.as_ptr(), edges.len() as u32) };
+    if targets <= 0 {
+        return (false, false);
+    }
     let mut is_new_coverage = false;
-    for i in 0..5 {
-        unsafe {
-            let result =crate::execute_script(
-                test_code.as_ptr() as *mut i8,
-                crate::MAX_TIMEOUT,
-                0,
-                worker_id as i32,
-            );
-            let mut new_edges = EdgeSet::new();
-            crate::cov_evaluate(worker_id, &mut new_edges);
-            reset_edge_set(worker_id, &mut new_edges);
-            if get_result_code(result) == ResultCode::Crash {
-                is_new_coverage = true;
-            }
-            if get_result_code(result) == ResultCode::Success {
-                if new_edges.count > edges.count {
-                    is_new_coverage = true;
-                }
-                let mut is_found = false;
-                for i in 0..new_edges.count {
-                    let edge_idx = unsafe { *new_edges.edge_indices.add(i as usize) };
-                    for j in 0..edges.count {
-                        if unsafe { *edges.edge_indices.add(j as usize) } == edge_idx {
-                            is_found = true;
-                            break;
-                        }
-                    }
-                    
-                }
-                if !is_found {
-                    is_new_coverage = true;
-                }
-            }
-
-
-           
-            // reset the new edges so it can be triggered again
-            // println!("Original edges count {} New edges count {}", edges.count, new_edges.count);
-            // check if original edges are subset of new edges
-            let mut found_edges = Vec::new();
-            for i in 0..edges.count {
-                let original_edge = unsafe { *edges.edge_indices.add(i as usize) };
-                for j in 0..new_edges.count {
-                    if unsafe { *new_edges.edge_indices.add(j as usize) } == original_edge {
-                        // crate::cov_clear_edge_data(worker_id, original_edge);
-                        found_edges.push(j);
-                        break;
-                    }
-                    
-
-                }
-            }
-            // println!("Found {} out of {} edges", found_edges.len(), edges.count);
-            if found_edges.len() as f32 / edges.count as f32 > 0.8 {
-                return (true, is_new_coverage);
-            }
-            // for i in 0..std::cmp::min(edges.count, new_edges.count) {
-            //     println!("Original edge {} New edge {}", unsafe { *edges.edge_indices.add(i as usize) }, unsafe { *new_edges.edge_indices.add(i as usize) });
-            // }
+    for _ in 0..5 {
+        let result = execute_str(test_code, unsafe { crate::MAX_TIMEOUT }, worker_id);
+        let mut new_edges = EdgeSet::new();
+        unsafe { crate::cov_evaluate(worker_id, &mut new_edges) };
+        // reset the new edges so it can be triggered again
+        reset_edge_set(worker_id, &mut new_edges);
+        let hits = unsafe { cov_count_target_hits(worker_id as i32) };
+        if get_result_code(result) == ResultCode::Crash {
+            is_new_coverage = true;
+        }
+        // The caller reset the original edges, so every one that was hit is also in new_edges
+        if get_result_code(result) == ResultCode::Success && (new_edges.count > mutated_edges.count || hits == 0) {
+            is_new_coverage = true;
+        }
+        // check if original edges are subset of new edges
+        if hits as f32 / targets as f32 > 0.8 {
+            return (true, is_new_coverage);
         }
-
     }
     (false, is_new_coverage)
-}
\ No newline at end of file
+}
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_edge_domain_reports_only_unseen_edges() {
+        let mut domain = EdgeDomain::new();
+        assert_eq!(domain.merge(&[3, 700, 3]), vec![3, 700]);
+        assert_eq!(domain.merge(&[700, 64, 3]), vec![64]);
+        assert!(domain.merge(&[64]).is_empty());
+    }
+
+    #[test]
+    fn test_edge_domain_counts_new_buckets() {
+        let mut domain = EdgeDomain::new();
+        assert_eq!(domain.merge_counts(&[5, 9], &[1, 4]), 2);
+        assert_eq!(domain.merge_counts(&[5, 9], &[2, 4]), 1);
+        assert_eq!(domain.merge_counts(&[5], &[3]), 0);
+    }
+}
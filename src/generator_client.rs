@@ -1,10 +1,11 @@
 use serde::{Deserialize, Serialize};
 use serde_json::Value;
-use std::io::{BufRead, BufReader, Write};
+use std::io::{BufReader, Read, Write};
 use std::process::{Command, Stdio};
-use std::sync::mpsc;
+use std::sync::atomic::{AtomicBool, Ordering};
+use std::sync::{mpsc, Arc, Mutex};
 use std::thread;
-use std::time::Instant;
+use std::time::{Duration, Instant};
 
 #[derive(Serialize, Deserialize, Debug)]
 struct Message {
@@ -21,9 +22,14 @@ struct GenerateRequest {
     max_statements: Option<u32>,
     #[serde(rename = "outputDir")]
     output_dir: Option<String>,
+    // Comes back in every frame of the batch
+    batch: u32,
+    // Literals the generated programs should use, see CmpDictionary
+    #[serde(skip_serializing_if = "Vec::is_empty")]
+    dictionary: Vec<String>,
 }
 
-#[derive(Deserialize, Debug)]
+#[derive(Deserialize, Debug, Clone)]
 pub struct TestCase {
     pub id: u32,
     pub filename: Option<String>,
@@ -42,124 +48,148 @@ struct GenerateComplete {
     output_dir: Option<String>,
 }
 
-pub struct GeneratorClient {
+// Binary frames of the bridge, see sendFrame in rust-ts-ipc/ts-app/src/generator-simple.ts.
+// A frame is a header of five little-endian u32 (kind, batch, id, length of the first part, length of
+// the second part) followed by both parts. batch is the one of the generate request, 0 outside of a batch.
+const FRAME_HEADER_SIZE: usize = 20;
+const FRAME_TEST_CASE: u32 = 1;  // Parts are the code and the state
+const FRAME_MESSAGE: u32 = 2;    // First part is a JSON Message
+
+// Default number of test cases that are kept ready, set with GENERATOR_PREFETCH
+const DEFAULT_PREFETCH: usize = 50;
+
+// How long the bridge may take for the next reply, time spent handing test cases on does not count
+const GENERATE_TIMEOUT: Duration = Duration::from_secs(20);
+
+// Replies carry the batch of their frame
+enum Reply {
+    Message(u32, Message),
+    TestCase(u32, TestCase),
+}
+
+/// The Node bridge process, owned by the prefetch thread once the client is set up
+struct Bridge {
     stdin: std::process::ChildStdin,
-    rx: mpsc::Receiver<Message>,
+    rx: mpsc::Receiver<Reply>,
     _child: std::process::Child,
+    // The batch generate() waits for, frames of older ones are left over from a failed batch
+    batch: u32,
 }
 
-impl GeneratorClient {
-    pub fn new() -> Result<Self, Box<dyn std::error::Error>> {
+impl Bridge {
+    fn spawn() -> Result<Self, Box<dyn std::error::Error>> {
         // Start the TypeScript generator bridge with unique process identifier
         let unique_id = format!("{}-{:?}", std::process::id(), std::thread::current().id());
         let mut child = Command::new("node")
             .arg("rust-ts-ipc/ts-app/dist/generator-simple.js")
             .env("GENERATOR_ID", unique_id)
+            .env("GENERATOR_FRAMES", "1")
             .stdin(Stdio::piped())
             .stdout(Stdio::piped())
             .stderr(Stdio::null()) // Suppress stderr to avoid cluttering
             .spawn()?;
 
-        let mut stdin = child.stdin.take().ok_or("Failed to get stdin")?;
+        let stdin = child.stdin.take().ok_or("Failed to get stdin")?;
         let stdout = child.stdout.take().ok_or("Failed to get stdout")?;
 
         // Set up channel for receiving messages
         let (tx, rx) = mpsc::channel();
 
         // Spawn thread to read responses
-        thread::spawn(move || {
-            let reader = BufReader::new(stdout);
-            for line in reader.lines() {
-                if let Ok(line) = line {
-                    if let Ok(msg) = serde_json::from_str::<Message>(&line) {
-                        tx.send(msg).ok();
-                    }
-                }
-            }
-        });
-
-        // Send initialization message
-        let init_msg = Message {
-            msg_type: "init".to_string(),
-            data: Value::Null,
-        };
-        writeln!(stdin, "{}", serde_json::to_string(&init_msg)?)?;
-        stdin.flush()?;
-
-        // Wait for init response
-        let mut client = GeneratorClient {
-            stdin,
-            rx,
-            _child: child,
-        };
+        thread::spawn(move || Self::read_frames(stdout, tx));
 
-        // Wait for initialization response
-        if let Ok(response) = client.rx.recv() {
-            if response.msg_type != "init_response" {
-                return Err("Failed to initialize generator".into());
+        Ok(Bridge { stdin, rx, _child: child, batch: 0 })
+    }
+
+    fn read_frames(stdout: std::process::ChildStdout, tx: mpsc::Sender<Reply>) {
+        let mut reader = BufReader::with_capacity(1 << 16, stdout);
+        let mut header = [0u8; FRAME_HEADER_SIZE];
+        while reader.read_exact(&mut header).is_ok() {
+            let field = |i: usize| u32::from_le_bytes(header[i * 4..i * 4 + 4].try_into().unwrap());
+            let (kind, batch, id) = (field(0), field(1), field(2));
+            let mut first = vec![0u8; field(3) as usize];
+            let mut second = vec![0u8; field(4) as usize];
+            if reader.read_exact(&mut first).is_err() || reader.read_exact(&mut second).is_err() {
+                break;
+            }
+            let reply = match kind {
+                FRAME_TEST_CASE => Reply::TestCase(batch, TestCase {
+                    id,
+                    filename: None,
+                    code: String::from_utf8(first).ok(),
+                    state: String::from_utf8(second).ok(),
+                }),
+                FRAME_MESSAGE => match serde_json::from_slice::<Message>(&first) {
+                    Ok(msg) => Reply::Message(batch, msg),
+                    Err(_) => continue,
+                },
+                _ => continue,
+            };
+            if tx.send(reply).is_err() {
+                break;
             }
         }
-
-        Ok(client)
     }
 
-    pub fn generate_test_cases(&mut self, count: u32, min_statements: u32, max_statements: u32) -> Result<Vec<TestCase>, Box<dyn std::error::Error>> {
-        // Send stop message first to ensure clean state
-        let stop_msg = Message {
-            msg_type: "stop".to_string(),
-            data: Value::Null,
-        };
-        writeln!(self.stdin, "{}", serde_json::to_string(&stop_msg)?)?;
+    fn send(&mut self, msg_type: &str, data: Value) -> Result<(), Box<dyn std::error::Error>> {
+        let msg = Message { msg_type: msg_type.to_string(), data };
+        writeln!(self.stdin, "{}", serde_json::to_string(&msg)?)?;
         self.stdin.flush()?;
-        
-        // Wait a brief moment for stop to process
-        std::thread::sleep(std::time::Duration::from_millis(50));
-        
+        Ok(())
+    }
+
+    fn init(&mut self) -> Result<(), Box<dyn std::error::Error>> {
+        self.send("init", Value::Null)?;
+        // Wait for initialization response
+        match self.rx.recv_timeout(GENERATE_TIMEOUT) {
+            Ok(Reply::Message(_, response)) if response.msg_type == "init_response" => Ok(()),
+            _ => Err("Failed to initialize generator".into()),
+        }
+    }
+
+    /// Requests one batch and hands every test case to `deliver` as soon as it arrives.
+    /// Stops early if `deliver` returns false.
+    fn generate(&mut self, params: GenerateParams, deliver: &mut dyn FnMut(TestCase) -> bool) -> Result<(), Box<dyn std::error::Error>> {
         // Use unique output directory per process to avoid conflicts
         let worker_id = std::process::id();
         let output_dir = format!("/tmp/rust-generated-{}", worker_id);
+        // 0 is for frames outside of a batch
+        self.batch = self.batch.wrapping_add(1).max(1);
         
-        let generate_request = GenerateRequest {
-            count,
-            min_statements: Some(min_statements),
-            max_statements: Some(max_statements),
+        let generate_request = serde_json::to_value(GenerateRequest {
+            count: params.count,
+            min_statements: Some(params.min_statements),
+            max_statements: Some(params.max_statements),
             output_dir: Some(output_dir),
-        };
-
-        let generate_msg = Message {
-            msg_type: "generate".to_string(),
-            data: serde_json::to_value(generate_request)?,
-        };
-
-        writeln!(self.stdin, "{}", serde_json::to_string(&generate_msg)?)?;
-        self.stdin.flush()?;
-
-        let mut test_cases = Vec::new();
-
-        // Collect responses with timeout
-        let timeout_duration = std::time::Duration::from_secs(20);
-        let start_time = Instant::now();
+            batch: self.batch,
+            dictionary: params.dictionary,
+        })?;
+        self.send("generate", generate_request.clone())?;
 
+        // Collect responses with timeout. The deadline starts over after every test case, so a full
+        // prefetch buffer that blocks deliver() does not count as a slow bridge.
+        let mut deadline = Instant::now() + GENERATE_TIMEOUT;
         loop {
-            if start_time.elapsed() > timeout_duration {
+            if Instant::now() > deadline {
                 return Err("Generator timeout".into());
             }
 
-            if let Ok(response) = self.rx.recv_timeout(std::time::Duration::from_millis(100)) {
-                match response.msg_type.as_str() {
-                    "test_case" => {
-                        if let Ok(test_case) = serde_json::from_value::<TestCase>(response.data) {
-                            test_cases.push(test_case);
-                        }
-                    }
-                    "generate_complete" => {
-                        break;
+            match self.rx.recv_timeout(Duration::from_millis(100)) {
+                Ok(Reply::TestCase(batch, _)) | Ok(Reply::Message(batch, _)) if batch != self.batch => {}
+                Ok(Reply::TestCase(_, test_case)) => {
+                    if !deliver(test_case) {
+                        return Ok(());
                     }
+                    deadline = Instant::now() + GENERATE_TIMEOUT;
+                }
+                Ok(Reply::Message(_, response)) => match response.msg_type.as_str() {
+                    "generate_complete" => return Ok(()),
                     "error" => {
                         let error_msg = response.data.as_str().unwrap_or("Unknown error");
                         if error_msg.contains("Generation already in progress") {
-                            // Wait a bit and retry
-                            std::thread::sleep(std::time::Duration::from_millis(100));
+                            // Wait a bit and ask again
+                            std::thread::sleep(Duration::from_millis(100));
+                            self.send("generate", generate_request.clone())?;
                             continue;
                         }
                         return Err(format!("Generator error: {:?}", response.data).into());
@@ -167,20 +197,116 @@ impl GeneratorClient {
                     _ => {
                         // Ignore progress and other messages
                     }
+                },
+                Err(mpsc::RecvTimeoutError::Timeout) => {}
+                Err(mpsc::RecvTimeoutError::Disconnected) => return Err("Generator exited".into()),
+            }
+        }
+    }
+
+    /// Resets the bridge after a failed batch
+    fn reset(&mut self) {
+        if self.send("stop", Value::Null).is_ok() {
+            // Wait a brief moment for stop to process
+            std::thread::sleep(Duration::from_millis(50));
+        }
+        while self.rx.try_recv().is_ok() {}
+    }
+}
+
+#[derive(Clone)]
+struct GenerateParams {
+    count: u32,
+    min_statements: u32,
+    max_statements: u32,
+    dictionary: Vec<String>,
+}
+
+/// Test cases of the generator bridge, produced ahead of time.
+///
+/// A background thread keeps up to GENERATOR_PREFETCH test cases ready, so the bridge generates
+/// while the worker executes. The bridge sends them as binary frames, so the JS source is not
+/// JSON escaped on the way.
+pub struct GeneratorClient {
+    ready: mpsc::Receiver<Result<TestCase, String>>,
+    params: Arc<Mutex<GenerateParams>>,
+    stop: Arc<AtomicBool>,
+}
+
+impl GeneratorClient {
+    pub fn new() -> Result<Self, Box<dyn std::error::Error>> {
+        let mut bridge = Bridge::spawn()?;
+        bridge.init()?;
+
+        let prefetch = std::env::var("GENERATOR_PREFETCH").ok().and_then(|v| v.parse().ok()).unwrap_or(DEFAULT_PREFETCH).max(1);
+        let (ready_tx, ready) = mpsc::sync_channel(prefetch);
+        let params = Arc::new(Mutex::new(GenerateParams { count: 10, min_statements: 5, max_statements: 10, dictionary: Vec::new() }));
+        let stop = Arc::new(AtomicBool::new(false));
+        {
+            let params = params.clone();
+            let stop = stop.clone();
+            thread::spawn(move || Self::prefetch(bridge, ready_tx, params, stop));
+        }
+        Ok(GeneratorClient { ready, params, stop })
+    }
+
+    fn prefetch(mut bridge: Bridge, ready: mpsc::SyncSender<Result<TestCase, String>>, params: Arc<Mutex<GenerateParams>>, stop: Arc<AtomicBool>) {
+        while !stop.load(Ordering::Relaxed) {
+            let batch = params.lock().unwrap().clone();
+            let mut open = true;
+            // Blocks while the buffer is full, which throttles the bridge
+            let result = bridge.generate(batch, &mut |test_case| {
+                open = ready.send(Ok(test_case)).is_ok();
+                open
+            });
+            if !open {
+                break;
+            }
+            if let Err(e) = result {
+                if ready.send(Err(e.to_string())).is_err() {
+                    break;
                 }
+                bridge.reset();
             }
         }
+        bridge.send("exit", Value::Null).ok();
+    }
 
+    /// Takes up to count test cases from the ready buffer. Only waits if the buffer is empty.
+    /// The statement limits apply to the batches generated from now on.
+    pub fn generate_test_cases(&mut self, count: u32, min_statements: u32, max_statements: u32) -> Result<Vec<TestCase>, Box<dyn std::error::Error>> {
+        {
+            let mut params = self.params.lock().unwrap();
+            params.count = count;
+            params.min_statements = min_statements;
+            params.max_statements = max_statements;
+        }
+
+        let mut test_cases = Vec::new();
+        match self.ready.recv_timeout(GENERATE_TIMEOUT) {
+            Ok(Ok(test_case)) => test_cases.push(test_case),
+            Ok(Err(e)) => return Err(e.into()),
+            Err(mpsc::RecvTimeoutError::Timeout) => return Err("Generator timeout".into()),
+            Err(mpsc::RecvTimeoutError::Disconnected) => return Err("Generator exited".into()),
+        }
+        while test_cases.len() < count as usize {
+            match self.ready.try_recv() {
+                Ok(Ok(test_case)) => test_cases.push(test_case),
+                // A later batch failed, the prefetch thread already reset the bridge and the cases we have are still good
+                Ok(Err(_)) | Err(_) => break,
+            }
+        }
         Ok(test_cases)
     }
 
-    pub fn shutdown(mut self) -> Result<(), Box<dyn std::error::Error>> {
-        let exit_msg = Message {
-            msg_type: "exit".to_string(),
-            data: Value::Null,
-        };
-        writeln!(self.stdin, "{}", serde_json::to_string(&exit_msg)?)?;
-        self.stdin.flush()?;
+    /// Literals for the batches generated from now on
+    pub fn set_dictionary(&mut self, dictionary: Vec<String>) {
+        self.params.lock().unwrap().dictionary = dictionary;
+    }
+
+    pub fn shutdown(self) -> Result<(), Box<dyn std::error::Error>> {
+        // The prefetch thread tells the bridge to exit once it notices, at the latest when its next send fails
+        self.stop.store(true, Ordering::Relaxed);
         Ok(())
     }
-} 
\ No newline at end of file
+} 
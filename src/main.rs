@@ -9,6 +9,14 @@ mod corpus;
 use corpus::*;
 mod corpus_aspect;
 use corpus_aspect::*;
+mod corpus_arena;
+use corpus_arena::*;
+mod minimizer;
+use minimizer::*;
+mod sync;
+use sync::*;
+mod cmplog;
+use cmplog::*;
 mod generator_client;
 use generator_client::*;
 use std::sync::mpsc::{channel,Sender, Receiver};
@@ -19,6 +27,7 @@ use std::io::{self, Read, Write};
 use std::sync::atomic::{AtomicI32, Ordering};
 use std::time::Duration;
 use std::time::Instant;
+use std::ptr;
 use structopt::StructOpt;
 use std::fs::OpenOptions;
 use chrono::Utc;
@@ -60,6 +69,24 @@ struct Opt {
     network_worker: bool,
     #[structopt(long = "port", default_value = "9999")]
     port: u16,
+    /// Engines to fuzz in this process, e.g. "v8=/out/d8:96,firefox=/out/js:32". Overrides --num-workers and TARGET/BIN
+    #[structopt(long = "pool")]
+    pool: Option<String>,
+    /// Fraction of new corpus reports the master executes again to confirm that the reported edges reproduce
+    #[structopt(long = "confirm-rate", default_value = "0")]
+    confirm_rate: f64,
+    /// Derive the timeout of each execution from the execution times seen so far, --timeout stays the upper limit
+    #[structopt(long = "adaptive-timeout")]
+    adaptive_timeout: bool,
+    /// Start the master from the coverage checkpoint in the output directory instead of an empty coverage map
+    #[structopt(long = "resume-coverage")]
+    resume_coverage: bool,
+    /// Address the master accepts sync links from other nodes on, e.g. 0.0.0.0:9100
+    #[structopt(long = "sync-listen")]
+    sync_listen: Option<String>,
+    /// Comma separated sync addresses of the other nodes, each node should list all others
+    #[structopt(long = "sync-peers")]
+    sync_peers: Option<String>,
 }
 
 
@@ -68,6 +95,10 @@ enum WorkerMessage {
         program_ir: String,
         js_code: String,
         pass: String,
+        // New edges the worker found, the master merges them instead of executing the sample again
+        edges: Vec<u32>,
+        // With REPRL_HITCOUNTS=1 the new hit count bucket of every edge in edges, empty otherwise
+        buckets: Vec<u32>,
     },
     Crash {
         program_ir: String,
@@ -77,8 +108,12 @@ enum WorkerMessage {
 
 enum MasterMessage {
     NewCorpus {
-        program_ir: String,
-        js_code: String,
+        // Borrowed from the corpus arena, sending them does not copy the program
+        program_ir: ProgramText,
+        js_code: ProgramText,
+        edges: Vec<u32>,
+        // Parallel to edges like in WorkerMessage::NewCorpus
+        buckets: Vec<u32>,
     },
 }
 
@@ -89,6 +124,12 @@ struct Fuzzer {
     to_master: Sender<WorkerMessage>,
     from_master: Receiver<MasterMessage>,
     generator_client: Option<GeneratorClient>,
+    // Set with --adaptive-timeout, otherwise every execution gets MAX_TIMEOUT
+    adaptive_timeout: Option<AdaptiveTimeout>,
+    // Comparison operands for the generator, None unless REPRL_CMPLOG=1 and the engine supports it
+    cmp_dictionary: Option<CmpDictionary>,
+    // REPRL_HITCOUNTS=1 and the engine maintains the hit count map, new hit count buckets count as new coverage
+    hitcounts: bool,
 }
 
 
@@ -158,6 +199,8 @@ struct Stats {
     total_timeouts: u64,
     total_errors: u64,
     total_coverage: i32,
+    // Hit count buckets the master merged on edges it had seen before, see REPRL_HITCOUNTS
+    total_buckets: i32,
     corpus_size: i32,
     start_time: Option<Instant>,
     last_coverage_time: Option<Instant>,
@@ -170,6 +213,7 @@ static mut STATS: Stats = Stats {
     total_timeouts: 0,
     total_errors: 0,
     total_coverage: 0,
+    total_buckets: 0,
     corpus_size: 0,
     start_time: None,
     last_coverage_time: None,
@@ -256,11 +300,31 @@ fn format_duration(duration: Duration) -> String {
         format!("{:>6}s ", duration_secs as u64)
     }
 }
-fn write_stats_to_xml(total_execs: u64, total_crashes: u64, coverage_pct: f64, exec_per_sec: f64) {
+// Phase histograms of all workers added up
+fn merged_phase_histograms() -> [PhaseHistogram; PHASE_NAMES.len()] {
+    let mut merged = [PhaseHistogram::default(); PHASE_NAMES.len()];
+    for worker_stat in unsafe { STATS.worker_stats.iter() } {
+        if let Some(histograms) = phase_histograms(worker_stat.worker_id) {
+            for (total, histogram) in merged.iter_mut().zip(histograms.iter()) {
+                total.merge(histogram);
+            }
+        }
+    }
+    merged
+}
+
+fn write_stats_to_xml(total_execs: u64, total_crashes: u64, coverage_pct: f64, exec_per_sec: f64, phases: &[PhaseHistogram]) {
     let timestamp = Utc::now().timestamp();
+    let mut phase_entries = String::new();
+    for (name, histogram) in PHASE_NAMES.iter().zip(phases.iter()) {
+        phase_entries.push_str(&format!(
+            "  <phase name=\"{}\" count=\"{}\" p50_ns=\"{}\" p99_ns=\"{}\" max_ns=\"{}\"/>\n",
+            name, histogram.count, histogram.percentile_ns(50.0), histogram.percentile_ns(99.0), histogram.max_ns
+        ));
+    }
     let xml_entry = format!(
-        "<entry>\n  <timestamp>{}</timestamp>\n  <executions>{}</executions>\n  <crashes>{}</crashes>\n  <coverage>{:.2}</coverage>\n  <exec_per_sec>{:.2}</exec_per_sec>\n</entry>\n",
-        timestamp, total_execs, total_crashes, coverage_pct, exec_per_sec
+        "<entry>\n  <timestamp>{}</timestamp>\n  <executions>{}</executions>\n  <crashes>{}</crashes>\n  <coverage>{:.2}</coverage>\n  <exec_per_sec>{:.2}</exec_per_sec>\n{}</entry>\n",
+        timestamp, total_execs, total_crashes, coverage_pct, exec_per_sec, phase_entries
     );
 
     if let Ok(mut file) = OpenOptions::new()
@@ -309,6 +373,9 @@ fn print_stats() {
                 TOTOAL_COVERAGE = 331671;
             }
             println!("Total coverage: {} ({:.2}%)", STATS.total_coverage, STATS.total_coverage as f64 / TOTOAL_COVERAGE as f64 * 100.0);
+            if STATS.total_buckets > 0 {
+                println!("New hit count buckets: {}", STATS.total_buckets);
+            }
             println!(
                 "Time since last new coverage: {:?} seconds ago",
                 last_cov_time.elapsed().as_secs()
@@ -333,12 +400,14 @@ fn print_stats() {
             }
             
             let coverage_pct = STATS.total_coverage as f64 / 1703484 as f64 * 100.0;
+            let phases = merged_phase_histograms();
             if elapsed % 60 == 0 {
                 write_stats_to_xml(
                     STATS.total_executions,
                     STATS.total_crashes,
                     coverage_pct,
-                    exec_per_sec
+                    exec_per_sec,
+                    &phases
                 );
             }
           
@@ -396,9 +465,25 @@ fn print_stats() {
                     }
                 };
                 
+                // Average and worst time until a new engine process was ready
+                let spawn_str = match spawn_stats(worker_stat.worker_id) {
+                    Some(spawn) if spawn.spawns > 0 => format!(
+                        "spawn avg {:.1}ms max {:.1}ms ({} spawns, {} failed){}",
+                        spawn.average_us() as f64 / 1000.0,
+                        spawn.max_us as f64 / 1000.0,
+                        spawn.spawns,
+                        spawn.failures,
+                        match spawn.average_refill_us() {
+                            Some(refill_us) => format!(", standby refill avg {:.1}ms", refill_us as f64 / 1000.0),
+                            None => String::new(),
+                        }
+                    ),
+                    _ => "spawn -".to_string(),
+                };
+
                 // Format stats with aligned columns
                 println!(
-                    "{:<8} {} | executed {:<6} | cov {:<6} | corpus {:<6} | last cov {:<3} seconds ago",
+                    "{:<8} {} | executed {:<6} | cov {:<6} | corpus {:<6} | last cov {:<3} seconds ago | {}",
                     worker_id,
                     status_str,
                     worker_stat.total_fuzzed,
@@ -406,10 +491,25 @@ fn print_stats() {
                     worker_stat.total_corpus_size,
                     worker_stat.last_coverage_time
                         .map(|t| t.elapsed().as_secs())
-                        .unwrap_or_default()
+                        .unwrap_or_default(),
+                    spawn_str
                 );
             }
 
+            // Where the time of an execution goes, over all workers
+            let phase_str: Vec<String> = PHASE_NAMES.iter().zip(phases.iter())
+                .filter(|(_, histogram)| histogram.count > 0)
+                .map(|(name, histogram)| format!(
+                    "{} p50 {:.1}us p99 {:.1}us",
+                    name,
+                    histogram.percentile_ns(50.0) as f64 / 1000.0,
+                    histogram.percentile_ns(99.0) as f64 / 1000.0
+                ))
+                .collect();
+            if !phase_str.is_empty() {
+                println!("Phases: {}", phase_str.join(" | "));
+            }
+
             println!("----------------------------------------");
             print_passes(); 
             // Flush to ensure immediate display
@@ -486,6 +586,15 @@ fn update_stats(worker_id: usize, result: i32, new_cov: i32, state: WorkerState,
         }
     }
 }
+// Counts hit count buckets apart from the edges update_stats counts, only the master's are totaled
+fn update_bucket_stats(worker_id: usize, new_buckets: i32) {
+    unsafe {
+        if worker_id == NUM_WORKERS && new_buckets > 0 {
+            STATS.total_buckets += new_buckets;
+            STATS.last_coverage_time = Some(Instant::now());
+        }
+    }
+}
 fn init_stats() {
     unsafe {
         STATS.start_time = Some(Instant::now());
@@ -496,15 +605,70 @@ fn init_stats() {
 struct Config {
     corpus_dir: PathBuf,
     output_dir: PathBuf,
+    confirm_rate: f64,
+    adaptive_timeout: bool,
+    resume_coverage: bool,
+    sync_listen: Option<String>,
+    sync_peers: Vec<String>,
+    // Empty unless --pool was given, then the workers are assigned to the engines in order
+    pool: Vec<EngineConfig>,
 }
 impl Config {
     fn new() -> io::Result<Self> {
         let opt = Opt::from_args();
+        let pool = match &opt.pool {
+            Some(spec) => EngineConfig::parse_pool(spec).map_err(|e| io::Error::new(io::ErrorKind::InvalidInput, e))?,
+            None => Vec::new(),
+        };
+        // The shared virgin map is indexed by edge, which only means the same edge within one binary
+        let shared_virgin = std::env::var("REPRL_SHARED_VIRGIN").map_or(false, |value| value == "1");
+        if shared_virgin && pool.iter().any(|engine| engine.binary != pool[0].binary) {
+            return Err(io::Error::new(io::ErrorKind::InvalidInput, "REPRL_SHARED_VIRGIN=1 needs a --pool with a single binary"));
+        }
         Ok(Config {
             corpus_dir: opt.corpus_dir,
             output_dir: opt.output_dir,
+            confirm_rate: opt.confirm_rate,
+            adaptive_timeout: opt.adaptive_timeout,
+            resume_coverage: opt.resume_coverage,
+            sync_listen: opt.sync_listen,
+            sync_peers: opt.sync_peers.iter()
+                .flat_map(|peers| peers.split(','))
+                .map(str::trim)
+                .filter(|peer| !peer.is_empty())
+                .map(str::to_string)
+                .collect(),
+            pool,
         })
     }
+
+    // The engine of a worker. The master (and everything past the pool) uses the first engine.
+    fn engine_for(&self, worker_id: usize) -> Option<&EngineConfig> {
+        let mut first = 0;
+        for engine in &self.pool {
+            if worker_id < first + engine.workers {
+                return Some(engine);
+            }
+            first += engine.workers;
+        }
+        self.pool.first()
+    }
+
+    // The coverage domain of a worker: the first pool entry running the same binary. Edges of
+    // different binaries are unrelated, domain 0 is the one of the master's own context.
+    fn coverage_domain(&self, worker_id: usize) -> usize {
+        match self.engine_for(worker_id) {
+            Some(engine) => self.pool.iter().position(|other| other.binary == engine.binary).unwrap_or(0),
+            None => 0,
+        }
+    }
+
+    fn init_reprl(&self, worker_id: usize) {
+        match self.engine_for(worker_id) {
+            Some(engine) => init_reprl_with_engine(worker_id, engine),
+            None => init_reprl_safe(worker_id),
+        }
+    }
 }
 
 // Simple function to generate JavaScript code and program IR
@@ -525,9 +689,7 @@ impl Fuzzer {
             let js_code = "".to_string();
             println!("Slave {} is executing {}", self.worker_id, count);
             count += 1;
-            unsafe {
-                execute_script(js_code.as_ptr() as *mut i8, MAX_TIMEOUT, 0, self.worker_id as i32);
-            }
+            execute_str(&js_code, unsafe { MAX_TIMEOUT }, self.worker_id);
         }
         let mut new_edges = EdgeSet::new();
         let new_cov = unsafe { cov_evaluate(self.worker_id as usize, &mut new_edges) };
@@ -547,7 +709,7 @@ impl Fuzzer {
         fs::create_dir_all(opt.output_dir.join("corpus_ir_min"))?;
         fs::create_dir_all(opt.output_dir.join("crashes"))?;
         println!("Corpus directory: {}", opt.corpus_dir.display());
-        init_reprl_safe(worker_id ); 
+        opt.init_reprl(worker_id); 
         if unsafe { worker_id == NUM_WORKERS }{
             let program_ir = "{\"type\":\"NonTerminal\",\"symbol\":\"Program\",\"children\":[]}";
             "".to_string();
@@ -585,30 +747,26 @@ impl Fuzzer {
                 if js_code.is_empty() {
                     continue;
                 }
-                let result = unsafe {
-                execute_script(
-                        js_code.as_ptr() as *mut i8,
-                        MAX_TIMEOUT,    
-                        0,
-                        worker_id as i32,
-                    )
-                    };
+                let result = execute_str(&js_code, unsafe { MAX_TIMEOUT }, worker_id);
                     // Skip modules that timeout or fail
                     if get_result_code(result) == ResultCode::Timeout {
                         println!("Module {} timed out, skipping", counter);
                         continue;
                     }
                     // Evaluate coverage
+                    unsafe { cov_reset_edge_arena(worker_id) };
                     let mut new_edges = EdgeSet::new();
                     let new_cov = unsafe { cov_evaluate(worker_id as usize, &mut new_edges) };
-                    if new_cov == 0 {
+                    if new_cov <= 0 {
                         println!("Module {} produced no coverage, skipping", counter);
                         continue;
                     }
                     println!("Module {} produced {} edges", counter, new_edges.count);
                     fs::write(opt.output_dir.join("corpus_ir_min").join(format!("{}.json", counter)), program_ir.clone()).unwrap();
                     update_stats(worker_id, 0, new_cov as i32, WorkerState::Executing, corpus.entries.len() as i32);
-                    corpus.add_entry(CorpusEntry::new(  program_ir.clone()  , js_code.clone()));
+                    // Only the master gets here, the workers share its arena copy through set_corpus
+                    let (program_ir, js_code) = ProgramText::intern(program_ir, js_code);
+                    corpus.add_entry(CorpusEntry::new(program_ir, js_code));
                     
                 }
                 
@@ -632,6 +790,9 @@ impl Fuzzer {
             None
         };
 
+        // Only the generator gets to use the operands
+        let cmp_dictionary = if generator_client.is_some() { CmpDictionary::new(worker_id) } else { None };
+
         Ok(Fuzzer {
             corpus,
             output_dir: opt.output_dir.clone(),
@@ -639,8 +800,25 @@ impl Fuzzer {
             to_master,
             from_master,
             generator_client,
+            adaptive_timeout: if opt.adaptive_timeout { Some(AdaptiveTimeout::new(unsafe { MAX_TIMEOUT })) } else { None },
+            cmp_dictionary,
+            hitcounts: unsafe { cov_hitcounts_enabled(worker_id) } != 0,
         })
     }
+    // Timeout of the next execution in microseconds
+    fn timeout_us(&self) -> u64 {
+        match &self.adaptive_timeout {
+            Some(timeouts) => timeouts.timeout_us(),
+            None => (unsafe { MAX_TIMEOUT }) as u64 * 1000,
+        }
+    }
+    fn record_execution_time(&mut self, result: i32, elapsed_time: Duration) {
+        if let Some(timeouts) = &mut self.adaptive_timeout {
+            if get_result_code(result) == ResultCode::Success {
+                timeouts.record(elapsed_time.as_micros() as u64);
+            }
+        }
+    }
     fn update_entry_result(&mut self, result: i32, new_cov: i32, entry_index: u32) {
         match get_result_code(result) {
             ResultCode::Success => {
@@ -661,27 +839,77 @@ impl Fuzzer {
       
 
         update_stats(self.worker_id, 0, 0, WorkerState::Mutating, self.corpus.entries.len() as i32);
+        unsafe { cov_reset_edge_arena(self.worker_id) };
         // FUZZ_MODE=1 is for generating new modules base on wasm smith
-        let mut start_time = Instant::now();
         let fuzz_mode =  std::env::var("FUZZ_MODE").unwrap_or_else(|_| "0".to_string());
         if entry.js_code.is_empty() {
             return Ok(());
         }
-            let result = unsafe {
-                execute_script(
-                    entry.js_code.clone().as_ptr() as *mut i8,
-                    MAX_TIMEOUT,
-                    0,
-                    self.worker_id as i32,
-                )
-            };
+            let timeout_us = self.timeout_us();
+            let mut result = execute_str_us(&entry.js_code, timeout_us, self.worker_id);
+            // Inputs that are only too slow for the adaptive timeout get the full limit before they count as a timeout
+            if get_result_code(result) == ResultCode::Timeout && timeout_us < (unsafe { MAX_TIMEOUT }) as u64 * 1000 {
+                result = execute_str(&entry.js_code, unsafe { MAX_TIMEOUT }, self.worker_id);
+            }
             update_stats(self.worker_id, result, 0, WorkerState::Executing, self.corpus.entries.len() as i32);
           
-            let elapsed_time = start_time.elapsed();
+            // Measured by the C core around the wait for the status, so without our own overhead
+            let elapsed_time = Duration::from_micros(unsafe { reprl_last_execution_time(self.worker_id as i32) });
+            self.record_execution_time(result, elapsed_time);
            
 
             let mut new_edges = EdgeSet::new();
-            let new_cov = unsafe { cov_evaluate(self.worker_id as usize, &mut new_edges) };
+            if self.hitcounts {
+                // Also marks the edges in the edge bitmap, the next execution clears that map
+                let mut counts = EdgeCounts::new();
+                unsafe { cov_evaluate_counts(self.worker_id, &mut new_edges, &mut counts) };
+                return self.process_execution_result(entry, passes, result, &new_edges, Some(&counts), elapsed_time);
+            }
+            unsafe { cov_evaluate_and_reset(self.worker_id as usize, &mut new_edges) };
+            self.process_execution_result(entry, passes, result, &new_edges, None, elapsed_time)
+    }
+
+    // Runs a whole generated batch with one REPRL command and processes the results like run_single_input does.
+    fn run_batch(&mut self, entries: Vec<CorpusEntry>, passes: &mut Vec<String>) -> io::Result<()> {
+        update_stats(self.worker_id, 0, 0, WorkerState::Mutating, self.corpus.entries.len() as i32);
+        unsafe { cov_reset_edge_arena(self.worker_id) };
+        let entries: Vec<CorpusEntry> = entries.into_iter().filter(|entry| !entry.js_code.is_empty()).collect();
+        // The hit count map is only reset per REPRL command, so every script needs its own
+        if self.hitcounts {
+            for entry in entries {
+                self.run_single_input(entry, passes)?;
+            }
+            return Ok(());
+        }
+        for chunk in entries.chunks(MAX_BATCH_SIZE) {
+            let scripts: Vec<&str> = chunk.iter().map(|entry| entry.js_code.as_str()).collect();
+            // Batches take milliseconds, a timeout here is retried by run_single_input with the full limit
+            let timeout_ms = ((self.timeout_us() + 999) / 1000) as i32;
+            let results = execute_batch(&scripts, timeout_ms, self.worker_id);
+            let mut executed = results.len();
+            for (entry, batch_result) in chunk.iter().zip(results) {
+                if get_result_code(batch_result.status) == ResultCode::Timeout && timeout_ms < unsafe { MAX_TIMEOUT } {
+                    executed -= 1;
+                    break;
+                }
+                update_stats(self.worker_id, batch_result.status, 0, WorkerState::Executing, self.corpus.entries.len() as i32);
+                let elapsed_time = Duration::from_micros(batch_result.execution_time);
+                self.record_execution_time(batch_result.status, elapsed_time);
+                self.process_execution_result(entry.clone(), passes, batch_result.status, &batch_result.new_edges, None, elapsed_time)?;
+            }
+            // The batch ends at the first timeout or crash, the rest is executed individually.
+            for entry in chunk.iter().skip(executed) {
+                self.run_single_input(entry.clone(), passes)?;
+            }
+        }
+        Ok(())
+    }
+
+    // counts holds the buckets of new_edges in hit count mode. new_edges then also has the edges that only reached
+    // a new bucket, the sample is kept for those as well but only the edges that were never hit count as coverage.
+    fn process_execution_result(&mut self, entry: CorpusEntry, passes: &mut Vec<String>, result: i32, new_edges: &EdgeSet, counts: Option<&EdgeCounts>, elapsed_time: Duration) -> io::Result<()> {
+            let new_cov = new_edges.count as i32;
+            let novel_edges = counts.map_or(new_cov, |counts| counts.new_edges as i32);
             let file_name = format!("{}_{}.js",  self.worker_id,  new_cov);
             
             // Create corpus entry for potential addition
@@ -712,15 +940,17 @@ impl Fuzzer {
                 if has_new_coverage {
                     update_stats(self.worker_id, 
                         0, 
-                        new_cov as i32, 
+                        novel_edges, 
                         WorkerState::Executing, 
                         self.corpus.entries.len() as i32);
                     self.update_entry_result(result, new_cov, entry.index);
                     
                     match self.to_master.send(WorkerMessage::NewCorpus {
-                        program_ir: entry.program_ir.clone(),
-                        js_code: entry.js_code.clone(),
+                        program_ir: entry.program_ir.to_string(),
+                        js_code: entry.js_code.to_string(),
                         pass: passes[0].clone(),
+                        edges: new_edges.as_slice().to_vec(),
+                        buckets: counts.map_or_else(Vec::new, |counts| counts.as_slice().to_vec()),
                     }) {
                         Ok(_) => {
                             // self.log("Successfully sent coverage to master");
@@ -746,9 +976,11 @@ impl Fuzzer {
                     self.corpus.add_entry(CorpusEntry::new(new_entry.program_ir.clone(), new_entry.js_code.clone()));
                     update_passes("BytecodeNovelty".to_string(), result, 0, 0);
                     match self.to_master.send(WorkerMessage::NewCorpus {
-                        program_ir: new_entry.program_ir.clone(),
-                        js_code: new_entry.js_code.clone(),
+                        program_ir: new_entry.program_ir.to_string(),
+                        js_code: new_entry.js_code.to_string(),
                         pass: "BytecodeNovelty".to_string(),
+                        edges: Vec::new(),
+                        buckets: Vec::new(),
                     }) {
                         Ok(_) => {
                             // self.log("Successfully sent bytecode novel entry to master");
@@ -779,15 +1011,22 @@ impl Fuzzer {
             if get_result_code(result) == ResultCode::Crash {
                 update_stats(self.worker_id, 0, 0, WorkerState::SavingCrash, self.corpus.entries.len() as i32);
                 self.log(&format!("Crash detected with result {}", result));
+                // Regular executions don't capture the engine's output, so run the crash once more to get its report.
+                let (_, stdout, stderr) = execute_captured(&entry.js_code, unsafe { MAX_TIMEOUT }, self.worker_id);
                 match self.save_crash( &entry.js_code, &file_name) {
-                    Ok(_) => self.log("Successfully saved crash locally"),
+                    Ok(js_file) => {
+                        self.log("Successfully saved crash locally");
+                        if let Err(e) = self.save_crash_output(&js_file, &stdout, &stderr) {
+                            self.log(&format!("Failed to save crash output: {}", e));
+                        }
+                    }
                     Err(e) => self.log(&format!("Failed to save crash locally: {}", e)),
                 }
                 
                 self.log("Sending crash to master...");
                 match self.to_master.send(WorkerMessage::Crash {
-                    program_ir: entry.program_ir.clone(),
-                    js_code: entry.js_code.clone(),
+                    program_ir: entry.program_ir.to_string(),
+                    js_code: entry.js_code.to_string(),
                 }) {
                     Ok(_) => self.log("Successfully sent crash to master"),
                     Err(e) => self.log(&format!("Failed to send crash to master: {}", e)),
@@ -822,7 +1061,7 @@ impl Fuzzer {
         &mut self,
         test_code: &str,
         original_file: &str,
-    ) -> io::Result<()> {
+    ) -> io::Result<PathBuf> {
         let timestamp = chrono::Local::now().format("%Y%m%d_%H%M%S");
         // First save the crash
         let js_filename = format!("{}_{}_{}.js", original_file, self.worker_id, timestamp);
@@ -830,7 +1069,15 @@ impl Fuzzer {
         let test_code_ = test_code.replace("\x00", "");
         fs::write(&js_file, test_code_.as_bytes())?;
 
-        Ok(())
+        Ok(js_file)
+    }
+    /// Stores the engine output of a crash next to its js file
+    fn save_crash_output(&self, js_file: &PathBuf, stdout: &str, stderr: &str) -> io::Result<()> {
+        if stdout.is_empty() && stderr.is_empty() {
+            return Ok(());
+        }
+        let log = format!("--- stdout ---\n{}\n--- stderr ---\n{}\n", stdout, stderr);
+        fs::write(js_file.with_extension("log"), log.as_bytes())
     }
     fn is_master(&self) -> bool {
         unsafe { self.worker_id == NUM_WORKERS }
@@ -899,44 +1146,36 @@ impl Fuzzer {
                         passes.clear();
                         passes.push("IPCGenerator".to_string());
                         
-                        for test_case in test_cases {
-                            if let Some(js_code) = test_case.code {
-                                self.run_single_input(CorpusEntry::new(test_case.state.unwrap_or("".to_string()), js_code), &mut passes)?;
-                            }
-                        }
+                        let entries: Vec<CorpusEntry> = test_cases.into_iter()
+                            .filter_map(|test_case| test_case.code.map(|js_code| CorpusEntry::new(test_case.state.unwrap_or("".to_string()), js_code)))
+                            .collect();
+                        self.run_batch(entries, &mut passes)?;
                     },
                     Err(e) => {
                         self.log(&format!("Failed to generate test cases via IPC: {}", e));
                     }
                 }
             } 
+            if let (Some(dictionary), Some(generator_client)) = (&mut self.cmp_dictionary, &mut self.generator_client) {
+                dictionary.absorb();
+                if let Some(values) = dictionary.take_update() {
+                    generator_client.set_dictionary(values);
+                }
+            }
             
             // Check for messages from master
             while let Ok(msg) = self.from_master.try_recv() {
                 match msg {
-                    MasterMessage::NewCorpus {  program_ir, js_code } => {
+                    MasterMessage::NewCorpus {  program_ir, js_code, edges, buckets } => {
                         // self.log("Received new corpus from master");
-                        update_stats(self.worker_id, 
-                            0, 
-                            0, 
-                            WorkerState::Executing, 
-                            self.corpus.entries.len() as i32);
-                        let start_time = Instant::now();
-                        let result = unsafe {
-                            execute_script(
-                                js_code.clone().as_ptr() as *mut i8,
-                                MAX_TIMEOUT,
-                                0,
-                                self.worker_id as i32,
-                            )
+                        // Take over the edges the sample was found with instead of executing it again
+                        let cov = unsafe { cov_merge_edges(self.worker_id, edges.as_ptr(), edges.len() as u32, ptr::null_mut()) };
+                        let new_buckets = if buckets.is_empty() {
+                            0
+                        } else {
+                            unsafe { cov_merge_counts(self.worker_id, edges.as_ptr(), buckets.as_ptr(), edges.len().min(buckets.len()) as u32) }
                         };
-                        let elapsed_time = start_time.elapsed();
-                        if elapsed_time > Duration::from_secs(5) {
-                            continue;
-                        }
-                        let mut new_edges = EdgeSet::new();
-                        let cov = unsafe { cov_evaluate(self.worker_id as usize, &mut new_edges) };
-                        if cov > 0 {
+                        if cov > 0 || new_buckets > 0 {
                             self.corpus.add_entry(CorpusEntry::new(program_ir, js_code));
                             update_stats(self.worker_id, 
                                 0, 
@@ -961,6 +1200,38 @@ struct Master {
     from_workers: Vec<Receiver<WorkerMessage>>,
     to_workers: Vec<Sender<MasterMessage>>,
     initialized: bool,
+    // Fraction of worker reports that are executed again before they are accepted, see --confirm-rate
+    confirm_rate: f64,
+    // The merged coverage is checkpointed here every CHECKPOINT_INTERVAL, None if that failed
+    checkpoint_path: Option<PathBuf>,
+    last_checkpoint: Instant,
+    // Reduces new corpus entries on the contexts after the master's, None with MINIMIZER_POOL_SIZE=0
+    minimizer: Option<MinimizerService<PendingSample>>,
+    // Links to the masters of the other nodes, None without --sync-listen and --sync-peers
+    sync: Option<SyncService>,
+    // Coverage domain of every worker, see Config::coverage_domain
+    worker_domains: Vec<usize>,
+    // The edges seen in every domain but 0, whose edges are merged into the master's context instead.
+    // Domain 0 only uses its entry for hit count buckets if the master's engine has no hit counts.
+    edge_domains: Vec<EdgeDomain>,
+}
+
+const CHECKPOINT_INTERVAL: Duration = Duration::from_secs(5);
+
+// A new corpus entry of the master, on its way through the minimizer
+struct PendingSample {
+    program_ir: String,
+    js_code: String,
+    // All edges the sample was reported with, they go on to the workers and the other nodes
+    edges: Vec<u32>,
+    // Hit count buckets of the edges, see WorkerMessage::NewCorpus
+    buckets: Vec<u32>,
+    // The edges that were new to the master, the minimized script has to hit them as well
+    new_edges: Vec<u32>,
+    // Name of the saved input, "_min_" is appended when the minimized script is kept
+    file_name: String,
+    // Worker that already has the entry, see Master::broadcast
+    skip: Option<usize>,
 }
 
 impl Master {
@@ -987,25 +1258,159 @@ impl Master {
             tx_dummy_worker,
             rx_dummy_master,
         ).await?;
-        init_reprl_safe(num_workers); 
+        config.init_reprl(num_workers); 
         
         // Create remote_corpus directory if it doesn't exist
         let remote_corpus_dir = config.output_dir.join("remote_corpus");
         fs::create_dir_all(&remote_corpus_dir)?;
+
+        let checkpoint_path = config.output_dir.join("coverage.ckpt");
+        if config.resume_coverage && checkpoint_path.exists() {
+            match load_coverage_checkpoint(num_workers, &checkpoint_path) {
+                Some(edges) => fuzzer.log(&format!("Resumed {} edges from {}", edges, checkpoint_path.display())),
+                None => fuzzer.log(&format!("Failed to resume coverage from {}", checkpoint_path.display())),
+            }
+        }
+        let checkpoint_path = if open_coverage_checkpoint(num_workers, &checkpoint_path) {
+            Some(checkpoint_path)
+        } else {
+            fuzzer.log(&format!("Failed to open coverage checkpoint {}", checkpoint_path.display()));
+            None
+        };
         
+        let minimizer_workers: Vec<usize> = (num_workers + 1..num_workers + 1 + minimizer_pool_size()).collect();
+        let minimizer_config = config.clone();
+        let minimizer = MinimizerService::start(minimizer_workers, unsafe { MAX_TIMEOUT }, move |worker_id| minimizer_config.init_reprl(worker_id));
+
+        let sync = if config.sync_listen.is_some() || !config.sync_peers.is_empty() {
+            let fingerprint = unsafe { coverage_fingerprint(num_workers as i32) };
+            let sync = SyncService::start(config.sync_listen.as_deref(), &config.sync_peers, fingerprint)?;
+            if let Some(address) = sync.local_addr() {
+                println!("[SYNC] Listening on {}", address);
+            }
+            Some(sync)
+        } else {
+            None
+        };
+
         Ok(Master {
             fuzzer,
             from_workers,
             to_workers,
             initialized: false,
+            confirm_rate: config.confirm_rate,
+            checkpoint_path,
+            last_checkpoint: Instant::now(),
+            minimizer,
+            sync,
+            worker_domains: (0..num_workers).map(|worker_id| config.coverage_domain(worker_id)).collect(),
+            edge_domains: (0..config.pool.len().max(1)).map(|_| EdgeDomain::new()).collect(),
         })
     }
+
+    // Queues the sample for the minimizer. Without one, or while its queue is full, the sample is added as it is.
+    fn add_sample(&mut self, sample: PendingSample) -> io::Result<()> {
+        let sample = match &self.minimizer {
+            Some(minimizer) => match minimizer.submit(sample.js_code.clone(), sample.new_edges.clone(), sample) {
+                Ok(()) => return Ok(()),
+                Err(sample) => sample,
+            },
+            None => sample,
+        };
+        self.finish_sample(sample, None)
+    }
+
+    // Adds the samples the minimizer is done with
+    fn poll_minimizer(&mut self) -> io::Result<()> {
+        let finished = match &self.minimizer {
+            Some(minimizer) => minimizer.poll(),
+            None => return Ok(()),
+        };
+        for (minimized, sample) in finished {
+            self.finish_sample(sample, minimized)?;
+        }
+        Ok(())
+    }
+
+    // Saves and distributes the sample, as the minimized script if the minimizer found one. The minimizer only
+    // returns scripts that hit all the new edges the original hits again, so they are not checked here.
+    fn finish_sample(&mut self, sample: PendingSample, minimized: Option<String>) -> io::Result<()> {
+        let (js_code, file_name) = match minimized.filter(|minimized| !minimized.is_empty()) {
+            Some(minimized) => (minimized, format!("{}_min_", sample.file_name)),
+            None => (sample.js_code, sample.file_name),
+        };
+        self.fuzzer.save_interesting_input(&js_code, &sample.program_ir, &file_name)?;
+
+        let (program_ir, js_code) = ProgramText::intern(sample.program_ir, js_code);
+        if let Some(sync) = &self.sync {
+            sync.publish(&program_ir, &js_code, &sample.edges);
+        }
+        self.broadcast(0, sample.skip, &program_ir, &js_code, &sample.edges, &sample.buckets);
+        self.fuzzer.corpus.add_entry(CorpusEntry::new(program_ir, js_code));
+        Ok(())
+    }
+
+    // Merges the hit count buckets of a report of domain 0, returns how many of them are new to the master.
+    // A master whose engine runs without hit counts keeps track of them in edge_domains[0] instead.
+    fn merge_buckets(&mut self, edges: &[u32], buckets: &[u32]) -> i32 {
+        if buckets.is_empty() {
+            return 0;
+        }
+        let count = edges.len().min(buckets.len());
+        let merged = unsafe { cov_merge_counts(self.fuzzer.worker_id, edges.as_ptr(), buckets.as_ptr(), count as u32) };
+        if merged >= 0 {
+            return merged;
+        }
+        self.edge_domains[0].merge_counts(&edges[..count], &buckets[..count]) as i32
+    }
+
+    // Hands a new corpus entry to the workers of the coverage domain, except to the one in skip
+    fn broadcast(&self, domain: usize, skip: Option<usize>, program_ir: &ProgramText, js_code: &ProgramText, edges: &[u32], buckets: &[u32]) {
+        for (target, tx) in self.to_workers.iter().enumerate() {
+            if self.worker_domains[target] != domain || skip == Some(target) {
+                continue;
+            }
+            if let Err(e) = tx.send(MasterMessage::NewCorpus {
+                program_ir: program_ir.clone(),
+                js_code: js_code.clone(),
+                edges: edges.to_vec(),
+                buckets: buckets.to_vec(),
+            }) {
+                self.fuzzer.log(&format!("Failed to send to worker: {}", e));
+            }
+        }
+    }
     
     // Fix the corpus clone method to correctly return the fuzzer's corpus
     fn get_corpus_clone(&self) -> CorpusManager {
         self.fuzzer.corpus.clone()
     }
     
+    // Takes over the entries of the other nodes with the edges they were found with, without executing them
+    fn poll_sync(&mut self) -> io::Result<()> {
+        let entries = match &self.sync {
+            Some(sync) => sync.poll(),
+            None => return Ok(()),
+        };
+        for entry in entries {
+            let new_cov = unsafe { cov_merge_edges(self.fuzzer.worker_id, entry.edges.as_ptr(), entry.edges.len() as u32, ptr::null_mut()) };
+            if new_cov <= 0 {
+                continue;
+            }
+            self.fuzzer.log(&format!("new cov: {} from sync", new_cov));
+            update_stats(unsafe { NUM_WORKERS }, 0, new_cov, WorkerState::CoverageCheck, self.fuzzer.corpus.entries.len() as i32);
+            self.fuzzer.save_interesting_input(&entry.js_code, &entry.program_ir, &format!("sync_{}", new_cov))?;
+
+            let (program_ir, js_code) = ProgramText::intern(entry.program_ir, entry.js_code);
+            if let Some(sync) = &self.sync {
+                sync.remember(&program_ir, &js_code, &entry.edges);
+            }
+            self.broadcast(0, None, &program_ir, &js_code, &entry.edges, &[]);
+            self.fuzzer.corpus.add_entry(CorpusEntry::new(program_ir, js_code));
+        }
+        Ok(())
+    }
+
     fn check_new_ast_files(&mut self) -> io::Result<()> {
         // Path to the remote_corpus directory
         let remote_corpus_dir = self.fuzzer.output_dir.join("remote_corpus");
@@ -1063,106 +1468,28 @@ impl Master {
             }
             // Execute the code and check for new coverage
             update_stats(unsafe { NUM_WORKERS }, 0, 0, WorkerState::Executing, self.fuzzer.corpus.entries.len() as i32);
+            unsafe { cov_reset_edge_arena(self.fuzzer.worker_id) };
             
-            let result = unsafe {
-                execute_script(
-                    js_code.as_ptr() as *mut i8,
-                    MAX_TIMEOUT,
-                    0,
-                    self.fuzzer.worker_id as i32,
-                )
-            };
+            let result = execute_str(&js_code, unsafe { MAX_TIMEOUT }, self.fuzzer.worker_id);
             
             let mut new_edges = EdgeSet::new();
-            let new_cov = unsafe { cov_evaluate(self.fuzzer.worker_id as usize, &mut new_edges) };
+            let new_cov = unsafe { cov_evaluate_and_reset(self.fuzzer.worker_id as usize, &mut new_edges) };
+            let edges = new_edges.as_slice().to_vec();
             
             self.fuzzer.log(&format!("Remote file {}: new coverage: {}", path.display(), new_cov));
             
             // If we found new coverage, process it
             if new_cov > 0 {
                 update_stats(unsafe { NUM_WORKERS }, result, new_cov as i32, WorkerState::Generating, self.fuzzer.corpus.entries.len() as i32);
-                
-                // Try to minimize the input
-                let mut minimized_ir_list = Vec::new();
-                let mut minimized_js_list = Vec::new();
-                
-            
-                
-                // Find the smallest minimized version that maintains coverage
-                let mut is_maintained = false;
-                let mut minimized_js_final = String::new();
-                let mut minimized_ir_final = String::new();
-                
-                if !minimized_js_list.is_empty() {
-                    // Sort by length
-                    minimized_js_list.sort_by_key(|js: &String| js.len());
-                    minimized_ir_list.sort_by_key(|ir: &String| ir.len());
-                    
-                    reset_edge_set(self.fuzzer.worker_id as usize, &mut new_edges);
-                    
-                    for (minimized_ir, minimized_js) in minimized_ir_list.iter().zip(minimized_js_list.iter()) {
-                        if minimized_js.is_empty() {
-                            continue;
-                        }
-                        
-                        (is_maintained, _) = maintain_coverage_with_mutated_edges(
-                            &minimized_js, 
-                            self.fuzzer.worker_id as usize, 
-                            &new_edges
-                        );
-                        
-                        if is_maintained {
-                            minimized_js_final = minimized_js.clone();
-                            minimized_ir_final = minimized_ir.clone();
-                            break;
-                        }
-                    }
-                    
-                    mark_edge_set(self.fuzzer.worker_id as usize, &mut new_edges);
-                }
-                
-                // Save and distribute the corpus entry
-                if is_maintained && !minimized_js_final.is_empty() {
-                    // Use minimized version
-                    let file_name = format!("remote_{}_min_", new_cov);
-                    self.fuzzer.save_interesting_input(
-                        &minimized_js_final,
-                        &minimized_ir_final,
-                        &file_name,
-                    )?;
-                    
-                    // Send to all workers
-                    for tx in &self.to_workers {
-                        if let Err(e) = tx.send(MasterMessage::NewCorpus {
-                            program_ir: minimized_ir_final.clone(),
-                            js_code: minimized_js_final.clone(),
-                        }) {
-                            self.fuzzer.log(&format!("Failed to send to worker: {}", e));
-                        }
-                    }
-                    
-                    self.fuzzer.corpus.add_entry(CorpusEntry::new(minimized_ir_final, minimized_js_final));
-                } else {
-                    // Use original version
-                    let file_name = format!("remote_{}", new_cov);
-                    self.fuzzer.save_interesting_input(
-                        &js_code,
-                        &program_ir,
-                        &file_name,
-                    )?;
-                    
-                    // Send to all workers
-                    for tx in &self.to_workers {
-                        if let Err(e) = tx.send(MasterMessage::NewCorpus {
-                            program_ir: program_ir.clone(),
-                            js_code: js_code.clone(),
-                        }) {
-                            self.fuzzer.log(&format!("Failed to send to worker: {}", e));
-                        }
-                    }
-                    
-                    self.fuzzer.corpus.add_entry(CorpusEntry::new(program_ir.clone(), js_code.clone()));
-                }
+                self.add_sample(PendingSample {
+                    program_ir,
+                    js_code,
+                    new_edges: edges.clone(),
+                    edges,
+                    buckets: Vec::new(),
+                    file_name: format!("remote_{}", new_cov),
+                    skip: None,
+                })?;
             }
             
             // Delete the processed file to avoid processing it again
@@ -1185,12 +1512,14 @@ impl Master {
         
         loop {
             // Check messages from all workers
-            for (worker_id, rx) in self.from_workers.iter().enumerate() {
-                match rx.try_recv() {
+            for worker_id in 0..self.from_workers.len() {
+                match self.from_workers[worker_id].try_recv() {
                     Ok(WorkerMessage::NewCorpus {
                         program_ir,
                         js_code,
                         pass,
+                        edges,
+                        buckets,
                     }) => {
                         consecutive_errors = 0;  // Reset error counter on successful message
                          // remove comment from test_code
@@ -1201,112 +1530,63 @@ impl Master {
                         if program_ir.len() > 100 * 1024 {
                             continue;
                         }
+                        // The master's context runs the binary of domain 0, the samples of the other binaries
+                        // can neither be executed nor minimized here and only go to the workers of their domain
+                        let domain = self.worker_domains[worker_id];
+                        if domain != 0 {
+                            let domain_edges = self.edge_domains[domain].merge(&edges);
+                            let domain_buckets = self.edge_domains[domain].merge_counts(&edges, &buckets);
+                            if domain_edges.is_empty() && domain_buckets == 0 {
+                                continue;
+                            }
+                            self.fuzzer.log(&format!("new cov: {} edges, {} buckets from worker {} in domain {}", domain_edges.len(), domain_buckets, worker_id, domain));
+                            let file_name = format!("{}_{}_{}_domain{}", unsafe { NUM_WORKERS }, domain_edges.len(), pass, domain);
+                            self.fuzzer.save_interesting_input(&js_code, &program_ir, &file_name)?;
+                            let (program_ir, js_code) = ProgramText::intern(program_ir, js_code);
+                            // Config::new refuses REPRL_SHARED_VIRGIN=1 with more than one domain
+                            self.broadcast(domain, None, &program_ir, &js_code, &edges, &buckets);
+                            continue;
+                        }
                         update_stats(unsafe { NUM_WORKERS }, 0, 0, WorkerState::Executing, self.fuzzer.corpus.entries.len() as i32);
-                        let start_time = Instant::now();
-                        let result = unsafe {
-                            execute_script(
-                                js_code.as_ptr() as *mut i8,
-                                MAX_TIMEOUT,
-                                0,
-                                self.fuzzer.worker_id as i32,
-                            )
-                        };
-                   
+                        unsafe { cov_reset_edge_arena(self.fuzzer.worker_id) };
+                        let shared_virgin = unsafe { cov_shared_virgin_enabled(self.fuzzer.worker_id) } != 0;
+                        // Executing every report again made the master the bottleneck, so only a sample of
+                        // them is checked for flakiness and the rest is trusted.
+                        if !edges.is_empty() && rand::thread_rng().gen_range(0.0..1.0) < self.confirm_rate {
+                            update_stats(unsafe { NUM_WORKERS }, 0, 0, WorkerState::CoverageCheck, self.fuzzer.corpus.entries.len() as i32);
+                            if !reproduces_edges(&js_code, self.fuzzer.worker_id, &edges) {
+                                self.fuzzer.log(&format!("Discarding flaky sample from worker {}", worker_id));
+                                continue;
+                            }
+                        }
+                        // Only the edges that are new to the master have to be preserved by the minimization
                         let mut new_edges = EdgeSet::new();
-                        let mut new_cov = unsafe { cov_evaluate(self.fuzzer.worker_id as usize, &mut new_edges) };
+                        let mut new_cov = unsafe { cov_merge_edges(self.fuzzer.worker_id, edges.as_ptr(), edges.len() as u32, &mut new_edges) };
+                        // Buckets on edges the master has seen already make a sample just as new as unseen edges
+                        let new_buckets = self.merge_buckets(&edges, &buckets);
                         self.fuzzer
-                            .log(&format!("new cov: {} from worker {} ", new_cov, worker_id));
+                            .log(&format!("new cov: {} ({} buckets) from worker {} ", new_cov, new_buckets, worker_id));
 
-                        update_stats(unsafe { NUM_WORKERS }, result, 0 , WorkerState::CoverageCheck, self.fuzzer.corpus.entries.len() as i32);
+                        update_stats(unsafe { NUM_WORKERS }, 0, 0 , WorkerState::CoverageCheck, self.fuzzer.corpus.entries.len() as i32);
                         // let mut mutated_edges = unsafe { extract_testcase_coverage(&js_code, self.fuzzer.worker_id as usize, &mut new_edges) };
                         // if mutated_edges.count == 0 {
                         //     self.fuzzer.log(&format!("Discard new cov from worker {} ", worker_id));
                         // }
-                        if new_cov > 0 {
-                        // if new_cov > 0 {
-                            // let reducer = WasmReducer::new(0, mutated_edges).unwrap();
-                            // let (reduced_wasm, new_cov_wasm_modules) = reducer.reduce(&mutated_wasm);
-                            // self.fuzzer.log(&format!("Reduced sample size from {} to {}", mutated_wasm.len(), reduced_wasm.len()));
-                            // self.fuzzer.log(&format!("New cov wasm modules count: {}", new_cov_wasm_modules.len()));
-                            let minimized_ir = program_ir.clone();
-                            let minimized_js = "".to_string();
-
-                            let mut minimized_ir_list = Vec::new();
-                            let mut minimized_js_list = Vec::new();
-                            update_stats(unsafe { NUM_WORKERS }, 0, 0, WorkerState::Minimizing, self.fuzzer.corpus.entries.len() as i32);
-                            (minimized_ir_list, minimized_js_list) = (Vec::new(), Vec::new());
-
-
-                            // sort the minimized_js_list by length
-                            minimized_js_list.sort_by_key(|js: &String| js.len());
-                            minimized_ir_list.sort_by_key(|ir: &String| ir.len());
-                            let mut is_maintained: bool = false;
-                            // let mut is_new_coverage: bool = false;
-                            let mut minimized_js_final = String::new();
-                            let mut minimized_ir_final = String::new();
-                            // println!("Js code from client: {}", js_code);
-                            reset_edge_set(self.fuzzer.worker_id as usize, &mut new_edges);
-                            // (is_maintained, is_new_coverage) = unsafe { maintain_coverage_with_mutated_edges(&js_code, self.fuzzer.worker_id as usize, &new_edges) };
-                            // println!("is_maintained: {}", is_maintained);
-                            // println!("is_new_coverage: {}", is_new_coverage);
-                            update_stats(unsafe { NUM_WORKERS }, 0, 0, WorkerState::Maintaining, self.fuzzer.corpus.entries.len() as i32);
-                            for (minimized_ir, minimized_js) in minimized_ir_list.iter().zip(minimized_js_list.iter()) {
-                                // println!("minimized_js: {}", minimized_js);
-                                if minimized_js.is_empty() {
-                                    continue;
-                                }
-                                (is_maintained, _) =  maintain_coverage_with_mutated_edges(minimized_js, self.fuzzer.worker_id as usize, &new_edges) ;
-                                if is_maintained  {
-                                    minimized_js_final = minimized_js.clone();
-                                    minimized_ir_final = minimized_ir.clone();
-                                    break;
-                                }
-                            }
-                            mark_edge_set(self.fuzzer.worker_id as usize, &mut new_edges);
-                            if is_maintained  {
-
-                                update_stats(unsafe { NUM_WORKERS }, result, new_cov as i32, WorkerState::Generating, self.fuzzer.corpus.entries.len() as i32);
-                                let file_name = format!("{}_{}_{}_min_",  unsafe { NUM_WORKERS },  new_cov, pass);
-                                self.fuzzer.save_interesting_input(
-                                    &minimized_js_final,
-                                    &minimized_ir_final,
-                                    &file_name,
-                                )?;
-                                   
-                                for tx in &self.to_workers {
-                                    if let Err(e) = tx.send(MasterMessage::NewCorpus {
-                                        program_ir: minimized_ir_final.clone(),
-                                        js_code: minimized_js_final.clone(),
-                                    }) {
-                                        self.fuzzer.log(&format!("Failed to send to worker: {}", e));
-                                    }
-                                }
-                                self.fuzzer.corpus.add_entry(CorpusEntry::new(minimized_ir_final, minimized_js_final));
-                            }
-                            else {
-                                update_stats(unsafe { NUM_WORKERS }, result, new_cov as i32, WorkerState::Generating, self.fuzzer.corpus.entries.len() as i32);
-                                let file_name = format!("{}_{}_{}",  unsafe { NUM_WORKERS },  new_cov, pass);
-                                self.fuzzer.save_interesting_input(
-                                    &js_code,
-                                    &program_ir,
-                                    &file_name,
-                                )?;
-                                   
-                                for tx in &self.to_workers {
-                                    if let Err(e) = tx.send(MasterMessage::NewCorpus {
-                                        program_ir: program_ir.clone(),
-                                        js_code: js_code.clone(),
-                                    }) {
-                                        self.fuzzer.log(&format!("Failed to send to worker: {}", e));
-                                    }
-                                }
-                                self.fuzzer.corpus.add_entry(CorpusEntry::new(program_ir, js_code));
-                            }
-
-                           
-                           
+                        if new_cov > 0 || new_buckets > 0 {
+                            update_stats(unsafe { NUM_WORKERS }, 0, new_cov.max(0), WorkerState::Minimizing, self.fuzzer.corpus.entries.len() as i32);
+                            update_bucket_stats(unsafe { NUM_WORKERS }, new_buckets);
+                            self.add_sample(PendingSample {
+                                program_ir,
+                                js_code,
+                                edges,
+                                buckets,
+                                new_edges: new_edges.as_slice().to_vec(),
+                                file_name: format!("{}_{}_{}", unsafe { NUM_WORKERS }, new_cov, pass),
+                                // The worker that found the sample already has it
+                                skip: shared_virgin.then_some(worker_id),
+                            })?;
                         }
-                        update_stats(unsafe { NUM_WORKERS }, result, 0 , WorkerState::Idle, self.fuzzer.corpus.entries.len() as i32);
+                        update_stats(unsafe { NUM_WORKERS }, 0, 0 , WorkerState::Idle, self.fuzzer.corpus.entries.len() as i32);
 
                         
                     }
@@ -1336,8 +1616,19 @@ impl Master {
                 }
             }
             
+            self.poll_minimizer()?;
+
             // Check for new AST files
             self.check_new_ast_files()?;
+            self.poll_sync()?;
+
+            // Only the edges merged since the last checkpoint are written, see coverage_checkpoint() in reprl.h
+            if self.checkpoint_path.is_some() && self.last_checkpoint.elapsed() >= CHECKPOINT_INTERVAL {
+                if unsafe { coverage_checkpoint(self.fuzzer.worker_id as i32) } < 0 {
+                    self.fuzzer.log("Failed to update the coverage checkpoint");
+                }
+                self.last_checkpoint = Instant::now();
+            }
             
             std::thread::sleep(Duration::from_millis(100));
         }
@@ -1360,14 +1651,8 @@ fn test_mode() {
     let js_code = "console.log('Hello, world!');";
     v8_reprl_check(0);
     for i in 0..100 {
-        let result = unsafe {
-            execute_script(
-                js_code.as_ptr() as *mut i8,
-                MAX_TIMEOUT,
-                0,
-                0,
-            )
-        };
+        unsafe { cov_reset_edge_arena(0) };
+        let result = execute_str(&js_code, unsafe { MAX_TIMEOUT }, 0);
         let mut new_edges = EdgeSet::new();
         let mut new_cov = unsafe { cov_evaluate(0, &mut new_edges) };
         reset_edge_set(0, &mut new_edges);
@@ -1394,9 +1679,18 @@ fn test_mode() {
 async fn main() -> Result<()> {
     // Create a Python worker
     let opt = Opt::from_args();
+    let config = Config::new()?;
     unsafe {
         MAX_TIMEOUT = opt.timeout;
         NUM_WORKERS = opt.num_workers;
+        if !config.pool.is_empty() {
+            NUM_WORKERS = config.pool.iter().map(|engine| engine.workers).sum();
+        }
+    }
+    // Every worker, the master, the minimizer and the bytecode pool need a slot in the REPRL context registry
+    let max_workers = std::cmp::min(unsafe { reprl_max_workers() } as usize, BYTECODE_WORKER_BASE) - 1 - minimizer_pool_size().min(BYTECODE_WORKER_BASE / 2);
+    if unsafe { NUM_WORKERS } > max_workers {
+        return Err(anyhow::anyhow!("At most {} workers are supported, got {}", max_workers, unsafe { NUM_WORKERS }));
     }
     init_stats();
     if opt.test_mode {
@@ -1419,11 +1713,13 @@ async fn main() -> Result<()> {
         num_workers = NUM_WORKERS as usize; // Leave one core for master
     }
     println!("Starting {} workers...", num_workers);
+    for engine in &config.pool {
+        println!("  {} x {} ({})", engine.workers, engine.engine, engine.binary);
+    }
 
 
                let (tx_dummy_worker, _): (Sender<WorkerMessage>, Receiver<WorkerMessage>) = channel();
                let (_, rx_dummy_master): (Sender<MasterMessage>, Receiver<MasterMessage>) = channel();
-    let config = Config::new()?;
     
     let mut master = Master::new(&config, num_workers).await?;
     
@@ -1446,7 +1742,7 @@ async fn main() -> Result<()> {
         let handle = std::thread::spawn(move || {
             // Initialize worker's REPRL
             println!("Initializing worker {}", worker_id);
-            init_reprl_safe(worker_id);
+            worker_config.init_reprl(worker_id);
             
             let mut fuzzer = match futures::executor::block_on(Fuzzer::new(
                 &worker_config,
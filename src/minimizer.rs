@@ -0,0 +1,214 @@
+use std::collections::HashMap;
+use std::collections::hash_map::DefaultHasher;
+use std::hash::{Hash, Hasher};
+use std::io;
+use std::sync::mpsc::{channel, sync_channel, Receiver, SyncSender, TrySendError};
+use crate::coverage::*;
+
+/// Number of REPRL contexts the master reserves for minimization, set with MINIMIZER_POOL_SIZE (0 disables it)
+pub fn minimizer_pool_size() -> usize {
+    std::env::var("MINIMIZER_POOL_SIZE").ok().and_then(|v| v.parse().ok()).unwrap_or(2)
+}
+
+/// Reduces new corpus entries on REPRL contexts of its own.
+///
+/// Candidates drop one chunk of lines of the script. A wave of candidates is spread over all
+/// contexts with an Executor, and whether a candidate still hits the target edges is decided in C
+/// with one AND of the coverage bitmap against the target edge mask of the context
+/// (cov_set_target_edges, cov_count_target_hits). Results are cached by script hash.
+pub struct Minimizer {
+    workers: Vec<usize>,
+    executor: Executor,
+    timeout: i32,
+    // Hash of the script and the target -> whether the script keeps the target edges
+    cache: HashMap<u64, bool>,
+    pub executions: u64,
+    pub cache_hits: u64,
+}
+
+impl Minimizer {
+    const MAX_CACHE_ENTRIES: usize = 1 << 16;
+    // Executions one minimize call may spend
+    const MAX_EXECUTIONS: usize = 512;
+
+    /// The contexts of the workers have to be initialized already
+    pub fn new(workers: Vec<usize>, timeout: i32) -> Option<Self> {
+        if workers.is_empty() {
+            return None;
+        }
+        let executor = Executor::new(workers.len())?;
+        Some(Minimizer { workers, executor, timeout, cache: HashMap::new(), executions: 0, cache_hits: 0 })
+    }
+
+    /// Returns a smaller version of js_code that still hits every target edge the original hits
+    /// on the minimizer contexts, or None if nothing could be removed.
+    pub fn minimize(&mut self, js_code: &str, edges: &[u32]) -> Option<String> {
+        let js_code = js_code.trim_end_matches('\0');
+        if edges.is_empty() || js_code.is_empty() {
+            return None;
+        }
+        // Edges the original does not hit again are flaky and not required from the candidates
+        let (status, hit) = self.run_one(js_code, edges)?;
+        if get_result_code(status) != ResultCode::Success || hit.is_empty() {
+            return None;
+        }
+        // The mask holds exactly the required edges, so a candidate keeps them if it hits all of the mask
+        let mut required = 0;
+        for &worker in &self.workers {
+            required = unsafe { cov_set_target_edges(worker as i32, hit.as_ptr(), hit.len() as u32) };
+            if required <= 0 {
+                return None;
+            }
+        }
+        let mut hasher = DefaultHasher::new();
+        hit.hash(&mut hasher);
+        let target = hasher.finish();
+
+        let mut units: Vec<&str> = js_code.split_inclusive('\n').collect();
+        let mut chunk = units.len() / 2;
+        let mut budget = Self::MAX_EXECUTIONS;
+        while chunk > 0 && units.len() > 1 && budget > 0 {
+            let candidates: Vec<(usize, String)> = (0..units.len())
+                .step_by(chunk)
+                .map(|start| {
+                    let end = (start + chunk).min(units.len());
+                    (start, units[..start].concat() + &units[end..].concat())
+                })
+                .filter(|(_, candidate)| !candidate.trim().is_empty())
+                .collect();
+
+            let mut reduced = None;
+            for wave in candidates.chunks(self.workers.len()) {
+                if budget == 0 {
+                    break;
+                }
+                budget = budget.saturating_sub(wave.len());
+                // Without the engines the reduction cannot go on, nothing of it is kept
+                let keeps = self.evaluate(wave.iter().map(|(_, candidate)| candidate.as_str()), target, required).ok()?;
+                // Lowest chunk first, so the result does not depend on which engine finished first
+                if let Some(position) = keeps.iter().position(|&keep| keep) {
+                    reduced = Some(wave[position].0);
+                    break;
+                }
+            }
+            match reduced {
+                Some(start) => {
+                    units.drain(start..(start + chunk).min(units.len()));
+                    chunk = chunk.min(units.len() / 2).max(1);
+                }
+                None => chunk /= 2,
+            }
+        }
+
+        let minimized = units.concat();
+        if minimized.len() < js_code.len() { Some(minimized) } else { None }
+    }
+
+    /// Executes a single script, returns its status and the given edges that it hit
+    fn run_one(&mut self, script: &str, edges: &[u32]) -> Option<(i32, Vec<u32>)> {
+        let worker = self.workers[0];
+        if !self.executor.submit(worker, script, self.timeout) {
+            return None;
+        }
+        // Waiting without a limit only returns without a completion if nothing was in flight
+        let completion = self.executor.wait(-1).ok()?.into_iter().next()?;
+        self.executions += 1;
+        let hit = edges.iter()
+            .copied()
+            .filter(|edge| unsafe { cov_count_hit_edges(completion.worker_id as usize, edge, 1) } == 1)
+            .collect();
+        Some((completion.status, hit))
+    }
+
+    /// Runs every script on its own context and checks whether it keeps the target edges
+    fn evaluate<'a>(&mut self, scripts: impl Iterator<Item = &'a str>, target: u64, required: i32) -> io::Result<Vec<bool>> {
+        let mut results = Vec::new();
+        // Worker id -> (result index, cache key)
+        let mut in_flight: HashMap<i32, (usize, u64)> = HashMap::new();
+        for (index, (script, worker)) in scripts.zip(self.workers.iter().copied()).enumerate() {
+            let mut hasher = DefaultHasher::new();
+            target.hash(&mut hasher);
+            script.hash(&mut hasher);
+            let key = hasher.finish();
+            results.push(false);
+            if let Some(&keep) = self.cache.get(&key) {
+                self.cache_hits += 1;
+                results[index] = keep;
+            } else if self.executor.submit(worker, script, self.timeout) {
+                in_flight.insert(worker as i32, (index, key));
+            }
+        }
+        while !in_flight.is_empty() {
+            for completion in self.executor.wait(-1)? {
+                let Some((index, key)) = in_flight.remove(&completion.worker_id) else { continue };
+                self.executions += 1;
+                // The bitmap still holds the coverage of this execution until the context runs the next one
+                let keep = get_result_code(completion.status) == ResultCode::Success
+                    && unsafe { cov_count_target_hits(completion.worker_id) } == required;
+                results[index] = keep;
+                if self.cache.len() >= Self::MAX_CACHE_ENTRIES {
+                    self.cache.clear();
+                }
+                self.cache.insert(key, keep);
+            }
+        }
+        Ok(results)
+    }
+}
+
+/// A Minimizer on a thread of its own, so that the master keeps merging reports while it runs.
+///
+/// Every request carries a tag that comes back with its result. The queue is bounded, a request
+/// that does not fit anymore is handed back to the caller instead of delaying all later ones.
+pub struct MinimizerService<T> {
+    requests: SyncSender<(String, Vec<u32>, T)>,
+    results: Receiver<(Option<String>, T)>,
+}
+
+impl<T: Send + 'static> MinimizerService<T> {
+    const QUEUE_SIZE: usize = 64;
+
+    /// init_worker initializes the context of a minimizer worker, it runs on the minimizer thread
+    /// because the engine a context runs decides how results are classified on that thread.
+    pub fn start(workers: Vec<usize>, timeout: i32, init_worker: impl Fn(usize) + Send + 'static) -> Option<Self> {
+        if workers.is_empty() {
+            return None;
+        }
+        let (requests, queue) = sync_channel::<(String, Vec<u32>, T)>(Self::QUEUE_SIZE);
+        let (finished, results) = channel();
+        let (ready, started) = channel();
+        std::thread::spawn(move || {
+            for &worker in &workers {
+                init_worker(worker);
+            }
+            let Some(mut minimizer) = Minimizer::new(workers, timeout) else {
+                let _ = ready.send(false);
+                return;
+            };
+            let _ = ready.send(true);
+            for (js_code, edges, tag) in queue {
+                let minimized = minimizer.minimize(&js_code, &edges);
+                if finished.send((minimized, tag)).is_err() {
+                    return;
+                }
+            }
+        });
+        if !started.recv().unwrap_or(false) {
+            return None;
+        }
+        Some(MinimizerService { requests, results })
+    }
+
+    /// Queues js_code to be reduced to a script that still hits the edges. Hands the tag back
+    /// if the queue is full or the minimizer thread is gone.
+    pub fn submit(&self, js_code: String, edges: Vec<u32>, tag: T) -> Result<(), T> {
+        self.requests.try_send((js_code, edges, tag)).map_err(|e| match e {
+            TrySendError::Full((_, _, tag)) | TrySendError::Disconnected((_, _, tag)) => tag,
+        })
+    }
+
+    /// The requests finished since the last call, with the minimized script if there is one
+    pub fn poll(&self) -> Vec<(Option<String>, T)> {
+        self.results.try_iter().collect()
+    }
+}
@@ -21,8 +21,11 @@
 #endif
 
 #ifdef __linux__
+#include <elf.h>
 #include <linux/memfd.h>
+#include <sys/epoll.h>
 #include <sys/syscall.h>
+#include <sys/timerfd.h>
 #ifndef MFD_CLOEXEC
 #define MFD_CLOEXEC 0x0001U
 #endif
@@ -31,9 +34,16 @@
 #include "reprl.h"
 #include <fcntl.h>
 
+#if defined(__x86_64__)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
 #include <assert.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <poll.h>
 #include <signal.h>
 #include <stdarg.h>
@@ -41,6 +51,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/types.h>
 #include <sys/wait.h>
@@ -53,29 +64,91 @@
 #define REPRL_CHILD_CTRL_OUT 101  // REPRL_CWFD in Fuzzilli
 #define REPRL_CHILD_DATA_IN 102   // REPRL_DRFD in Fuzzilli
 #define REPRL_CHILD_DATA_OUT 103  // REPRL_DWFD in Fuzzilli
+#define REPRL_CHILD_FORKSRV_IN 104   // Commands to the fork server, see REPRL_CAP_FORKSERVER
+#define REPRL_CHILD_FORKSRV_OUT 105  // Replies of the fork server
 
 // #define SHM_SIZE 0x100000			// the size must be big enough for the target JS engine (v8)
 // #define MAX_EDGES ((SHM_SIZE - 4) * 8)
+#define likely(cond) __builtin_expect(!!(cond), 1)
 #define unlikely(cond) __builtin_expect(!!(cond), 0)
 
 
 #define MIN(x, y) ((x) < (y) ? (x) : (y))
+#define MAX(x, y) ((x) > (y) ? (x) : (y))
 
 /// Maximum timeout in microseconds. Mostly just limited by the fact that the timeout in milliseconds has to fit into a 32-bit integer.
 #define REPRL_MAX_TIMEOUT_IN_MICROSECONDS ((uint64_t)(INT_MAX) * 1000)
 
-struct cov_context contexts[512] = {0};
+// Registry of the per-worker state. Worker ids are the handles into it, every slot is allocated the first time its
+// id is used and starts on its own cache line, so workers running next to each other never share a line. Only the
+// table of slot pointers is static.
+struct worker_slot {
+    struct cov_context cov;
+    struct reprl_context* reprl;
+    struct reprl_histogram phases[REPRL_NUM_PHASES];
+} __attribute__((aligned(64)));
+
+static struct worker_slot* worker_slots[REPRL_MAX_WORKERS] = {NULL};
+
+static struct worker_slot* worker_slot_of(int worker_id)
+{
+    if (unlikely(worker_id < 0 || worker_id >= REPRL_MAX_WORKERS)) {
+        fprintf(stderr, "[libJSEngine] Worker id %d is out of range, at most %d workers are supported\n", worker_id, REPRL_MAX_WORKERS);
+        return NULL;
+    }
+    struct worker_slot* slot = __atomic_load_n(&worker_slots[worker_id], __ATOMIC_ACQUIRE);
+    if (likely(slot != NULL)) {
+        return slot;
+    }
+    struct worker_slot* fresh = aligned_alloc(_Alignof(struct worker_slot), sizeof(struct worker_slot));
+    if (fresh == NULL) {
+        fprintf(stderr, "[libJSEngine] Memory allocation failed!\n");
+        return NULL;
+    }
+    memset(fresh, 0, sizeof(struct worker_slot));
+    if (__atomic_compare_exchange_n(&worker_slots[worker_id], &slot, fresh, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        return fresh;
+    }
+    // Someone else allocated this slot in the meantime.
+    free(fresh);
+    return slot;
+}
+
+// NULL for an invalid worker id or if the slot could not be allocated.
+static inline struct cov_context* cov_context_of(int worker_id)
+{
+    struct worker_slot* slot = worker_slot_of(worker_id);
+    return slot != NULL ? &slot->cov : NULL;
+}
+
+// Unlike cov_context_of() this never allocates, NULL means the worker has no REPRL context (or an invalid id).
+static inline struct reprl_context* reprl_context_of(int worker_id)
+{
+    if (worker_id < 0 || worker_id >= REPRL_MAX_WORKERS) {
+        return NULL;
+    }
+    struct worker_slot* slot = __atomic_load_n(&worker_slots[worker_id], __ATOMIC_ACQUIRE);
+    return slot != NULL ? slot->reprl : NULL;
+}
 
 // char **prog_argv = NULL;
 // char **environment = NULL;
 int environment_length = 0;
 extern char **environ;
 
-struct reprl_context* reprl_contexts[128] = {NULL}; // Array to store contexts for each worker
 
+// Optional virgin bitmap shared by all workers (REPRL_SHARED_VIRGIN=1). Every worker keeps its own virgin_bits,
+// but a new edge is only reported by the worker that clears it in this map first. The other workers then neither
+// report the same discovery again nor have to re-execute the sample that triggered it.
+struct shared_virgin_map {
+    uint64_t bitmap_size;
+    uint64_t words[];
+};
+static struct shared_virgin_map* shared_virgin_map = NULL;
 
 
-static_assert(MAX_EDGES <= UINT32_MAX, "Edges must be addressable using a 32-bit index");
+
+static_assert(SHM_MAX_EDGES_FOR_SIZE(SHM_MAX_SIZE) <= UINT32_MAX, "Edges must be addressable using a 32-bit index");
 
 static inline int edge(const uint8_t* bits, uint64_t index)
 {
@@ -102,6 +175,55 @@ static uint64_t current_usecs()
     return ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
 }
 
+static uint64_t current_nsecs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static uint32_t histogram_bucket(uint64_t value)
+{
+    if (value < (1 << REPRL_HISTOGRAM_SUB_BITS)) {
+        return value;
+    }
+    uint32_t msb = 63 - __builtin_clzll(value);
+    uint32_t magnitude = msb - REPRL_HISTOGRAM_SUB_BITS + 1;
+    uint32_t sub = (value >> (msb - REPRL_HISTOGRAM_SUB_BITS)) & ((1 << REPRL_HISTOGRAM_SUB_BITS) - 1);
+    return MIN((magnitude << REPRL_HISTOGRAM_SUB_BITS) + sub, REPRL_HISTOGRAM_BUCKETS - 1);
+}
+
+// Adds the time since start (from current_nsecs()) to a phase histogram and returns the current time, so that
+// consecutive phases can be chained. Only called from the thread that owns the worker, see struct reprl_histogram.
+static uint64_t record_phase(struct reprl_histogram* phases, int phase, uint64_t start)
+{
+    uint64_t now = current_nsecs();
+    if (phases == NULL) {
+        return now;
+    }
+    struct reprl_histogram* histogram = &phases[phase];
+    uint64_t duration = now - start;
+    uint32_t bucket = histogram_bucket(duration);
+    __atomic_store_n(&histogram->buckets[bucket], histogram->buckets[bucket] + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&histogram->total_ns, histogram->total_ns + duration, __ATOMIC_RELAXED);
+    if (duration > histogram->max_ns) {
+        __atomic_store_n(&histogram->max_ns, duration, __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&histogram->count, histogram->count + 1, __ATOMIC_RELAXED);
+    return now;
+}
+
+// poll() with a timeout in microseconds. Falls back to rounding up to milliseconds where ppoll() is not available.
+static int poll_usecs(struct pollfd* fds, nfds_t count, uint64_t timeout)
+{
+#ifdef __linux__
+    struct timespec ts = { .tv_sec = timeout / 1000000, .tv_nsec = (timeout % 1000000) * 1000 };
+    return ppoll(fds, count, &ts, NULL);
+#else
+    return poll(fds, count, (int)((timeout + 999) / 1000));
+#endif
+}
+
 static char** copy_string_array(const char** orig)
 {
     size_t num_entries = 0;
@@ -136,7 +258,7 @@ static int reprl_error(struct reprl_context* ctx, const char *format, ...)
     return -1;
 }
 
-static struct data_channel* reprl_create_data_channel(struct reprl_context* ctx, int worker_id)
+static struct data_channel* reprl_create_data_channel(struct reprl_context* ctx, int worker_id, uint64_t capacity, int map_completely)
 {
     char channel_name[64];
     snprintf(channel_name, sizeof(channel_name), "REPRL_DATA_CHANNEL_%d", worker_id);
@@ -163,22 +285,28 @@ static struct data_channel* reprl_create_data_channel(struct reprl_context* ctx,
         return NULL;
     }
     
-    // printf("Created data channel fd=%d for worker %d, attempting ftruncate to size %d\n", fd, worker_id, REPRL_MAX_DATA_SIZE);
+    // printf("Created data channel fd=%d for worker %d, attempting ftruncate to size %lu\n", fd, worker_id, (unsigned long)capacity);
     
-    if (ftruncate(fd, REPRL_MAX_DATA_SIZE) != 0) {
-        fprintf(stderr, "Failed to ftruncate data channel (fd=%d, size=%d): %s (errno=%d)\n", fd, REPRL_MAX_DATA_SIZE, strerror(errno), errno);
+    // The file stays sparse, this only reserves the space.
+    if (ftruncate(fd, capacity) != 0) {
+        fprintf(stderr, "Failed to ftruncate data channel (fd=%d, size=%lu): %s (errno=%d)\n", fd, (unsigned long)capacity, strerror(errno), errno);
         close(fd);
         return NULL;
     }
-    char* mapping = mmap(0, REPRL_MAX_DATA_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    uint64_t mapped_size = map_completely ? capacity : MIN(capacity, REPRL_CHANNEL_INITIAL_MAP);
+    char* mapping = mmap(0, mapped_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
     if (mapping == MAP_FAILED) {
         reprl_error(ctx, "Failed to mmap data channel file: %s", strerror(errno));
+        close(fd);
         return NULL;
     }
 
     struct data_channel* channel = malloc(sizeof(struct data_channel));
     channel->fd = fd;
     channel->mapping = mapping;
+    channel->mapped_size = mapped_size;
+    channel->capacity = capacity;
+    channel->high_water = 0;
     return channel;
 }
 
@@ -187,24 +315,164 @@ static void reprl_destroy_data_channel(struct reprl_context* ctx, struct data_ch
     (void)ctx; // Suppress unused parameter warning
     if (!channel) return;
     close(channel->fd);
-    munmap(channel->mapping, REPRL_MAX_DATA_SIZE);
+    munmap(channel->mapping, channel->mapped_size);
     free(channel);
 }
 
+// Remaps an output channel so that at least size bytes of it are accessible. The mapping may move.
+static int reprl_map_data_channel(struct data_channel* channel, uint64_t size)
+{
+    size = MIN(size, channel->capacity);
+    if (size <= channel->mapped_size) {
+        return 0;
+    }
+    // Grow geometrically so that a slowly growing output doesn't remap on every execution.
+    uint64_t new_size = MAX(channel->mapped_size, REPRL_CHANNEL_INITIAL_MAP);
+    while (new_size < size) {
+        new_size *= 2;
+    }
+    new_size = MIN(new_size, channel->capacity);
+#ifdef __linux__
+    char* mapping = mremap(channel->mapping, channel->mapped_size, new_size, MREMAP_MAYMOVE);
+#else
+    char* mapping = mmap(0, new_size, PROT_READ | PROT_WRITE, MAP_SHARED, channel->fd, 0);
+    if (mapping != MAP_FAILED) {
+        munmap(channel->mapping, channel->mapped_size);
+    }
+#endif
+    if (mapping == MAP_FAILED) {
+        fprintf(stderr, "Failed to grow data channel mapping to %lu bytes: %s\n", (unsigned long)new_size, strerror(errno));
+        return -1;
+    }
+    channel->mapping = mapping;
+    channel->mapped_size = new_size;
+    return 0;
+}
+
+// Children write to the output channels with write(2), which can extend the file beyond its capacity. Shrinks it back
+// so the backing file doesn't grow too large.
+static int reprl_clamp_data_channel(struct data_channel* channel)
+{
+    struct stat st;
+    if (fstat(channel->fd, &st) == 0 && (uint64_t)st.st_size > channel->capacity) {
+        return ftruncate(channel->fd, channel->capacity);
+    }
+    return 0;
+}
+
+// Releases the pages of a channel above keep bytes once its high-water mark is above REPRL_CHANNEL_TRIM_THRESHOLD,
+// so that a single large script or output doesn't keep its memory resident for the lifetime of the worker. Channels
+// that stay below the threshold keep their pages and cost nothing here.
+static void reprl_trim_data_channel(struct data_channel* channel, uint64_t keep)
+{
+    if (!channel || channel->high_water <= REPRL_CHANNEL_TRIM_THRESHOLD) {
+        return;
+    }
+    uint64_t page_size = sysconf(_SC_PAGESIZE);
+    uint64_t start = (MAX(keep, REPRL_CHANNEL_TRIM_THRESHOLD) + page_size - 1) & ~(page_size - 1);
+    uint64_t end = MIN(channel->high_water, channel->capacity);
+    if (start < end) {
+#if defined(__linux__) && defined(FALLOC_FL_PUNCH_HOLE)
+        if (fallocate(channel->fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, start, end - start) != 0 && start < channel->mapped_size) {
+            madvise(channel->mapping + start, MIN(end, channel->mapped_size) - start, MADV_REMOVE);
+        }
+#else
+        // Truncating and re-extending the file drops the pages as well.
+        if (ftruncate(channel->fd, start) == 0) {
+            ftruncate(channel->fd, channel->capacity);
+        }
+#endif
+    }
+    reprl_clamp_data_channel(channel);
+    channel->high_water = keep;
+}
+
+// Releases the pages of an output channel after the previous execution. Used before the file position is reset,
+// at which point it still tells how much the child wrote.
+static void reprl_trim_output_channel(struct data_channel* channel)
+{
+    if (!channel) return;
+    off_t written = lseek(channel->fd, 0, SEEK_CUR);
+    if (written > 0) {
+        channel->high_water = MAX(channel->high_water, (uint64_t)written);
+    }
+    if (channel->high_water <= REPRL_CHANNEL_TRIM_THRESHOLD) {
+        return;
+    }
+    reprl_trim_data_channel(channel, 0);
+#ifdef __linux__
+    // Shrinking never moves the mapping.
+    if (channel->mapped_size > REPRL_CHANNEL_TRIM_THRESHOLD &&
+        mremap(channel->mapping, channel->mapped_size, REPRL_CHANNEL_TRIM_THRESHOLD, 0) != MAP_FAILED) {
+        channel->mapped_size = REPRL_CHANNEL_TRIM_THRESHOLD;
+    }
+#endif
+}
+
+// Whether the child is currently connected to the given stdout or stderr channel.
+static int reprl_output_connected(struct reprl_context* ctx, struct data_channel* channel, int policy)
+{
+    return channel != NULL && (policy == REPRL_CAPTURE_ALWAYS || (policy == REPRL_CAPTURE_ON_CRASH && ctx->capture_attached));
+}
+
+static struct data_channel* reprl_create_output_channel(struct reprl_context* ctx, int worker_id, int channel)
+{
+    uint64_t capacity = ctx->channel_capacity[channel] ? ctx->channel_capacity[channel] : REPRL_MAX_DATA_SIZE;
+    return reprl_create_data_channel(ctx, worker_id, capacity, 0);
+}
+
 static void reprl_child_terminated(struct reprl_context* ctx)
 {
     if (!ctx->pid) return;
     ctx->pid = 0;
+    // With a fork server the control pipes belong to the server and are reused by the next forked child.
+    if (ctx->server_pid) return;
+    close(ctx->ctrl_in);
+    close(ctx->ctrl_out);
+}
+
+static void reprl_terminate_server(struct reprl_context* ctx)
+{
+    if (!ctx->server_pid) return;
+    int status;
+    if (ctx->pid) {
+        kill(ctx->pid, SIGKILL);
+        ctx->pid = 0;
+    }
+    kill(ctx->server_pid, SIGKILL);
+    waitpid(ctx->server_pid, &status, 0);
+    ctx->server_pid = 0;
+    close(ctx->fsrv_in);
+    close(ctx->fsrv_out);
+    close(ctx->ctrl_out_reader);
+    ctx->fsrv_in = ctx->fsrv_out = ctx->ctrl_out_reader = -1;
     close(ctx->ctrl_in);
     close(ctx->ctrl_out);
 }
 
+static int reprl_read_with_deadline(int fd, void* buf, size_t len, uint64_t deadline);
+
+// Deadline for the messages of a starting engine or of the fork server, in the clock of current_usecs.
+static uint64_t reprl_spawn_deadline(struct reprl_context* ctx)
+{
+    return current_usecs() + (ctx->spawn_timeout ? ctx->spawn_timeout : REPRL_DEFAULT_SPAWN_TIMEOUT);
+}
+
 static void reprl_terminate_child(struct reprl_context* ctx)
 {
     if (!ctx->pid) return;
     int status;
     kill(ctx->pid, SIGKILL);
-    waitpid(ctx->pid, &status, 0);
+    if (ctx->server_pid) {
+        // The forked child is reaped by the fork server, which then reports its status. A server that does not
+        // answer in time is hung and replaced.
+        if (reprl_read_with_deadline(ctx->fsrv_in, &status, 4, reprl_spawn_deadline(ctx)) != 0) {
+            reprl_terminate_server(ctx);
+            return;
+        }
+    } else {
+        waitpid(ctx->pid, &status, 0);
+    }
     reprl_child_terminated(ctx);
 }
 
@@ -218,153 +486,1337 @@ static inline int virgin_is_edge_set(const uint8_t* bits, uint64_t index) {
 }
 
 
-// In Virgin map an edge is a 0 and not a 1
+#if defined(__x86_64__)
+__attribute__((target("popcnt")))
+static uint64_t count_set_bits_popcnt(const uint64_t* start, const uint64_t* end)
+{
+    uint64_t count = 0;
+    for (const uint64_t* current = start; current < end; current++) {
+        count += __builtin_popcountll(*current);
+    }
+    return count;
+}
+#endif
+
+static uint64_t count_set_bits(const uint64_t* start, const uint64_t* end)
+{
+#if defined(__x86_64__)
+    if (__builtin_cpu_supports("popcnt")) {
+        return count_set_bits_popcnt(start, end);
+    }
+#endif
+    uint64_t count = 0;
+    for (const uint64_t* current = start; current < end; current++) {
+        count += __builtin_popcountll(*current);
+    }
+    return count;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("popcnt")))
+static uint64_t count_common_bits_popcnt(const uint64_t* a, const uint64_t* b, uint64_t words)
+{
+    uint64_t count = 0;
+    for (uint64_t i = 0; i < words; i++) {
+        count += __builtin_popcountll(a[i] & b[i]);
+    }
+    return count;
+}
+#endif
+
+// Number of bits that are set in both bitmaps.
+static uint64_t count_common_bits(const uint64_t* a, const uint64_t* b, uint64_t words)
+{
+#if defined(__x86_64__)
+    if (__builtin_cpu_supports("popcnt")) {
+        return count_common_bits_popcnt(a, b, words);
+    }
+#endif
+    uint64_t count = 0;
+    for (uint64_t i = 0; i < words; i++) {
+        count += __builtin_popcountll(a[i] & b[i]);
+    }
+    return count;
+}
+
+// In Virgin map an edge is a 0 and not a 1. Bitmaps are always a multiple of 8 bytes long.
 static int get_number_edges_virgin(uint64_t* start, uint64_t* end) {
-	uint64_t* current = start;
-	int tmp_count_edges = 0;
-	while (current < end) {
-		uint64_t index = ((uintptr_t)current - (uintptr_t)start) * 8;
-		for (uint64_t i = index; i < index + 64; i++) {
-			if (virgin_is_edge_set((const uint8_t*)start, i) == 1) {
-				tmp_count_edges += 1;
-			}
-		}
-		current++;
-	}
-	return tmp_count_edges;
+    return (end - start) * 64 - count_set_bits(start, end);
 }
-int coverage_save_virgin_bits_in_file(int worker_id, const char *filepath) {
-	FILE *write_ptr= fopen(filepath,"wb");  // w for write, b for binary
-    if (write_ptr == NULL) {
-        printf("Failed to open file %s\n", filepath);
+
+// Coverage snapshots start with this header, padded to COVERAGE_SNAPSHOT_HEADER_SIZE so that the bitmap
+// behind it is page aligned in the file and can be mapped directly.
+#define COVERAGE_SNAPSHOT_MAGIC 0x50414e5356434644ull   // "DFCVSNAP"
+#define COVERAGE_SNAPSHOT_VERSION 1
+#define COVERAGE_SNAPSHOT_HEADER_SIZE 4096
+
+struct coverage_snapshot_header {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t num_edges;
+    uint64_t bitmap_size;
+    // See engine_build_id(), zero if unknown.
+    uint64_t build_id;
+    // See snapshot_checksum().
+    uint64_t checksum;
+};
+
+static uint64_t hash_bytes(uint64_t hash, const void* data, size_t length)
+{
+    const uint8_t* bytes = data;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+static uint64_t snapshot_checksum(const uint64_t* start, const uint64_t* end)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (const uint64_t* current = start; current < end; current++) {
+        hash = (hash ^ *current) * 0x9e3779b97f4a7c15ull;
+        hash ^= hash >> 29;
+    }
+    return hash;
+}
+
+// Identifies the engine binary a worker runs: the hash of its GNU build id note if it has one, otherwise of its size
+// and modification time. Zero if the worker has no engine, in which case snapshots are not checked against it.
+static uint64_t engine_build_id(int worker_id)
+{
+    struct reprl_context* ctx = reprl_context_of(worker_id);
+    if (ctx == NULL || ctx->argv == NULL || ctx->argv[0] == NULL) {
+        return 0;
+    }
+    int fd = open(ctx->argv[0], O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        if (fd >= 0) close(fd);
+        return 0;
+    }
+    uint64_t build_id = 0;
+#ifdef __linux__
+    uint8_t* image = st.st_size >= (off_t)sizeof(Elf64_Ehdr) ? mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    if (image != MAP_FAILED) {
+        const Elf64_Ehdr* ehdr = (const Elf64_Ehdr*)image;
+        uint64_t size = st.st_size;
+        if (memcmp(ehdr->e_ident, ELFMAG, SELFMAG) == 0 && ehdr->e_ident[EI_CLASS] == ELFCLASS64 &&
+            ehdr->e_phentsize == sizeof(Elf64_Phdr) && ehdr->e_phoff + (uint64_t)ehdr->e_phnum * sizeof(Elf64_Phdr) <= size) {
+            const Elf64_Phdr* phdrs = (const Elf64_Phdr*)(image + ehdr->e_phoff);
+            for (int i = 0; i < ehdr->e_phnum && build_id == 0; i++) {
+                if (phdrs[i].p_type != PT_NOTE || phdrs[i].p_offset + phdrs[i].p_filesz > size) {
+                    continue;
+                }
+                uint64_t offset = phdrs[i].p_offset;
+                uint64_t end = offset + phdrs[i].p_filesz;
+                while (offset + sizeof(Elf64_Nhdr) <= end) {
+                    const Elf64_Nhdr* note = (const Elf64_Nhdr*)(image + offset);
+                    uint64_t name = offset + sizeof(Elf64_Nhdr);
+                    uint64_t desc = name + ((note->n_namesz + 3) & ~3u);
+                    if (desc + note->n_descsz > end) {
+                        break;
+                    }
+                    if (note->n_type == NT_GNU_BUILD_ID && note->n_namesz == 4 && memcmp(image + name, "GNU", 4) == 0) {
+                        build_id = hash_bytes(0xcbf29ce484222325ull, image + desc, note->n_descsz);
+                        break;
+                    }
+                    offset = desc + ((note->n_descsz + 3) & ~3u);
+                }
+            }
+        }
+        munmap(image, st.st_size);
+    }
+#endif
+    close(fd);
+    if (build_id == 0) {
+        uint64_t identity[2] = {(uint64_t)st.st_size, (uint64_t)st.st_mtime};
+        build_id = hash_bytes(0xcbf29ce484222325ull, identity, sizeof(identity));
+    }
+    return build_id;
+}
+
+// Releases virgin_bits, which is either from alloc_bitmap() or mapped from a coverage snapshot.
+static void release_virgin_bits(struct cov_context* context)
+{
+    if (context->virgin_mapping_size) {
+        munmap(context->virgin_bits, context->virgin_mapping_size);
+    } else {
+        free(context->virgin_bits);
+    }
+    context->virgin_bits = NULL;
+    context->virgin_mapping_size = 0;
+}
+
+// Writes the virgin bits of a worker to a coverage snapshot and stores the checksum of the bitmap in checksum.
+static int coverage_write_snapshot(int worker_id, const char* filepath, uint64_t* checksum)
+{
+    struct cov_context* context = cov_context_of(worker_id);
+    if (context == NULL) {
         return -1;
     }
-    struct cov_context* context = &contexts[worker_id];
     if (context->virgin_bits == NULL) {
         printf("Virgin bits are NULL for worker %d\n", worker_id);
         return -1;
     }
-	fwrite(context->virgin_bits,context->bitmap_size,1,write_ptr);
+    uint64_t* start = (uint64_t*)context->virgin_bits;
+    uint64_t* end = (uint64_t*)(context->virgin_bits + context->bitmap_size);
+
+    uint8_t header_page[COVERAGE_SNAPSHOT_HEADER_SIZE] = {0};
+    struct coverage_snapshot_header header = {
+        .magic = COVERAGE_SNAPSHOT_MAGIC,
+        .version = COVERAGE_SNAPSHOT_VERSION,
+        .num_edges = context->num_edges,
+        .bitmap_size = context->bitmap_size,
+        .build_id = engine_build_id(worker_id),
+        .checksum = snapshot_checksum(start, end),
+    };
+    memcpy(header_page, &header, sizeof(header));
+
+    // Other workers may load the snapshot at any time, so it is written next to the target and renamed over it.
+    char temp_path[PATH_MAX];
+    snprintf(temp_path, sizeof(temp_path), "%s.%d.%d.tmp", filepath, getpid(), worker_id);
+	FILE *write_ptr= fopen(temp_path,"wb");  // w for write, b for binary
+    if (write_ptr == NULL) {
+        printf("Failed to open file %s\n", temp_path);
+        return -1;
+    }
+    int written = fwrite(header_page, sizeof(header_page), 1, write_ptr) == 1 &&
+                  fwrite(context->virgin_bits, context->bitmap_size, 1, write_ptr) == 1;
+	if (fclose(write_ptr) != 0 || !written || rename(temp_path, filepath) != 0) {
+        printf("Failed to write coverage snapshot %s: %s\n", filepath, strerror(errno));
+        unlink(temp_path);
+        return -1;
+    }
+    *checksum = header.checksum;
+    return 0;
+}
 
-	fclose(write_ptr);
+int coverage_save_virgin_bits_in_file(int worker_id, const char *filepath) {
+    struct cov_context* context = cov_context_of(worker_id);
+    if (context == NULL) {
+        return -1;
+    }
+    uint64_t checksum;
+    if (coverage_write_snapshot(worker_id, filepath, &checksum) != 0) {
+        return -1;
+    }
     return get_number_edges_virgin((uint64_t*)context->virgin_bits, (uint64_t*)(context->virgin_bits + context->bitmap_size));
 }
-void coverage_backup_virgin_bits(int worker_id) {
-    struct cov_context* context = &contexts[worker_id];
+// Replaces the virgin bits of a worker with a coverage snapshot. checksum receives the checksum from its header,
+// zero for raw bitmaps of older versions.
+static int coverage_read_snapshot(int worker_id, const char* filepath, uint64_t* checksum)
+{
+    struct cov_context* context = cov_context_of(worker_id);
+    if (context == NULL) {
+        return -1;
+    }
     if (context->virgin_bits == NULL) {
         printf("Virgin bits are NULL for worker %d\n", worker_id);
-        return;
+        return -1;
     }
-	memcpy(context->virgin_bits_backup, context->virgin_bits, context->bitmap_size);
 
-}
-int coverage_load_virgin_bits_from_file(int worker_id,const char *filepath) {
-	FILE *ptr = fopen(filepath,"rb");
-    if (ptr == NULL) {
+    int fd = open(filepath, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
         printf("Failed to open file %s\n", filepath);
         return -1;
     }
-
-    struct cov_context* context = &contexts[worker_id];
-    if (context == NULL) {
-        printf("Context is NULL for worker %d\n", worker_id);
+    struct stat st;
+    struct coverage_snapshot_header header = {0};
+    if (fstat(fd, &st) != 0) {
+        printf("Failed to stat coverage snapshot %s: %s\n", filepath, strerror(errno));
+        close(fd);
         return -1;
     }
-    if (context->virgin_bits == NULL) {
-        printf("Virgin bits are NULL for worker %d\n", worker_id);
+    if (st.st_size >= COVERAGE_SNAPSHOT_HEADER_SIZE && pread(fd, &header, sizeof(header), 0) == sizeof(header) &&
+        header.magic == COVERAGE_SNAPSHOT_MAGIC) {
+        uint64_t build_id = engine_build_id(worker_id);
+        if (header.version != COVERAGE_SNAPSHOT_VERSION || header.num_edges != context->num_edges ||
+            header.bitmap_size != context->bitmap_size || st.st_size < 0 ||
+            (uint64_t)st.st_size != COVERAGE_SNAPSHOT_HEADER_SIZE + header.bitmap_size ||
+            (header.build_id && build_id && header.build_id != build_id)) {
+            // This happens when you update the JS engine and try to load an old coverage map with a new JS engine
+            fprintf(stderr, "Coverage snapshot %s (version %u, %u edges, build %016lx) does not match this JS engine (%u edges, build %016lx)\n",
+                    filepath, header.version, header.num_edges, (unsigned long)header.build_id, context->num_edges, (unsigned long)build_id);
+            close(fd);
+            return -1;
+        }
+        uint8_t* mapping = mmap(0, header.bitmap_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, COVERAGE_SNAPSHOT_HEADER_SIZE);
+        close(fd);
+        if (mapping == MAP_FAILED) {
+            printf("Failed to map coverage snapshot %s: %s\n", filepath, strerror(errno));
+            return -1;
+        }
+        if (snapshot_checksum((uint64_t*)mapping, (uint64_t*)(mapping + header.bitmap_size)) != header.checksum) {
+            fprintf(stderr, "Coverage snapshot %s is corrupted (checksum mismatch)\n", filepath);
+            munmap(mapping, header.bitmap_size);
+            return -1;
+        }
+        release_virgin_bits(context);
+        context->virgin_bits = mapping;
+        context->virgin_mapping_size = header.bitmap_size;
+        *checksum = header.checksum;
+    } else if (st.st_size == context->bitmap_size) {
+        // Snapshot of an older version, which is just the bitmap.
+        if (pread(fd, context->virgin_bits, context->bitmap_size, 0) != context->bitmap_size) {
+            printf("Failed to read coverage snapshot %s: %s\n", filepath, strerror(errno));
+            close(fd);
+            return -1;
+        }
+        close(fd);
+        *checksum = 0;
+    } else {
+        fprintf(stderr, "Coverage snapshot %s has %lu bytes instead of %u. Was the coverage map created with this JS engine?\n",
+                filepath, (unsigned long)st.st_size, context->bitmap_size);
+        close(fd);
         return -1;
     }
-	if (fread(context->virgin_bits, context->bitmap_size,1,ptr) == 0) {
-	    // This error occurs when you update the JS engine and try to load an old coverage map with a new JS engine
-		fprintf(stderr, "Fread() error in coverage_load_virgin_bits_from_file(). Was the coverage map created with this JS engine?\n");
- 		exit(-1);
-	}
-	coverage_backup_virgin_bits(worker_id);
-	fclose(ptr);
-
-    coverage_clear_bitmap(worker_id);    // This call is important: Otherwise an execute-call after the load virgin bits call will lead to incorrect results 
-
-	return get_number_edges_virgin((uint64_t*)context->virgin_bits, (uint64_t*)(context->virgin_bits + context->bitmap_size));
+    return 0;
 }
 
 
 
-// Restores the virgin bits to the original value or to the value stored via the
-// coverage_backup_virgin_bits() function call
-void coverage_restore_virgin_bits(int worker_id) {
-	memcpy(contexts[worker_id].virgin_bits, contexts[worker_id].virgin_bits_backup, contexts[worker_id].bitmap_size);
+// ================ Delta log ==================
+//
+// While a checkpoint is open (coverage_checkpoint_open()) or a rollback point is set (coverage_backup_virgin_bits()),
+// every change to virgin_bits is appended to delta_log. An entry is the index of a discovered edge, or
+// DELTA_RESTORED followed by the index of an edge that was handed back with cov_clear_edge_data(). No valid index
+// equals DELTA_RESTORED because edge indices are smaller than num_edges.
+//
+// coverage_checkpoint() appends the entries that are not yet on disk to the delta file next to the snapshot, so a
+// checkpoint costs a few bytes per discovered edge. Once the log is larger than the bitmap itself, it is compacted:
+// the snapshot is rewritten and the log starts over. coverage_restore_virgin_bits() undoes the entries behind the
+// rollback point instead of copying the whole map.
+
+#define DELTA_RESTORED UINT32_MAX
+#define DELTA_FILE_MAGIC 0x41544c4456434644ull   // "DFCVDLTA"
+
+// The delta file starts with this header, followed by the log entries.
+struct delta_file_header {
+    uint64_t magic;
+    // Checksum of the snapshot the log applies to, see struct coverage_snapshot_header.
+    uint64_t snapshot_checksum;
+};
+
+// Number of entries after which the log is compacted, i.e. when it is about as large as the bitmap.
+static uint64_t delta_log_limit(struct cov_context* context)
+{
+    return MAX(context->bitmap_size / sizeof(uint32_t), 4096);
 }
 
-void coverage_shutdown(int worker_id) {
-    struct cov_context* context = &contexts[worker_id];
-    char shm_key[1024];
-    snprintf(shm_key, 1024, "/shm_id_%d_%d", getpid(), context->id);
-    shm_unlink(shm_key);
+// Applies log entries to a bitmap, forwards or (undo) backwards. Indices outside the bitmap are skipped.
+static void delta_apply(uint8_t* bits, uint32_t num_edges, const uint32_t* entries, uint64_t count)
+{
+    for (uint64_t i = 0; i < count; i++) {
+        int restored = entries[i] == DELTA_RESTORED && i + 1 < count;
+        uint32_t index = restored ? entries[++i] : entries[i];
+        if (index >= num_edges) {
+            continue;
+        }
+        if (restored) {
+            set_edge(bits, index);
+        } else {
+            clear_edge(bits, index);
+        }
+    }
 }
 
-// ================ Start helper functions ==================
-static char *dup_str(const char *str) {
-	size_t len = strlen(str) + 1;
-	char *dup = malloc(len);
-	if (dup != NULL)
-		memmove(dup, str, len);
-	return dup;
+static void delta_undo(struct cov_context* context, uint8_t* bits, uint64_t until)
+{
+    uint64_t i = context->delta_count;
+    while (i > until) {
+        uint32_t index = context->delta_log[--i];
+        if (i > until && context->delta_log[i - 1] == DELTA_RESTORED) {
+            i--;
+            clear_edge(bits, index);
+        } else {
+            set_edge(bits, index);
+        }
+    }
 }
-// ================ End helper functions ==================
 
+// Turns the rollback point into a copy of the map in virgin_bits_backup, so that the log before it can be dropped.
+static void delta_materialize_backup(struct cov_context* context)
+{
+    memcpy(context->virgin_bits_backup, context->virgin_bits, context->bitmap_size);
+    delta_undo(context, context->virgin_bits_backup, context->delta_mark);
+    context->delta_marked = 0;
+}
 
+// Forgets the log after virgin_bits were replaced as a whole. An open checkpoint is compacted at its next update.
+static void delta_reset(struct cov_context* context)
+{
+    context->delta_count = 0;
+    context->delta_persisted = 0;
+    context->delta_marked = 0;
+    if (context->checkpoint_path != NULL) {
+        context->checkpoint_stale = 1;
+    }
+}
 
+static void delta_append(struct cov_context* context, uint32_t index, int restored)
+{
+    if (context->checkpoint_path == NULL && !context->delta_marked) {
+        return;
+    }
+    if (context->delta_count + 2 > context->delta_capacity) {
+        uint64_t capacity = MAX(context->delta_capacity * 2, 1024);
+        uint32_t* log = realloc(context->delta_log, capacity * sizeof(uint32_t));
+        if (log == NULL) {
+            fprintf(stderr, "[LibCoverage] Memory allocation failed!\n");
+            exit(-1);
+        }
+        context->delta_log = log;
+        context->delta_capacity = capacity;
+    }
+    if (restored) {
+        context->delta_log[context->delta_count++] = DELTA_RESTORED;
+    }
+    context->delta_log[context->delta_count++] = index;
+    if (context->checkpoint_path == NULL && context->delta_count >= delta_log_limit(context)) {
+        // Only the rollback point needs the log, and copying the map once is cheaper than a longer log from here on.
+        delta_materialize_backup(context);
+        context->delta_count = 0;
+    }
+}
 
+static void delta_append_edges(struct cov_context* context, const struct edge_set* edges)
+{
+    for (uint32_t i = 0; i < edges->count; i++) {
+        delta_append(context, edges->edge_indices[i], 0);
+    }
+}
 
-int coverage_initialize(int shm_id) { // worker_id
-    printf("Initializing coverage for worker %d\n", shm_id);
-    struct cov_context* context = &contexts[shm_id];
-	char shm_key[1024];
-	snprintf(shm_key, 1024, "/shm_id_%d_%d", getpid(), shm_id);
-	context->id = shm_id;
-	if(context->shmem != NULL) {
-		coverage_shutdown(shm_id);
-	}
-	
-	// First unlink any existing shared memory with this name
-	shm_unlink(shm_key);
-	
-	int fd = shm_open(shm_key, O_RDWR | O_CREAT | O_EXCL, 0600);
-	if (fd == -1) {
-		fprintf(stderr, "Failed to create shared memory region '%s': %s\n", shm_key, strerror(errno));
-		return -1;
-	}
+// Sets the rollback point for coverage_restore_virgin_bits() to the current state of the virgin bits.
+void coverage_backup_virgin_bits(int worker_id) {
+    struct cov_context* context = cov_context_of(worker_id);
+    if (context == NULL) {
+        return;
+    }
+    if (context->virgin_bits == NULL) {
+        printf("Virgin bits are NULL for worker %d\n", worker_id);
+        return;
+    }
+    context->delta_mark = context->delta_count;
+    context->delta_marked = 1;
+}
+
+// Restores the virgin bits to the original value or to the value stored via the
+// coverage_backup_virgin_bits() function call
+void coverage_restore_virgin_bits(int worker_id) {
+    struct cov_context* context = cov_context_of(worker_id);
+    if (context == NULL) {
+        return;
+    }
+    if (!context->delta_marked) {
+        memcpy(context->virgin_bits, context->virgin_bits_backup, context->bitmap_size);
+        delta_reset(context);
+        if (context->checkpoint_path != NULL) {
+            coverage_backup_virgin_bits(worker_id);
+        }
+        return;
+    }
+    delta_undo(context, context->virgin_bits, context->delta_mark);
+    context->delta_count = context->delta_mark;
+    if (context->checkpoint_path != NULL && context->delta_persisted > context->delta_count) {
+        // The undone part is already on disk, cut it off again.
+        context->delta_persisted = context->delta_count;
+        if (ftruncate(context->checkpoint_fd, sizeof(struct delta_file_header) + context->delta_persisted * sizeof(uint32_t)) != 0) {
+            context->checkpoint_stale = 1;
+        }
+    }
+}
+
+int coverage_load_virgin_bits_from_file(int worker_id,const char *filepath) {
+    struct cov_context* context = cov_context_of(worker_id);
+    if (context == NULL) {
+        return -1;
+    }
+    uint64_t checksum;
+    if (coverage_read_snapshot(worker_id, filepath, &checksum) != 0) {
+        return -1;
+    }
+    delta_reset(context);
+	coverage_backup_virgin_bits(worker_id);
+
+    coverage_clear_bitmap(worker_id);    // This call is important: Otherwise an execute-call after the load virgin bits call will lead to incorrect results 
+
+	return get_number_edges_virgin((uint64_t*)context->virgin_bits, (uint64_t*)(context->virgin_bits + context->bitmap_size));
+}
+
+// Rewrites the snapshot of the open checkpoint and starts a new, empty delta file for it.
+static int checkpoint_compact(int worker_id, struct cov_context* context)
+{
+    uint64_t checksum;
+    if (coverage_write_snapshot(worker_id, context->checkpoint_path, &checksum) != 0) {
+        return -1;
+    }
+    // Until the rename, the old delta file does not match the new snapshot and is ignored by coverage_load_checkpoint().
+    char delta_path[PATH_MAX];
+    char temp_path[PATH_MAX + 32];
+    snprintf(delta_path, sizeof(delta_path), "%s.delta", context->checkpoint_path);
+    snprintf(temp_path, sizeof(temp_path), "%s.%d.%d.tmp", delta_path, getpid(), worker_id);
+    struct delta_file_header header = { DELTA_FILE_MAGIC, checksum };
+    int fd = open(temp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0 || write(fd, &header, sizeof(header)) != sizeof(header) || rename(temp_path, delta_path) != 0) {
+        printf("Failed to write delta log %s: %s\n", delta_path, strerror(errno));
+        if (fd >= 0) {
+            close(fd);
+            unlink(temp_path);
+        }
+        return -1;
+    }
+    if (context->checkpoint_fd >= 0) {
+        close(context->checkpoint_fd);
+    }
+    context->checkpoint_fd = fd;
+    if (context->delta_marked) {
+        delta_materialize_backup(context);
+    }
+    context->delta_count = 0;
+    context->delta_persisted = 0;
+    context->checkpoint_stale = 0;
+    return 0;
+}
+
+int coverage_checkpoint_open(int worker_id, const char* path)
+{
+    struct cov_context* context = cov_context_of(worker_id);
+    if (context == NULL) {
+        return -1;
+    }
+    if (context->virgin_bits == NULL) {
+        printf("Virgin bits are NULL for worker %d\n", worker_id);
+        return -1;
+    }
+    coverage_checkpoint_close(worker_id);
+    context->checkpoint_path = strdup(path);
+    context->checkpoint_fd = -1;
+    if (checkpoint_compact(worker_id, context) != 0) {
+        free(context->checkpoint_path);
+        context->checkpoint_path = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+int64_t coverage_checkpoint(int worker_id)
+{
+    struct cov_context* context = cov_context_of(worker_id);
+    if (context == NULL) {
+        return -1;
+    }
+    if (context->checkpoint_path == NULL) {
+        return -1;
+    }
+    if (context->checkpoint_stale || context->delta_count >= delta_log_limit(context)) {
+        if (checkpoint_compact(worker_id, context) != 0) {
+            return -1;
+        }
+        return COVERAGE_SNAPSHOT_HEADER_SIZE + context->bitmap_size + sizeof(struct delta_file_header);
+    }
+    uint64_t pending = (context->delta_count - context->delta_persisted) * sizeof(uint32_t);
+    if (pending == 0) {
+        return 0;
+    }
+    off_t offset = sizeof(struct delta_file_header) + context->delta_persisted * sizeof(uint32_t);
+    if (pwrite(context->checkpoint_fd, context->delta_log + context->delta_persisted, pending, offset) != (ssize_t)pending) {
+        printf("Failed to append to the delta log of %s: %s\n", context->checkpoint_path, strerror(errno));
+        // A partial append can't be told apart from real entries, so the next update starts over.
+        context->checkpoint_stale = 1;
+        return -1;
+    }
+    context->delta_persisted = context->delta_count;
+    return pending;
+}
+
+void coverage_checkpoint_close(int worker_id)
+{
+    struct cov_context* context = cov_context_of(worker_id);
+    if (context == NULL) {
+        return;
+    }
+    if (context->checkpoint_path == NULL) {
+        return;
+    }
+    coverage_checkpoint(worker_id);
+    if (context->checkpoint_fd >= 0) {
+        close(context->checkpoint_fd);
+    }
+    free(context->checkpoint_path);
+    context->checkpoint_path = NULL;
+    context->checkpoint_fd = -1;
+}
+
+uint64_t coverage_fingerprint(int worker_id)
+{
+    struct cov_context* context = cov_context_of(worker_id);
+    if (context == NULL) {
+        return 0;
+    }
+    uint64_t build_id = engine_build_id(worker_id);
+    uint64_t hash = hash_bytes(0xcbf29ce484222325ull, &build_id, sizeof(build_id));
+    return hash_bytes(hash, &context->num_edges, sizeof(context->num_edges));
+}
+
+int coverage_load_checkpoint(int worker_id, const char* path)
+{
+    struct cov_context* context = cov_context_of(worker_id);
+    if (context == NULL) {
+        return -1;
+    }
+    uint64_t checksum;
+    if (coverage_read_snapshot(worker_id, path, &checksum) != 0) {
+        return -1;
+    }
+    char delta_path[PATH_MAX];
+    snprintf(delta_path, sizeof(delta_path), "%s.delta", path);
+    int fd = open(delta_path, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    struct delta_file_header header = {0};
+    if (fd >= 0 && fstat(fd, &st) == 0 && pread(fd, &header, sizeof(header), 0) == sizeof(header) &&
+        header.magic == DELTA_FILE_MAGIC && checksum != 0 && header.snapshot_checksum == checksum) {
+        // A torn last entry of an interrupted append is ignored.
+        uint64_t count = (st.st_size - sizeof(header)) / sizeof(uint32_t);
+        uint32_t* entries = malloc(MAX(count, 1) * sizeof(uint32_t));
+        if (entries != NULL && pread(fd, entries, count * sizeof(uint32_t), sizeof(header)) == (ssize_t)(count * sizeof(uint32_t))) {
+            delta_apply(context->virgin_bits, context->num_edges, entries, count);
+        } else {
+            printf("Failed to read delta log %s, using only the snapshot\n", delta_path);
+        }
+        free(entries);
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    delta_reset(context);
+    coverage_backup_virgin_bits(worker_id);
+    coverage_clear_bitmap(worker_id);
+    return get_number_edges_virgin((uint64_t*)context->virgin_bits, (uint64_t*)(context->virgin_bits + context->bitmap_size));
+}
+
+// Name of one of the shared memory objects (kind is "id", "counters" or "cmplog") of a worker. The standby child
+// has a set of objects of its own, see struct cov_context.
+static void coverage_shm_key(char* key, size_t size, const char* kind, int worker_id, int standby)
+{
+    snprintf(key, size, "/shm_%s_%d_%d%s", kind, getpid(), worker_id, standby ? "_standby" : "");
+}
+
+void coverage_shutdown(int worker_id) {
+    struct cov_context* context = cov_context_of(worker_id);
+    if (context == NULL) {
+        return;
+    }
+    char shm_key[1024];
+    // The objects of the standby child only exist if one was started, unlinking them is harmless otherwise.
+    for (int standby = 0; standby < 2; standby++) {
+        coverage_shm_key(shm_key, sizeof(shm_key), "id", context->id, standby);
+        shm_unlink(shm_key);
+        if (context->counters != NULL) {
+            coverage_shm_key(shm_key, sizeof(shm_key), "counters", context->id, standby);
+            shm_unlink(shm_key);
+        }
+        if (context->cmplog != NULL) {
+            coverage_shm_key(shm_key, sizeof(shm_key), "cmplog", context->id, standby);
+            shm_unlink(shm_key);
+        }
+    }
+}
+
+// ================ Start helper functions ==================
+static char *dup_str(const char *str) {
+	size_t len = strlen(str) + 1;
+	char *dup = malloc(len);
+	if (dup != NULL)
+		memmove(dup, str, len);
+	return dup;
+}
+// ================ End helper functions ==================
+
+
+
+
+
+#define HUGE_PAGE_SIZE (2 << 20)
+
+// Asks for transparent huge pages on a mapping. For the shm_open regions this only has an effect if
+// /sys/kernel/mm/transparent_hugepage/shmem_enabled allows it, and only for the parts that span whole huge pages.
+static void advise_huge_pages(void* addr, size_t len)
+{
+#ifdef MADV_HUGEPAGE
+    madvise(addr, len, MADV_HUGEPAGE);
+#endif
+}
+
+// Allocates a private bitmap. Bitmaps of at least half a huge page are rounded up to whole, aligned huge pages,
+// so that scanning them needs one TLB entry per 2MB. The result can be released with free().
+static void* alloc_bitmap(size_t size)
+{
+    if (size < HUGE_PAGE_SIZE / 2) {
+        return malloc(size);
+    }
+    void* bitmap = NULL;
+    size_t rounded = (size + HUGE_PAGE_SIZE - 1) & ~((size_t)HUGE_PAGE_SIZE - 1);
+    if (posix_memalign(&bitmap, HUGE_PAGE_SIZE, rounded) != 0) {
+        return NULL;
+    }
+    advise_huge_pages(bitmap, rounded);
+    return bitmap;
+}
+
+// Parses REPRL_SHM_SIZE: a size in bytes (decimal or 0x hex) or "auto". Returns 0 if the value is unusable.
+static uint64_t parse_shm_size(const char* value, int* auto_size)
+{
+    *auto_size = strcmp(value, "auto") == 0;
+    if (*auto_size) {
+        return SHM_SIZE;
+    }
+    uint64_t size = strtoull(value, NULL, 0);
+    if (size < 4096 || size > SHM_MAX_SIZE || size % 4096 != 0) {
+        fprintf(stderr, "[LibCoverage] REPRL_SHM_SIZE=%s must be a multiple of 4096 between 4096 and %d\n", value, SHM_MAX_SIZE);
+        return 0;
+    }
+    return size;
+}
+
+// Creates the shared memory object for the hit count map. The child finds it through SHM_COUNTERS_ID.
+static int coverage_initialize_counters(struct cov_context* context) {
+	char shm_key[1024];
+	coverage_shm_key(shm_key, sizeof(shm_key), "counters", context->id, context->standby_swapped);
+	shm_unlink(shm_key);
+
+	int fd = shm_open(shm_key, O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (fd == -1) {
+		fprintf(stderr, "Failed to create shared memory region '%s': %s\n", shm_key, strerror(errno));
+		return -1;
+	}
+	if (ftruncate(fd, SHM_COUNTERS_SIZE_FOR_SIZE(context->shm_size)) != 0) {
+		fprintf(stderr, "ftruncate() failed for fd %d, size %lu: %s (errno=%d)\n",
+		        fd, (unsigned long)SHM_COUNTERS_SIZE_FOR_SIZE(context->shm_size), strerror(errno), errno);
+		close(fd);
+		shm_unlink(shm_key);
+		return -1;
+	}
+
+	if (context->counters != NULL) {
+		munmap(context->counters, context->counters_size);
+	}
+	context->counters_size = SHM_COUNTERS_SIZE_FOR_SIZE(context->shm_size);
+	context->counters = mmap(0, context->counters_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (context->counters == MAP_FAILED) {
+		context->counters = NULL;
+		fprintf(stderr, "mmap() failed for '%s': %s\n", shm_key, strerror(errno));
+		shm_unlink(shm_key);
+		return -1;
+	}
+	advise_huge_pages(context->counters, context->counters_size);
+	return 0;
+}
+
+// Creates the shared memory object for the comparison log. The child finds it through SHM_CMPLOG_ID.
+static int coverage_initialize_cmplog(struct cov_context* context) {
+	char shm_key[1024];
+	coverage_shm_key(shm_key, sizeof(shm_key), "cmplog", context->id, context->standby_swapped);
+	shm_unlink(shm_key);
+
+	int fd = shm_open(shm_key, O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (fd == -1) {
+		fprintf(stderr, "Failed to create shared memory region '%s': %s\n", shm_key, strerror(errno));
+		return -1;
+	}
+	if (ftruncate(fd, sizeof(struct shmem_cmplog)) != 0) {
+		fprintf(stderr, "ftruncate() failed for fd %d, size %lu: %s (errno=%d)\n",
+		        fd, (unsigned long)sizeof(struct shmem_cmplog), strerror(errno), errno);
+		close(fd);
+		shm_unlink(shm_key);
+		return -1;
+	}
+
+	if (context->cmplog != NULL) {
+		munmap(context->cmplog, sizeof(struct shmem_cmplog));
+	}
+	context->cmplog = mmap(0, sizeof(struct shmem_cmplog), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (context->cmplog == MAP_FAILED) {
+		context->cmplog = NULL;
+		fprintf(stderr, "mmap() failed for '%s': %s\n", shm_key, strerror(errno));
+		shm_unlink(shm_key);
+		return -1;
+	}
+	return 0;
+}
+
+// Creates the shared memory object for the coverage region (struct shmem_data and the dirty block map) and maps it.
+// The child finds it through SHM_ID.
+static int coverage_initialize_shmem(struct cov_context* context) {
+	char shm_key[1024];
+	coverage_shm_key(shm_key, sizeof(shm_key), "id", context->id, context->standby_swapped);
+
+	// First unlink any existing shared memory with this name
+	shm_unlink(shm_key);
 	
+	int fd = shm_open(shm_key, O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (fd == -1) {
+		fprintf(stderr, "Failed to create shared memory region '%s': %s\n", shm_key, strerror(errno));
+		return -1;
+	}
+	
+	if (context->shm_size == 0) {
+		context->shm_size = SHM_SIZE;
+	}
+
 	// Debug info
-	printf("Created shm fd %d for key %s, attempting ftruncate to size %d\n", fd, shm_key, SHM_SIZE);
+	printf("Created shm fd %d for key %s, attempting ftruncate to size %lu\n", fd, shm_key, (unsigned long)context->shm_size);
 	
-	int tmp_ret = ftruncate(fd, SHM_SIZE);
+	int tmp_ret = ftruncate(fd, context->shm_size);
 	if(tmp_ret != 0) {
-		fprintf(stderr, "ftruncate() failed for fd %d, size %d: %s (errno=%d)\n", 
-		        fd, SHM_SIZE, strerror(errno), errno);
+		fprintf(stderr, "ftruncate() failed for fd %d, size %lu: %s (errno=%d)\n", 
+		        fd, (unsigned long)context->shm_size, strerror(errno), errno);
 		close(fd);
 		shm_unlink(shm_key);
 		return -1;
 	}
 
-	if(context->shmem != NULL) {
-		munmap(context->shmem, SHM_SIZE);
-	}
-	context->shmem = mmap(0, SHM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
-	close(fd);
+	if(context->shmem != NULL) {
+		munmap(context->shmem, context->shmem_mapped_size);
+	}
+	context->shmem = mmap(0, context->shm_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (context->shmem == MAP_FAILED) {
+		context->shmem = NULL;
+		fprintf(stderr, "mmap() failed for '%s': %s\n", shm_key, strerror(errno));
+		shm_unlink(shm_key);
+		return -1;
+	}
+	context->shmem_mapped_size = context->shm_size;
+	advise_huge_pages(context->shmem, context->shm_size);
+
+	context->dirty = (struct shmem_dirty_map*)((uint8_t*)context->shmem + SHM_DIRTY_MAP_OFFSET_FOR_SIZE(context->shm_size));
+	return 0;
+}
+
+// Exchanges the regions of the active child with the ones of the standby child.
+static void coverage_swap_regions(struct cov_context* context)
+{
+	struct shmem_data* shmem = context->shmem; context->shmem = context->standby_shmem; context->standby_shmem = shmem;
+	uint64_t size = context->shmem_mapped_size; context->shmem_mapped_size = context->standby_shmem_mapped_size; context->standby_shmem_mapped_size = size;
+	struct shmem_dirty_map* dirty = context->dirty; context->dirty = context->standby_dirty; context->standby_dirty = dirty;
+	struct shmem_counters* counters = context->counters; context->counters = context->standby_counters; context->standby_counters = counters;
+	size = context->counters_size; context->counters_size = context->standby_counters_size; context->standby_counters_size = size;
+	struct shmem_cmplog* cmplog = context->cmplog; context->cmplog = context->standby_cmplog; context->standby_cmplog = cmplog;
+	context->standby_swapped = !context->standby_swapped;
+}
+
+// Unmaps the regions of the standby child and removes their objects. The next standby creates them again.
+static void coverage_release_standby(struct cov_context* context)
+{
+	if (context->standby_shmem == NULL) {
+		return;
+	}
+	char shm_key[1024];
+	const char* kinds[] = { "id", "counters", "cmplog" };
+	for (int i = 0; i < 3; i++) {
+		coverage_shm_key(shm_key, sizeof(shm_key), kinds[i], context->id, !context->standby_swapped);
+		shm_unlink(shm_key);
+	}
+	munmap(context->standby_shmem, context->standby_shmem_mapped_size);
+	if (context->standby_counters != NULL) {
+		munmap(context->standby_counters, context->standby_counters_size);
+	}
+	if (context->standby_cmplog != NULL) {
+		munmap(context->standby_cmplog, sizeof(struct shmem_cmplog));
+	}
+	context->standby_shmem = NULL;
+	context->standby_dirty = NULL;
+	context->standby_counters = NULL;
+	context->standby_cmplog = NULL;
+}
+
+// Creates the regions of the standby child like the ones of the active child, unless they exist already.
+static int coverage_initialize_standby(struct cov_context* context)
+{
+	if (context->standby_shmem != NULL) {
+		return 0;
+	}
+	coverage_swap_regions(context);
+	int ret = coverage_initialize_shmem(context);
+	if (ret == 0 && context->hitcounts_requested) {
+		ret = coverage_initialize_counters(context);
+	}
+	if (ret == 0 && context->cmplog_requested) {
+		ret = coverage_initialize_cmplog(context);
+	}
+	coverage_swap_regions(context);
+	if (ret != 0) {
+		coverage_release_standby(context);
+	}
+	return ret;
+}
+
+// Makes the regions of the promoted standby child the active ones. They still hold the coverage of its startup and,
+// since they last belonged to an active child, whatever that one left behind, which the dirty block map doesn't
+// cover. So they are cleared completely once instead of trusting map_clean.
+static void coverage_promote_standby(struct cov_context* context)
+{
+	if (context->standby_shmem == NULL) {
+		return;
+	}
+	coverage_swap_regions(context);
+	memset(context->shmem->edges, 0, context->bitmap_size);
+	if (context->dirty_tracking) {
+		memset(context->dirty->blocks, 0, sizeof(context->dirty->blocks));
+		context->dirty->overflow = 0;
+	}
+	if (context->hitcounts) {
+		memset(context->counters->counters, 0, context->counts_size);
+	}
+	if (context->cmplog_enabled) {
+		__atomic_store_n(&context->cmplog->tail, __atomic_load_n(&context->cmplog->head, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+	}
+	context->map_clean = 1;
+	context->counters_clean = 1;
+}
+
+int coverage_initialize(int shm_id) { // worker_id
+    printf("Initializing coverage for worker %d\n", shm_id);
+    struct cov_context* context = cov_context_of(shm_id);
+    if (context == NULL) {
+        return -1;
+    }
+	context->id = shm_id;
+	if(context->shmem != NULL) {
+		coverage_shutdown(shm_id);
+	}
+	// The regions of a standby child are created again with the new size when the next one starts.
+	coverage_release_standby(context);
+
+	if (coverage_initialize_shmem(context) != 0) {
+		return -1;
+	}
+	context->dirty_tracking = 0;
+
+	context->hitcounts = 0;
+	if (context->hitcounts_requested && coverage_initialize_counters(context) != 0) {
+		context->hitcounts_requested = 0;
+	}
+
+	context->cmplog_enabled = 0;
+	if (context->cmplog_requested && coverage_initialize_cmplog(context) != 0) {
+		context->cmplog_requested = 0;
+	}
+
+	// The correct bitmap size is calculated in the >coverage_finish_initialization< function
+	// This function must be called after the first execution, however, the first execution
+	// Already uses the bitmap_size. I therefore set it here to zero so that the
+	// coverage_clear_bitmap() function does not write something in the first call
+	context->bitmap_size	= 0;
+    context->virgin_bits = NULL;
+    context->virgin_mapping_size = 0;
+    context->shared_virgin = NULL;
+	return 0;
+}
+
+// Returns the shared virgin map, creating it if this is the first worker to ask for it. Workers race
+// for creation with a compare-and-swap, the losers drop their region and use the winner's.
+static struct shared_virgin_map* coverage_attach_shared_virgin_map(uint32_t bitmap_size)
+{
+    struct shared_virgin_map* map = __atomic_load_n(&shared_virgin_map, __ATOMIC_ACQUIRE);
+    if (map == NULL) {
+        size_t size = sizeof(struct shared_virgin_map) + bitmap_size;
+        struct shared_virgin_map* fresh = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (fresh == MAP_FAILED) {
+            fprintf(stderr, "[LibCoverage] Failed to map the shared virgin map: %s\n", strerror(errno));
+            return NULL;
+        }
+        advise_huge_pages(fresh, size);
+        fresh->bitmap_size = bitmap_size;
+        memset(fresh->words, 0xff, bitmap_size);
+        // Zeroth edge is ignored, see coverage_finish_initialization.
+        clear_edge((uint8_t*)fresh->words, 0);
+        if (__atomic_compare_exchange_n(&shared_virgin_map, &map, fresh, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            map = fresh;
+        } else {
+            munmap(fresh, size);
+        }
+    }
+    if (map->bitmap_size != bitmap_size) {
+        printf("[LibCoverage] Bitmap size %u does not match the shared virgin map (%lu), using a private virgin map\n",
+               bitmap_size, (unsigned long)map->bitmap_size);
+        return NULL;
+    }
+    return map;
+}
+
+// Claims the edges of new_edges in the shared virgin map and drops the ones that another worker claimed first.
+// Indices of the same 64-bit word are usually adjacent, so they are claimed with a single fetch-and.
+static void claim_shared_edges(uint64_t* shared, struct edge_set* new_edges)
+{
+    uint32_t kept = 0;
+    uint32_t i = 0;
+    while (i < new_edges->count) {
+        uint32_t word = new_edges->edge_indices[i] / 64;
+        uint32_t end = i;
+        uint64_t mask = 0;
+        while (end < new_edges->count && new_edges->edge_indices[end] / 64 == word) {
+            mask |= 1ULL << (new_edges->edge_indices[end] % 64);
+            end++;
+        }
+        uint64_t claimed = __atomic_fetch_and(&shared[word], ~mask, __ATOMIC_RELAXED) & mask;
+        for (; i < end; i++) {
+            uint32_t index = new_edges->edge_indices[i];
+            if (claimed & (1ULL << (index % 64))) {
+                new_edges->edge_indices[kept++] = index;
+            }
+        }
+    }
+    new_edges->count = kept;
+}
+
+
+// ================ Coverage evaluation kernels ==================
+//
+// The shmem->edges bitmap and the virgin map are compared in 64-bit words. Words are read as
+// little-endian, so bit k of word w corresponds to edge index w * 64 + k, which matches the
+// byte/bit layout used by edge() and clear_edge() above.
+//
+// The kernels only differ in how fast they skip over words without new edges. Once a word with
+// new edges is found, collect_new_edges() extracts the indices with ctz instead of testing every bit.
+// All kernels evaluate the word range [begin, end) of the two bitmaps.
+
+typedef void (*evaluate_kernel_fn)(const uint8_t* edges, uint8_t* virgin_bits, uint64_t begin, uint64_t end, struct edge_set* new_edges);
+
+// new_edges->edge_indices points into the edge arena of the context, which always has room for
+// every bit of the bitmap (see internal_evaluate), so no bounds checks are needed here.
+static inline void collect_new_edges(uint64_t word_index, uint64_t hits, uint64_t* virgin, struct edge_set* new_edges)
+{
+    *virgin &= ~hits;
+
+    // We know that we have <= UINT32_MAX edges, so every index can safely be truncated to 32 bits.
+    uint64_t base_index = word_index * 64;
+    while (hits) {
+        new_edges->edge_indices[new_edges->count++] = (uint32_t)(base_index + __builtin_ctzll(hits));
+        hits &= hits - 1;
+    }
+}
+
+static void evaluate_words_scalar(const uint8_t* edges, uint8_t* virgin_bits, uint64_t begin, uint64_t end, struct edge_set* new_edges)
+{
+    const uint64_t* current = (const uint64_t*)edges;
+    uint64_t* virgin = (uint64_t*)virgin_bits;
+    for (uint64_t i = begin; i < end; i++) {
+        if (current[i] && unlikely(current[i] & virgin[i])) {
+            collect_new_edges(i, current[i] & virgin[i], &virgin[i], new_edges);
+        }
+    }
+}
+
+#if defined(__x86_64__)
+// shmem->edges starts at offset 4 of the shared memory region, so all vector loads have to be unaligned.
+__attribute__((target("avx2")))
+static void evaluate_words_avx2(const uint8_t* edges, uint8_t* virgin_bits, uint64_t begin, uint64_t end, struct edge_set* new_edges)
+{
+    const uint64_t* current = (const uint64_t*)edges;
+    uint64_t* virgin = (uint64_t*)virgin_bits;
+    uint64_t i = begin;
+    for (; i + 4 <= end; i += 4) {
+        __m256i cur = _mm256_loadu_si256((const __m256i*)(current + i));
+        __m256i vir = _mm256_loadu_si256((const __m256i*)(virgin + i));
+        if (likely(_mm256_testz_si256(cur, vir))) {
+            continue;
+        }
+        for (uint64_t j = i; j < i + 4; j++) {
+            uint64_t hits = current[j] & virgin[j];
+            if (hits) {
+                collect_new_edges(j, hits, &virgin[j], new_edges);
+            }
+        }
+    }
+    evaluate_words_scalar(edges, virgin_bits, i, end, new_edges);
+}
+
+__attribute__((target("avx512f")))
+static void evaluate_words_avx512(const uint8_t* edges, uint8_t* virgin_bits, uint64_t begin, uint64_t end, struct edge_set* new_edges)
+{
+    const uint64_t* current = (const uint64_t*)edges;
+    uint64_t* virgin = (uint64_t*)virgin_bits;
+    uint64_t i = begin;
+    for (; i + 8 <= end; i += 8) {
+        __m512i cur = _mm512_loadu_si512((const void*)(current + i));
+        __m512i vir = _mm512_loadu_si512((const void*)(virgin + i));
+        // One mask bit for every 64-bit word that contains at least one new edge.
+        __mmask8 words = _mm512_test_epi64_mask(cur, vir);
+        while (unlikely(words)) {
+            uint64_t j = i + __builtin_ctz(words);
+            collect_new_edges(j, current[j] & virgin[j], &virgin[j], new_edges);
+            words &= words - 1;
+        }
+    }
+    evaluate_words_scalar(edges, virgin_bits, i, end, new_edges);
+}
+#endif
+
+#if defined(__aarch64__)
+// NEON is mandatory on AArch64, so this kernel needs no runtime check.
+static void evaluate_words_neon(const uint8_t* edges, uint8_t* virgin_bits, uint64_t begin, uint64_t end, struct edge_set* new_edges)
+{
+    const uint64_t* current = (const uint64_t*)edges;
+    uint64_t* virgin = (uint64_t*)virgin_bits;
+    uint64_t i = begin;
+    for (; i + 4 <= end; i += 4) {
+        uint64x2_t lo = vandq_u64(vld1q_u64(current + i), vld1q_u64(virgin + i));
+        uint64x2_t hi = vandq_u64(vld1q_u64(current + i + 2), vld1q_u64(virgin + i + 2));
+        uint64x2_t any = vorrq_u64(lo, hi);
+        if (likely((vgetq_lane_u64(any, 0) | vgetq_lane_u64(any, 1)) == 0)) {
+            continue;
+        }
+        for (uint64_t j = i; j < i + 4; j++) {
+            uint64_t hits = current[j] & virgin[j];
+            if (hits) {
+                collect_new_edges(j, hits, &virgin[j], new_edges);
+            }
+        }
+    }
+    evaluate_words_scalar(edges, virgin_bits, i, end, new_edges);
+}
+#endif
+
+static evaluate_kernel_fn evaluate_kernel = NULL;
+
+// Picks the widest kernel supported by the CPU we are running on.
+// Setting REPRL_EVAL_KERNEL=scalar|avx2|avx512|neon forces a specific kernel (useful for debugging).
+static evaluate_kernel_fn select_evaluate_kernel()
+{
+    const char* forced = getenv("REPRL_EVAL_KERNEL");
+    evaluate_kernel_fn kernel = evaluate_words_scalar;
+    const char* name = "scalar";
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && (!forced || strcmp(forced, "avx512") == 0)) {
+        kernel = evaluate_words_avx512;
+        name = "avx512";
+    } else if (__builtin_cpu_supports("avx2") && (!forced || strcmp(forced, "avx2") == 0 || strcmp(forced, "avx512") == 0)) {
+        kernel = evaluate_words_avx2;
+        name = "avx2";
+    }
+#elif defined(__aarch64__)
+    kernel = evaluate_words_neon;
+    name = "neon";
+#endif
+    if (forced && strcmp(forced, "scalar") == 0) {
+        kernel = evaluate_words_scalar;
+        name = "scalar";
+    }
+    printf("[LibCoverage] Using %s coverage evaluation kernel\n", name);
+    return kernel;
+}
+
+// ================ Hit count kernels ==================
+//
+// The hit count map holds one wrapping 8-bit counter per edge. Counters are classified into the
+// AFL buckets 0, 1, 2, 3, 4-7, 8-15, 16-31, 32-127 and 128-255, each represented by a single bit, and
+// compared against the virgin counts map in which a set bit means the bucket was never seen for that edge.
+//
+// A bucket is derived from the two nibbles of the counter: if the high nibble is non-zero it
+// alone decides the bucket, otherwise the low nibble does. This maps directly onto byte shuffles.
+// All kernels work on the byte range [begin, end) and zero every non-zero counter they read.
+
+static const uint8_t count_class_lo[16] = { 0, 1, 2, 4, 8, 8, 8, 8, 16, 16, 16, 16, 16, 16, 16, 16 };
+static const uint8_t count_class_hi[16] = { 0, 32, 64, 64, 64, 64, 64, 64, 128, 128, 128, 128, 128, 128, 128, 128 };
+
+typedef void (*count_kernel_fn)(uint8_t* counters, uint8_t* virgin_counts, uint64_t begin, uint64_t end, struct edge_set* new_edges, uint32_t* new_buckets);
+
+static inline uint8_t classify_count(uint8_t count)
+{
+    uint8_t hi = count_class_hi[count >> 4];
+    return hi ? hi : count_class_lo[count & 15];
+}
+
+// new_buckets runs parallel to new_edges->edge_indices and receives the bucket bit of every new entry.
+static inline void collect_new_bucket(uint64_t index, uint8_t bucket, uint8_t* virgin_counts, struct edge_set* new_edges, uint32_t* new_buckets)
+{
+    virgin_counts[index] &= ~bucket;
+    new_buckets[new_edges->count] = bucket;
+    new_edges->edge_indices[new_edges->count++] = (uint32_t)index;
+}
+
+static void count_bytes_scalar(uint8_t* counters, uint8_t* virgin_counts, uint64_t begin, uint64_t end, struct edge_set* new_edges, uint32_t* new_buckets)
+{
+    for (uint64_t i = begin; i < end; i += 8) {
+        uint64_t word;
+        memcpy(&word, counters + i, 8);
+        if (likely(word == 0)) {
+            continue;
+        }
+        for (uint64_t j = i; j < i + 8; j++) {
+            uint8_t bucket = classify_count(counters[j]);
+            if (unlikely(bucket & virgin_counts[j])) {
+                collect_new_bucket(j, bucket, virgin_counts, new_edges, new_buckets);
+            }
+        }
+        memset(counters + i, 0, 8);
+    }
+}
+
+#if defined(__x86_64__)
+__attribute__((target("avx2")))
+static void count_bytes_avx2(uint8_t* counters, uint8_t* virgin_counts, uint64_t begin, uint64_t end, struct edge_set* new_edges, uint32_t* new_buckets)
+{
+    const __m256i lut_lo = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)count_class_lo));
+    const __m256i lut_hi = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)count_class_hi));
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+    const __m256i zero = _mm256_setzero_si256();
+    for (uint64_t i = begin; i < end; i += 32) {
+        __m256i cur = _mm256_loadu_si256((const __m256i*)(counters + i));
+        if (likely(_mm256_testz_si256(cur, cur))) {
+            continue;
+        }
+        __m256i hi = _mm256_shuffle_epi8(lut_hi, _mm256_and_si256(_mm256_srli_epi16(cur, 4), nibble));
+        __m256i lo = _mm256_shuffle_epi8(lut_lo, _mm256_and_si256(cur, nibble));
+        __m256i buckets = _mm256_or_si256(hi, _mm256_and_si256(_mm256_cmpeq_epi8(hi, zero), lo));
+        __m256i vir = _mm256_loadu_si256((const __m256i*)(virgin_counts + i));
+        uint32_t novel = ~(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_and_si256(buckets, vir), zero));
+        _mm256_storeu_si256((__m256i*)(counters + i), zero);
+        if (unlikely(novel)) {
+            uint8_t values[32];
+            _mm256_storeu_si256((__m256i*)values, buckets);
+            while (novel) {
+                uint32_t j = __builtin_ctz(novel);
+                collect_new_bucket(i + j, values[j], virgin_counts, new_edges, new_buckets);
+                novel &= novel - 1;
+            }
+        }
+    }
+}
+#endif
 
-	// The correct bitmap size is calculated in the >coverage_finish_initialization< function
-	// This function must be called after the first execution, however, the first execution
-	// Already uses the bitmap_size. I therefore set it here to zero so that the
-	// coverage_clear_bitmap() function does not write something in the first call
-	context->bitmap_size	= 0;
-    context->virgin_bits = NULL;
-	return 0;
+#if defined(__aarch64__)
+static void count_bytes_neon(uint8_t* counters, uint8_t* virgin_counts, uint64_t begin, uint64_t end, struct edge_set* new_edges, uint32_t* new_buckets)
+{
+    const uint8x16_t lut_lo = vld1q_u8(count_class_lo);
+    const uint8x16_t lut_hi = vld1q_u8(count_class_hi);
+    const uint8x16_t zero = vdupq_n_u8(0);
+    for (uint64_t i = begin; i < end; i += 16) {
+        uint8x16_t cur = vld1q_u8(counters + i);
+        if (likely(vmaxvq_u8(cur) == 0)) {
+            continue;
+        }
+        uint8x16_t hi = vqtbl1q_u8(lut_hi, vshrq_n_u8(cur, 4));
+        uint8x16_t lo = vqtbl1q_u8(lut_lo, vandq_u8(cur, vdupq_n_u8(0x0f)));
+        uint8x16_t buckets = vorrq_u8(hi, vandq_u8(vceqq_u8(hi, zero), lo));
+        uint8x16_t novel = vandq_u8(buckets, vld1q_u8(virgin_counts + i));
+        vst1q_u8(counters + i, zero);
+        if (unlikely(vmaxvq_u8(novel) != 0)) {
+            uint8_t values[16];
+            vst1q_u8(values, buckets);
+            for (uint64_t j = 0; j < 16; j++) {
+                if (values[j] & virgin_counts[i + j]) {
+                    collect_new_bucket(i + j, values[j], virgin_counts, new_edges, new_buckets);
+                }
+            }
+        }
+    }
+}
+#endif
+
+static count_kernel_fn count_kernel = NULL;
+
+// Same selection rules as select_evaluate_kernel(), there is no AVX-512 variant.
+static count_kernel_fn select_count_kernel()
+{
+    const char* forced = getenv("REPRL_EVAL_KERNEL");
+    count_kernel_fn kernel = count_bytes_scalar;
+    const char* name = "scalar";
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        kernel = count_bytes_avx2;
+        name = "avx2";
+    }
+#elif defined(__aarch64__)
+    kernel = count_bytes_neon;
+    name = "neon";
+#endif
+    if (forced && strcmp(forced, "scalar") == 0) {
+        kernel = count_bytes_scalar;
+        name = "scalar";
+    }
+    printf("[LibCoverage] Using %s hit count kernel\n", name);
+    return kernel;
+}
+
+static int reprl_restart_with_env(int worker_id, const char* assignment);
+
+// REPRL_SHM_SIZE=auto: recreates the coverage region of a worker with room for num_edges edges (rounded up to
+// whole huge pages) and runs the engine once more, so that it reports its edges with the new region.
+static int coverage_grow_shm(int worker_id, uint32_t num_edges)
+{
+    struct cov_context* context = cov_context_of(worker_id);
+    if (context == NULL) {
+        return -1;
+    }
+    uint64_t size = sizeof(struct shmem_data) + (num_edges + 7) / 8 + sizeof(struct shmem_dirty_map);
+    size = (size + HUGE_PAGE_SIZE - 1) & ~((uint64_t)HUGE_PAGE_SIZE - 1);
+    if (size > SHM_MAX_SIZE) {
+        return -1;
+    }
+    printf("[LibCoverage] Growing the coverage region of worker %d to %lu bytes for %u edges\n", worker_id, (unsigned long)size, num_edges);
+
+    context->shm_size = size;
+    if (coverage_initialize(worker_id) != 0) {
+        return -1;
+    }
+    char assignment[64];
+    snprintf(assignment, sizeof(assignment), "SHM_SIZE=%lu", (unsigned long)size);
+    if (reprl_restart_with_env(worker_id, assignment) != 0) {
+        return -1;
+    }
+    execute_script("", 1000, 0, worker_id);
+    uint32_t reported = context->shmem->num_edges;
+    return reported != 0 && reported + 1 <= SHM_MAX_EDGES_FOR_SIZE(size) ? 0 : -1;
+}
+
+// Makes sure the edge arena has room for count more indices. A full arena is retired and replaced by a fresh one,
+// so views handed out earlier are never overwritten. Returns -1 if the caller did not reset the arena for so long
+// that EDGE_ARENA_MAX_RETIRED arenas are retired already.
+static int edge_arena_reserve(struct cov_context* context, uint64_t count)
+{
+    if (context->edge_arena_capacity - context->edge_arena_used >= count) {
+        return 0;
+    }
+    if (context->retired_arena_count == EDGE_ARENA_MAX_RETIRED) {
+        fprintf(stderr, "[LibCoverage] Edge arena of worker %d is exhausted, cov_reset_edge_arena() was not called\n", context->id);
+        return -1;
+    }
+    uint32_t* edge_arena = malloc(context->edge_arena_capacity * sizeof(uint32_t));
+    uint32_t* bucket_arena = context->bucket_arena != NULL ? malloc(context->edge_arena_capacity * sizeof(uint32_t)) : NULL;
+    if (edge_arena == NULL || (context->bucket_arena != NULL && bucket_arena == NULL)) {
+        free(edge_arena);
+        free(bucket_arena);
+        return -1;
+    }
+    context->retired_edge_arenas[context->retired_arena_count] = context->edge_arena;
+    context->retired_bucket_arenas[context->retired_arena_count] = context->bucket_arena;
+    context->retired_arena_count++;
+    context->edge_arena = edge_arena;
+    context->bucket_arena = bucket_arena;
+    context->edge_arena_used = 0;
+    return 0;
 }
 
+static void free_retired_edge_arenas(struct cov_context* context)
+{
+    for (uint32_t i = 0; i < context->retired_arena_count; i++) {
+        free(context->retired_edge_arenas[i]);
+        free(context->retired_bucket_arenas[i]);
+    }
+    context->retired_arena_count = 0;
+}
 
 uint32_t coverage_finish_initialization(int worker_id, int should_track_edges) {
-    struct cov_context* context = &contexts[worker_id];
+    struct cov_context* context = cov_context_of(worker_id);
+    if (context == NULL) {
+        return 0;
+    }
     uint32_t num_edges = context->shmem->num_edges;
     if (num_edges == 0) {
         fprintf(stderr, "[LibCoverage] Coverage bitmap size could not be determined, is the engine instrumentation working properly?\n");
@@ -374,13 +1826,18 @@ uint32_t coverage_finish_initialization(int worker_id, int should_track_edges) {
     // To keep the coverage instrumentation as simple as possible, we simply start indexing edges at one and thus ignore the zeroth edge.
     num_edges += 1;
     if(context->virgin_bits != NULL) {
-		free(context->virgin_bits);
-
+		release_virgin_bits(context);
 	}
 
 
-    if (num_edges > MAX_EDGES) {
-        exit(-1);           // TODO
+    if (num_edges > SHM_MAX_EDGES_FOR_SIZE(context->shm_size)) {
+        if (!context->shm_auto_size || coverage_grow_shm(worker_id, num_edges) != 0) {
+            fprintf(stderr, "[LibCoverage] The engine has %u edges, but a coverage region of %lu bytes only has room for %lu. "
+                    "Set REPRL_SHM_SIZE to a larger size or to auto\n",
+                    num_edges, (unsigned long)context->shm_size, (unsigned long)SHM_MAX_EDGES_FOR_SIZE(context->shm_size));
+            exit(-1);
+        }
+        num_edges = context->shmem->num_edges + 1;
     }
     // Compute the bitmap size in bytes required for the given number of edges and
     // make sure that the allocation size is rounded up to the next 8-byte boundary.
@@ -393,10 +1850,21 @@ uint32_t coverage_finish_initialization(int worker_id, int should_track_edges) {
 
     context->should_track_edges = should_track_edges;
 
-    context->virgin_bits = malloc(bitmap_size);
+    context->virgin_bits = alloc_bitmap(bitmap_size);
     context->virgin_bits_backup = malloc(bitmap_size);
     context->coverage_map_backup = malloc(bitmap_size);
 
+    // A single evaluation can return at most one index per bitmap bit. Reserving room for two
+    // evaluations lets a caller hold on to one result while re-executing (e.g. to check flakiness).
+    // Pages of the arena are only backed by memory once indices are written to them.
+    free(context->target_mask);
+    context->target_mask = NULL;
+    free_retired_edge_arenas(context);
+    free(context->edge_arena);
+    context->edge_arena_capacity = 2 * (uint64_t)bitmap_size * 8;
+    context->edge_arena = malloc(context->edge_arena_capacity * sizeof(uint32_t));
+    context->edge_arena_used = 0;
+
     // context.crash_bits = malloc(bitmap_size);
     memset(context->virgin_bits, 0xff, bitmap_size);
     // memset(context->crash_bits, 0xff, bitmap_size);
@@ -405,92 +1873,564 @@ uint32_t coverage_finish_initialization(int worker_id, int should_track_edges) {
     // Zeroth edge is ignored, see above.
     clear_edge(context->virgin_bits, 0);
     // clear_edge(context->crash_bits, 0);
+    delta_reset(context);
+
+    if (evaluate_kernel == NULL) {
+        evaluate_kernel = select_evaluate_kernel();
+    }
+
+    // The child has executed at least once at this point, so it had the chance to announce dirty block tracking.
+    context->dirty_tracking = 0;
+    if (context->dirty_tracking_requested) {
+        if (context->dirty->magic != SHM_DIRTY_MAGIC) {
+            printf("[LibCoverage] Dirty block tracking requested but not supported by the engine, scanning the full bitmap\n");
+        } else if (sizeof(struct shmem_data) + bitmap_size > SHM_DIRTY_MAP_OFFSET_FOR_SIZE(context->shm_size) ||
+                   bitmap_size > (uint64_t)SHM_DIRTY_MAX_BLOCKS * SHM_DIRTY_BLOCK_SIZE) {
+            printf("[LibCoverage] Bitmap too large for dirty block tracking, scanning the full bitmap\n");
+        } else {
+            context->dirty_tracking = 1;
+            printf("[LibCoverage] Using dirty block tracking\n");
+        }
+    }
+
+    context->hitcounts = 0;
+    if (context->hitcounts_requested) {
+        if (context->counters == NULL || context->counters->magic != SHM_COUNTERS_MAGIC) {
+            printf("[LibCoverage] Hit counts requested but not supported by the engine, using edge coverage only\n");
+        } else {
+            if (count_kernel == NULL) {
+                count_kernel = select_count_kernel();
+            }
+            // The count kernels work on 32-byte blocks, SHM_MAX_EDGES_FOR_SIZE() of a page multiple is a multiple of that.
+            context->counts_size = (num_edges + 31) & ~31u;
+            free(context->virgin_counts);
+            context->virgin_counts = malloc(context->counts_size);
+            memset(context->virgin_counts, 0xff, context->counts_size);
+            // Zeroth edge is ignored, see above.
+            context->virgin_counts[0] = 0;
+            free(context->bucket_arena);
+            context->bucket_arena = malloc(context->edge_arena_capacity * sizeof(uint32_t));
+            context->hitcounts = 1;
+            printf("[LibCoverage] Using hit count buckets\n");
+        }
+    }
+
+    context->cmplog_enabled = 0;
+    if (context->cmplog_requested) {
+        if (context->cmplog == NULL || context->cmplog->magic != SHM_CMPLOG_MAGIC) {
+            printf("[LibCoverage] Comparison log requested but not supported by the engine\n");
+        } else {
+            if (context->cmp_seen == NULL) {
+                context->cmp_seen = calloc(CMPLOG_SEEN_SLOTS, sizeof(uint64_t));
+                context->cmp_new = malloc(SHM_CMPLOG_CAPACITY * sizeof(struct CmpEvent));
+            }
+            context->cmp_new_count = 0;
+            context->cmplog_enabled = 1;
+            printf("[LibCoverage] Using the comparison log\n");
+        }
+    }
+
+    context->shared_virgin = NULL;
+    if (context->shared_virgin_requested) {
+        struct shared_virgin_map* map = coverage_attach_shared_virgin_map(bitmap_size);
+        if (map != NULL) {
+            context->shared_virgin = map->words;
+            printf("[LibCoverage] Using the shared virgin map\n");
+        }
+    }
+    return num_edges;
+}
+
+// Calls fn(context, first_block, num_blocks, arg) for every run of consecutive dirty blocks.
+// Runs are clamped to the bitmap and do not extend across 64-block boundaries.
+typedef void (*dirty_run_fn)(struct cov_context* context, uint64_t first_block, uint64_t num_blocks, void* arg);
+
+static void for_each_dirty_run(struct cov_context* context, dirty_run_fn fn, void* arg)
+{
+    uint64_t num_blocks = ((uint64_t)context->bitmap_size + SHM_DIRTY_BLOCK_SIZE - 1) / SHM_DIRTY_BLOCK_SIZE;
+    uint64_t num_words = (num_blocks + 63) / 64;
+    for (uint64_t w = 0; w < num_words; w++) {
+        uint64_t bits = context->dirty->blocks[w];
+        while (bits) {
+            uint64_t start = __builtin_ctzll(bits);
+            uint64_t shifted = ~(bits >> start);
+            uint64_t len = shifted ? (uint64_t)__builtin_ctzll(shifted) : 64 - start;
+            bits = len + start >= 64 ? 0 : bits & ~(((1ULL << len) - 1) << start);
+
+            uint64_t first_block = w * 64 + start;
+            if (first_block >= num_blocks) break;
+            fn(context, first_block, MIN(len, num_blocks - first_block), arg);
+        }
+    }
 }
 
-static uint32_t internal_evaluate(struct cov_context* context, uint8_t* virgin_bits, struct edge_set* new_edges)
+struct dirty_evaluate_args {
+    uint8_t* virgin_bits;
+    struct edge_set* new_edges;
+};
+
+static void evaluate_dirty_run(struct cov_context* context, uint64_t first_block, uint64_t num_blocks, void* arg)
 {
-    uint64_t* current = (uint64_t*)context->shmem->edges;
-    uint64_t* end = (uint64_t*)(context->shmem->edges + context->bitmap_size);
-    uint64_t* virgin = (uint64_t*)virgin_bits;
+    struct dirty_evaluate_args* args = arg;
+    uint64_t words_per_block = SHM_DIRTY_BLOCK_SIZE / 8;
+    uint64_t begin = first_block * words_per_block;
+    uint64_t end = MIN(begin + num_blocks * words_per_block, (uint64_t)context->bitmap_size / 8);
+    evaluate_kernel(context->shmem->edges, args->virgin_bits, begin, end, args->new_edges);
+}
+
+static void clear_dirty_run(struct cov_context* context, uint64_t first_block, uint64_t num_blocks, void* arg)
+{
+    (void)arg;
+    uint64_t begin = first_block * SHM_DIRTY_BLOCK_SIZE;
+    uint64_t end = MIN(begin + num_blocks * SHM_DIRTY_BLOCK_SIZE, (uint64_t)context->bitmap_size);
+    memset(context->shmem->edges + begin, 0, end - begin);
+}
+
+// Zeroes len bytes of the bitmap. The bitmap is written by the child next, so on x86 the aligned middle part
+// is written with non-temporal stores instead of pulling the lines into this core's cache.
+static void clear_edges_streaming(uint8_t* edges, uint64_t len)
+{
+#if defined(__x86_64__)
+    uint64_t head = MIN(len, (16 - ((uintptr_t)edges & 15)) & 15);
+    memset(edges, 0, head);
+    edges += head;
+    len -= head;
+
+    __m128i zero = _mm_setzero_si128();
+    uint64_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        _mm_stream_si128((__m128i*)(edges + i), zero);
+    }
+    memset(edges + i, 0, len - i);
+    _mm_sfence();
+#else
+    memset(edges, 0, len);
+#endif
+}
+
+// Words evaluated before the same range is cleared. Small enough that the range is still in L1 when it is cleared.
+#define EVALUATE_RESET_CHUNK_WORDS 512
+
+static void evaluate_and_reset_words(struct cov_context* context, uint8_t* virgin_bits, uint64_t begin, uint64_t end, struct edge_set* new_edges)
+{
+    for (uint64_t chunk = begin; chunk < end; chunk += EVALUATE_RESET_CHUNK_WORDS) {
+        uint64_t chunk_end = MIN(chunk + EVALUATE_RESET_CHUNK_WORDS, end);
+        evaluate_kernel(context->shmem->edges, virgin_bits, chunk, chunk_end, new_edges);
+        clear_edges_streaming(context->shmem->edges + chunk * 8, (chunk_end - chunk) * 8);
+    }
+}
+
+static void evaluate_and_reset_dirty_run(struct cov_context* context, uint64_t first_block, uint64_t num_blocks, void* arg)
+{
+    struct dirty_evaluate_args* args = arg;
+    uint64_t words_per_block = SHM_DIRTY_BLOCK_SIZE / 8;
+    uint64_t begin = first_block * words_per_block;
+    uint64_t end = MIN(begin + num_blocks * words_per_block, (uint64_t)context->bitmap_size / 8);
+    evaluate_and_reset_words(context, args->virgin_bits, begin, end, args->new_edges);
+}
+
+static inline int use_dirty_blocks(struct cov_context* context)
+{
+    return context->dirty_tracking && !context->dirty->overflow;
+}
+
+static void clear_dirty_map(struct cov_context* context)
+{
+    uint64_t num_blocks = ((uint64_t)context->bitmap_size + SHM_DIRTY_BLOCK_SIZE - 1) / SHM_DIRTY_BLOCK_SIZE;
+    memset(context->dirty->blocks, 0, ((num_blocks + 63) / 64) * sizeof(uint64_t));
+}
+
+static void clear_edge_bitmap(struct cov_context* context)
+{
+    if (use_dirty_blocks(context)) {
+        // Only the blocks the child marked can contain set bits.
+        for_each_dirty_run(context, clear_dirty_run, NULL);
+        clear_dirty_map(context);
+    } else {
+        memset(context->shmem->edges, 0, context->bitmap_size);
+        if (context->dirty_tracking) {
+            memset(context->dirty->blocks, 0, sizeof(context->dirty->blocks));
+            context->dirty->overflow = 0;
+        }
+    }
+    context->map_clean = 1;
+}
+
+// Returns the number of new edges or -1 (with an empty new_edges) if the edge arena is exhausted.
+static int internal_evaluate(struct cov_context* context, uint8_t* virgin_bits, struct edge_set* new_edges, int reset)
+{
+    // Make sure the arena can hold the worst case of this evaluation
     new_edges->count = 0;
     new_edges->edge_indices = NULL;
+    if (edge_arena_reserve(context, (uint64_t)context->bitmap_size * 8) != 0) {
+        return -1;
+    }
+    new_edges->edge_indices = context->edge_arena + context->edge_arena_used;
 
     // Perform the initial pass regardless of the setting for tracking how often invidual edges are hit
-    while (current < end) {
-        if (*current && unlikely(*current & *virgin)) {
-            // New edge(s) found!
-            // We know that we have <= UINT32_MAX edges, so every index can safely be truncated to 32 bits.
-            uint64_t index = (uint64_t)((uintptr_t)current - (uintptr_t)context->shmem->edges) * 8;
-            for (uint64_t i = index; i < index + 64; i++) {
-                if (edge(context->shmem->edges, i) == 1 && edge(virgin_bits, i) == 1) {
-                    clear_edge(virgin_bits, i);
-                    new_edges->count += 1;
-                    size_t new_num_entries = new_edges->count;
-                    new_edges->edge_indices = realloc(new_edges->edge_indices, new_num_entries * sizeof(uint64_t));
-                    new_edges->edge_indices[new_edges->count - 1] = i;
-                }
-            }
+    if (use_dirty_blocks(context)) {
+        struct dirty_evaluate_args args = { virgin_bits, new_edges };
+        for_each_dirty_run(context, reset ? evaluate_and_reset_dirty_run : evaluate_dirty_run, &args);
+        if (reset) clear_dirty_map(context);
+    } else if (reset) {
+        evaluate_and_reset_words(context, virgin_bits, 0, context->bitmap_size / 8, new_edges);
+        if (context->dirty_tracking) {
+            memset(context->dirty->blocks, 0, sizeof(context->dirty->blocks));
+            context->dirty->overflow = 0;
         }
+    } else {
+        evaluate_kernel(context->shmem->edges, virgin_bits, 0, context->bitmap_size / 8, new_edges);
+    }
+    if (reset) context->map_clean = 1;
 
-        current++;
-        virgin++;
+    if (context->shared_virgin != NULL && new_edges->count > 0) {
+        claim_shared_edges(context->shared_virgin, new_edges);
     }
+    delta_append_edges(context, new_edges);
 
+    context->edge_arena_used += new_edges->count;
     return new_edges->count;
 }
 
 
+// The returned edge_set borrows its indices from the edge arena of the worker. They stay valid
+// until the next call to cov_reset_edge_arena() and must not be freed by the caller. Returns -1 if
+// the arena is exhausted because it was not reset for too long.
 int cov_evaluate(int worker_id,struct edge_set* new_edges  )
 {
-    struct cov_context* context = &contexts[worker_id];
-    uint32_t num_new_edges = internal_evaluate(context, context->virgin_bits ,new_edges);
+    uint64_t phase_start = current_nsecs();
+    struct cov_context* context = cov_context_of(worker_id);
+    if (context == NULL) {
+        return -1;
+    }
+    int num_new_edges = internal_evaluate(context, context->virgin_bits ,new_edges, 0);
+    record_phase(worker_slot_of(worker_id)->phases, REPRL_PHASE_EVALUATE, phase_start);
     return num_new_edges ;
 }
 
-// struct CmpEvent* cov_fetch_cmp_events(int worker_id) {
-//     struct cov_context* context = &contexts[worker_id];
-//     return context->shmem->g_cmp_events;
-// }
+// Same as cov_evaluate(), but also zeroes the bitmap in the same pass. The next reprl_execute() on this
+// worker then does not have to clear the bitmap again. Must only be used once the result of the last
+// execution is no longer needed.
+int cov_evaluate_and_reset(int worker_id, struct edge_set* new_edges)
+{
+    uint64_t phase_start = current_nsecs();
+    struct cov_context* context = cov_context_of(worker_id);
+    if (context == NULL) {
+        return -1;
+    }
+    int num_new_edges = internal_evaluate(context, context->virgin_bits, new_edges, 1);
+    record_phase(worker_slot_of(worker_id)->phases, REPRL_PHASE_EVALUATE, phase_start);
+    return num_new_edges;
+}
+
+// Evaluates the hit count map of the last execution and resets it. new_edges receives every edge that reached
+// a bucket it never reached before, counts->edge_hit_count the matching bucket bits (see count_class_lo/hi).
+// Both borrow from the edge arena like cov_evaluate(). Edges found this way are also marked as seen in the
+// edge bitmap. Returns the number of new buckets or -1 if the engine does not provide hit counts or the
+// edge arena is exhausted.
+int cov_evaluate_counts(int worker_id, struct edge_set* new_edges, struct edge_counts* counts)
+{
+    struct cov_context* context = cov_context_of(worker_id);
+    new_edges->count = 0;
+    counts->count = 0;
+    counts->new_edges = 0;
+    if (context == NULL || !context->hitcounts) {
+        return -1;
+    }
 
-// uint64_t fetch_event_count(int worker_id) {
-//     struct cov_context* context = &contexts[worker_id];
-//     return context->shmem->event_count;
-// }
+    if (edge_arena_reserve(context, context->counts_size) != 0) {
+        return -1;
+    }
+    new_edges->edge_indices = context->edge_arena + context->edge_arena_used;
+    counts->edge_hit_count = context->bucket_arena + context->edge_arena_used;
 
-// void cov_clear_cmp_events(int worker_id) {
-//     struct cov_context* context = &contexts[worker_id];
-//     context->shmem->event_count = 0;
-//     memset(context->shmem->g_cmp_events, 0, sizeof(struct CmpEvent) * context->shmem->event_count);
-// }
-void init(int worker_id){
-    printf("Worker %d Initializing\n", worker_id);
-    char **prog_argv = malloc(20 * sizeof(char *));
-    int arg_idx = 0;
-    // char *target_path = getenv("TARGET"); // Unused variable
-    char *target = getenv("TARGET");
-    char *bin_path = getenv("BIN");
-    char *compiler = getenv("BASELINE");
+    count_kernel(context->counters->counters, context->virgin_counts, 0, context->counts_size, new_edges, counts->edge_hit_count);
+    context->counters_clean = 1;
 
-    if (target == NULL || bin_path == NULL) {
-        fprintf(stderr, "ERROR: TARGET and BIN environment variables must be set\n");
-        exit(1);
+    for (uint32_t i = 0; i < new_edges->count; i++) {
+        if (edge(context->virgin_bits, new_edges->edge_indices[i])) {
+            clear_edge(context->virgin_bits, new_edges->edge_indices[i]);
+            delta_append(context, new_edges->edge_indices[i], 0);
+            counts->new_edges++;
+        }
+    }
+    counts->count = new_edges->count;
+    context->edge_arena_used += new_edges->count;
+    return new_edges->count;
+}
+
+// Marks edges as seen without executing anything, e.g. the edges another worker reported for a sample.
+// Returns how many of them this worker had not seen before. Indices outside the bitmap are ignored.
+// If merged is not NULL it receives these new edges, borrowed from the edge arena like the result of cov_evaluate().
+// Returns -1 (with an empty merged) if the edge arena is exhausted.
+int cov_merge_edges(int worker_id, const uint32_t* indices, uint32_t count, struct edge_set* merged)
+{
+    struct cov_context* context = cov_context_of(worker_id);
+    uint32_t* merged_indices = NULL;
+    if (merged != NULL) {
+        merged->count = 0;
+        merged->edge_indices = NULL;
+    }
+    if (context == NULL) {
+        return -1;
+    }
+    if (merged != NULL) {
+        // Every edge is merged at most once
+        if (edge_arena_reserve(context, MIN(count, context->num_edges)) != 0) {
+            return -1;
+        }
+        merged_indices = context->edge_arena + context->edge_arena_used;
+    }
+    uint32_t new_edges = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t index = indices[i];
+        if (index >= context->num_edges || !edge(context->virgin_bits, index)) {
+            continue;
+        }
+        clear_edge(context->virgin_bits, index);
+        delta_append(context, index, 0);
+        if (merged_indices != NULL) {
+            merged_indices[new_edges] = index;
+        }
+        new_edges++;
+    }
+    if (merged != NULL) {
+        merged->count = new_edges;
+        merged->edge_indices = new_edges ? merged_indices : NULL;
+        context->edge_arena_used += new_edges;
+    }
+    return new_edges;
+}
+
+// Same as cov_merge_edges() for the hit count buckets another worker reported, buckets[i] holds the bucket
+// bits of indices[i] (see cov_evaluate_counts()). Returns how many of the buckets this worker had not seen
+// before, or -1 if it does not use hit counts.
+int cov_merge_counts(int worker_id, const uint32_t* indices, const uint32_t* buckets, uint32_t count)
+{
+    struct cov_context* context = cov_context_of(worker_id);
+    if (context == NULL || !context->hitcounts) {
+        return -1;
+    }
+    int new_buckets = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t index = indices[i];
+        if (index >= context->num_edges) {
+            continue;
+        }
+        uint8_t novel = (uint8_t)buckets[i] & context->virgin_counts[index];
+        if (novel) {
+            context->virgin_counts[index] &= ~novel;
+            new_buckets += __builtin_popcount(novel);
+        }
+    }
+    return new_buckets;
+}
+
+// Returns how many of the given edges the last execution hit, no matter if they were seen before.
+// Must be called before the bitmap is reset, i.e. not after cov_evaluate_and_reset().
+int cov_count_hit_edges(int worker_id, const uint32_t* indices, uint32_t count)
+{
+    struct cov_context* context = cov_context_of(worker_id);
+    if (context == NULL) {
+        return 0;
+    }
+    int hit = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (indices[i] < context->num_edges && edge(context->shmem->edges, indices[i])) {
+            hit++;
+        }
+    }
+    return hit;
+}
+
+// Replaces the target edge mask of the worker with the given edges, see cov_count_target_hits().
+// Returns the number of edges in the mask, or -1 if the coverage is not initialized yet.
+int cov_set_target_edges(int worker_id, const uint32_t* indices, uint32_t count)
+{
+    struct cov_context* context = cov_context_of(worker_id);
+    if (context == NULL) {
+        return -1;
+    }
+    if (context->bitmap_size == 0) {
+        return -1;
+    }
+    if (context->target_mask == NULL) {
+        context->target_mask = malloc(context->bitmap_size);
+        if (context->target_mask == NULL) {
+            return -1;
+        }
+    }
+    memset(context->target_mask, 0, context->bitmap_size);
+    int valid = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (indices[i] < context->num_edges && !edge((uint8_t*)context->target_mask, indices[i])) {
+            set_edge((uint8_t*)context->target_mask, indices[i]);
+            valid++;
+        }
+    }
+    return valid;
+}
+
+// Number of target edges that the last execution hit. Same as cov_count_hit_edges() with the
+// target edges, but a single AND over the bitmap instead of a lookup per index.
+// The virgin bits are not touched.
+int cov_count_target_hits(int worker_id)
+{
+    struct cov_context* context = cov_context_of(worker_id);
+    if (context == NULL) {
+        return 0;
+    }
+    if (context->target_mask == NULL) {
+        return 0;
+    }
+    return (int)count_common_bits(context->target_mask, (const uint64_t*)context->shmem->edges, context->bitmap_size / 8);
+}
+
+int cov_shared_virgin_enabled(int worker_id)
+{
+    struct cov_context* context = cov_context_of(worker_id);
+    return context != NULL && context->shared_virgin != NULL;
+}
+
+int cov_hitcounts_enabled(int worker_id)
+{
+    struct cov_context* context = cov_context_of(worker_id);
+    return context != NULL && context->hitcounts;
+}
+
+// Releases all edge_set views handed out by cov_evaluate() on this worker.
+void cov_reset_edge_arena(int worker_id)
+{
+    struct cov_context* context = cov_context_of(worker_id);
+    if (context == NULL) {
+        return;
+    }
+    free_retired_edge_arenas(context);
+    context->edge_arena_used = 0;
+}
+
+int cov_cmplog_enabled(int worker_id)
+{
+    struct cov_context* context = cov_context_of(worker_id);
+    return context != NULL && context->cmplog_enabled;
+}
+
+static inline uint64_t cmp_pair_hash(int64_t left, int64_t right)
+{
+    // splitmix64 finalizer over both operands, zero is reserved for free slots
+    uint64_t hash = (uint64_t)left * 0x9E3779B97F4A7C15ULL ^ ((uint64_t)right + 0x632BE59BD9B4E019ULL);
+    hash = (hash ^ (hash >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    hash = (hash ^ (hash >> 27)) * 0x94D049BB133111EBULL;
+    hash ^= hash >> 31;
+    return hash ? hash : 1;
+}
+
+// Returns whether the pair was not in the seen table and inserts it. A table that is three quarters full starts over,
+// so a pair may be handed out again much later.
+static int cmp_pair_is_new(struct cov_context* context, uint64_t hash)
+{
+    if (context->cmp_seen_used >= CMPLOG_SEEN_SLOTS / 4 * 3) {
+        memset(context->cmp_seen, 0, CMPLOG_SEEN_SLOTS * sizeof(uint64_t));
+        context->cmp_seen_used = 0;
+    }
+    uint32_t slot = hash & (CMPLOG_SEEN_SLOTS - 1);
+    while (context->cmp_seen[slot] != 0) {
+        if (context->cmp_seen[slot] == hash) {
+            return 0;
+        }
+        slot = (slot + 1) & (CMPLOG_SEEN_SLOTS - 1);
+    }
+    context->cmp_seen[slot] = hash;
+    context->cmp_seen_used++;
+    return 1;
+}
+
+// Drains the comparison log of the child and returns the operand pairs that were not handed out before, fetch_event_count()
+// tells how many. The pairs are ordered (left <= right), pairs of equal operands are skipped. Only the consumed events are
+// read and nothing is cleared. The result stays valid until the next call on this worker. NULL without a comparison log.
+struct CmpEvent* cov_fetch_cmp_events(int worker_id)
+{
+    struct cov_context* context = cov_context_of(worker_id);
+    if (context == NULL) {
+        return NULL;
+    }
+    context->cmp_new_count = 0;
+    if (!context->cmplog_enabled) {
+        return NULL;
+    }
+    struct shmem_cmplog* log = context->cmplog;
+    uint64_t head = __atomic_load_n(&log->head, __ATOMIC_ACQUIRE);
+    uint64_t tail = log->tail;
+    // A restarted child may begin again at zero, and a child that ignores tail may have lapped the ring
+    if (head < tail) {
+        tail = 0;
+    }
+    if (head - tail > SHM_CMPLOG_CAPACITY) {
+        tail = head - SHM_CMPLOG_CAPACITY;
+    }
+    for (; tail < head; tail++) {
+        struct CmpEvent event = log->events[tail & (SHM_CMPLOG_CAPACITY - 1)];
+        if (event.left == event.right) {
+            continue;
+        }
+        if (event.left > event.right) {
+            int64_t left = event.left;
+            event.left = event.right;
+            event.right = left;
+        }
+        if (cmp_pair_is_new(context, cmp_pair_hash(event.left, event.right))) {
+            context->cmp_new[context->cmp_new_count++] = event;
+        }
+    }
+    __atomic_store_n(&log->tail, head, __ATOMIC_RELEASE);
+    return context->cmp_new;
+}
+
+uint64_t fetch_event_count(int worker_id)
+{
+    struct cov_context* context = cov_context_of(worker_id);
+    return context != NULL ? context->cmp_new_count : 0;
+}
+
+// Drops the events the child logged so far without looking at them.
+void cov_clear_cmp_events(int worker_id)
+{
+    struct cov_context* context = cov_context_of(worker_id);
+    if (context == NULL) {
+        return;
+    }
+    context->cmp_new_count = 0;
+    if (context->cmplog_enabled) {
+        __atomic_store_n(&context->cmplog->tail, __atomic_load_n(&context->cmplog->head, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+    }
+}
+
+// Builds the command line for the engine described by config. The engine specific flags come first, then
+// config->extra_args. Returns NULL if the engine is unknown.
+static char** reprl_build_engine_argv(const struct reprl_config* config)
+{
+    int num_extra_args = 0;
+    while (config->extra_args != NULL && config->extra_args[num_extra_args] != NULL) {
+        num_extra_args++;
     }
+    char **prog_argv = malloc((20 + num_extra_args) * sizeof(char *));
+    int arg_idx = 0;
 
     // Set binary path as first argument
-    prog_argv[arg_idx++] = bin_path;
+    prog_argv[arg_idx++] = dup_str(config->binary);
 
     // Configure arguments based on target engine
-    if (strcmp(target, "v8") == 0) {
+    if (strcmp(config->engine, "v8") == 0) {
         // V8 specific arguments
         prog_argv[arg_idx++] = "--allow-natives-syntax";
         prog_argv[arg_idx++] = "--expose-gc";
         prog_argv[arg_idx++] = "--fuzzing";
         prog_argv[arg_idx++] = "--harmony-temporal";
-        if ( worker_id > 100) {
+        if (config->print_bytecode) {
             prog_argv[arg_idx++] = "--print-bytecode";
         }
     }
-    else if (strcmp(target, "firefox") == 0) {
+    else if (strcmp(config->engine, "firefox") == 0) {
         // Firefox specific arguments
         prog_argv[arg_idx++] = "--baseline-warmup-threshold=10";
         prog_argv[arg_idx++] = "--ion-warmup-threshold=100";
@@ -500,14 +2440,14 @@ void init(int worker_id){
         prog_argv[arg_idx++] = "--disable-oom-functions";
         
         // Set compiler based on BASELINE env var
-        if (compiler == NULL) {
+        if (!config->wasm_baseline) {
             prog_argv[arg_idx++] = "--wasm-compiler=ion";
         } else {
             prog_argv[arg_idx++] = "--wasm-compiler=baseline";
         }
         prog_argv[arg_idx++] = "--reprl";
     }
-    else if (strcmp(target, "jsc") == 0) {
+    else if (strcmp(config->engine, "jsc") == 0) {
         // JavaScriptCore specific arguments
         prog_argv[arg_idx++] = "--validateAsYouParse=true";
         prog_argv[arg_idx++] = "--useConcurrentJIT=false";
@@ -523,19 +2463,44 @@ void init(int worker_id){
         prog_argv[arg_idx++] = "--reprl";
     }
     else {
-        fprintf(stderr, "ERROR: Unknown target engine: %s\n", target);
-        exit(1);
+        fprintf(stderr, "ERROR: Unknown target engine: %s\n", config->engine);
+        free(prog_argv[0]);
+        free(prog_argv);
+        return NULL;
+    }
+
+    for (int i = 0; i < num_extra_args; i++) {
+        prog_argv[arg_idx++] = dup_str(config->extra_args[i]);
     }
 
     // Null terminate argument list
     prog_argv[arg_idx] = NULL;
 
     // Debug print arguments
-    printf("Running %s with arguments:\n", target);
+    printf("Running %s with arguments:\n", config->engine);
     for (int i = 0; i < arg_idx; i++) {
         printf("  arg[%d]: %s\n", i, prog_argv[i]);
     }
+    return prog_argv;
+}
 
+// Creates the REPRL and coverage context of a worker from an explicit configuration instead of the
+// TARGET/BIN/BASELINE environment variables, so that the workers of one process can fuzz different engines.
+// Returns -1 if the engine is unknown or the context could not be initialized.
+int reprl_init_with_config(int worker_id, const struct reprl_config* config)
+{
+    printf("Worker %d Initializing\n", worker_id);
+    if (worker_slot_of(worker_id) == NULL) {
+        return -1;
+    }
+    if (config->engine == NULL || config->binary == NULL) {
+        fprintf(stderr, "ERROR: Worker %d has no engine or binary configured\n", worker_id);
+        return -1;
+    }
+    char **prog_argv = reprl_build_engine_argv(config);
+    if (prog_argv == NULL) {
+        return -1;
+    }
 
     int shm_id = worker_id;
 	// Now copy the environment
@@ -572,7 +2537,7 @@ void init(int worker_id){
 	int listSZ;
 	for (listSZ = 0; new_env[listSZ] != NULL; listSZ++) { }
 	//printf("DEBUG: Number of environment variables = %d\n", listSZ);
-	listSZ += 2;	// One more environment variable for the shared memory; One for null termination
+	listSZ += 6;	// Two more environment variables for the shared memory; Three for the optional coverage modes; One for null termination
     printf("Worker %d Allocating environment\n", worker_id);
     char **environment = malloc(listSZ * sizeof(char *));
 
@@ -590,37 +2555,129 @@ void init(int worker_id){
 		fprintf(stderr, "[libJSEngine] Memory allocation failed!\n");
  		exit(-1);
 	}
-	for (int i = 0; i < (listSZ-2); i++) {
+	for (int i = 0; i < (listSZ-6); i++) {
 		if ((environment[i] = dup_str(new_env[i])) == NULL) {
 			fprintf(stderr, "[libJSEngine] Memory allocation failed!\n");
 			exit(-1);
 		}
 	}
 
+	int env_idx = listSZ-6;
 	char shm_key[1024];
-	snprintf(shm_key, 1024, "SHM_ID=/shm_id_%d_%d", getpid(), shm_id);
-	environment[listSZ-2] = dup_str(shm_key);
-	environment[listSZ-1] = NULL;
+	char shm_name[128];
+	coverage_shm_key(shm_name, sizeof(shm_name), "id", shm_id, 0);
+	snprintf(shm_key, 1024, "SHM_ID=%s", shm_name);
+	environment[env_idx++] = dup_str(shm_key);
+	// REPRL_SHM_SIZE overrides the size of the coverage region, see parse_shm_size().
+	char* shm_size = getenv("REPRL_SHM_SIZE");
+	struct cov_context* context = cov_context_of(shm_id);
+	context->shm_size = SHM_SIZE;
+	context->shm_auto_size = 0;
+	if (shm_size != NULL) {
+		uint64_t size = parse_shm_size(shm_size, &context->shm_auto_size);
+		if (size == 0) {
+			return -1;
+		}
+		context->shm_size = size;
+	}
+	snprintf(shm_key, 1024, "SHM_SIZE=%lu", (unsigned long)context->shm_size);
+	environment[env_idx++] = dup_str(shm_key);
+	// REPRL_DIRTY_TRACKING=1 asks the engine to maintain the dirty block map (see struct shmem_dirty_map).
+	char* dirty_tracking = getenv("REPRL_DIRTY_TRACKING");
+	int dirty_tracking_requested = dirty_tracking != NULL && strcmp(dirty_tracking, "1") == 0;
+	if (dirty_tracking_requested) {
+		environment[env_idx++] = dup_str("SHM_DIRTY_TRACKING=1");
+	}
+	// REPRL_HITCOUNTS=1 additionally creates the hit count map (see struct shmem_counters).
+	char* hitcounts = getenv("REPRL_HITCOUNTS");
+	cov_context_of(shm_id)->hitcounts_requested = hitcounts != NULL && strcmp(hitcounts, "1") == 0;
+	if (cov_context_of(shm_id)->hitcounts_requested) {
+		coverage_shm_key(shm_name, sizeof(shm_name), "counters", shm_id, 0);
+		snprintf(shm_key, 1024, "SHM_COUNTERS_ID=%s", shm_name);
+		environment[env_idx++] = dup_str(shm_key);
+	}
+	// REPRL_CMPLOG=1 creates the comparison log (see struct shmem_cmplog).
+	char* cmplog = getenv("REPRL_CMPLOG");
+	cov_context_of(shm_id)->cmplog_requested = cmplog != NULL && strcmp(cmplog, "1") == 0;
+	if (cov_context_of(shm_id)->cmplog_requested) {
+		coverage_shm_key(shm_name, sizeof(shm_name), "cmplog", shm_id, 0);
+		snprintf(shm_key, 1024, "SHM_CMPLOG_ID=%s", shm_name);
+		environment[env_idx++] = dup_str(shm_key);
+	}
+	environment[env_idx] = NULL;
     printf("Worker %d Creating reprl context\n", worker_id);
     struct reprl_context* current_reprl_context = reprl_create_context();
-    reprl_contexts[worker_id] = current_reprl_context;
-    int ret = reprl_initialize_context(current_reprl_context, prog_argv, environment, 1, 1, worker_id);	// capture: stdout=true; stderr=true
+    worker_slot_of(worker_id)->reprl = current_reprl_context;
+    // REPRL_STANDBY=1 keeps a second, already started engine process around that replaces crashed or timed out children.
+    char* standby = getenv("REPRL_STANDBY");
+    current_reprl_context->standby_enabled = standby != NULL && strcmp(standby, "1") == 0;
+    // REPRL_SPAWN_TIMEOUT_MS overrides how long a starting engine may take until it sends its HELO.
+    char* spawn_timeout = getenv("REPRL_SPAWN_TIMEOUT_MS");
+    if (config->spawn_timeout_ms > 0) {
+        reprl_set_spawn_timeout(worker_id, config->spawn_timeout_ms);
+    } else if (spawn_timeout != NULL) {
+        reprl_set_spawn_timeout(worker_id, strtoull(spawn_timeout, NULL, 10));
+    }
+    // REPRL_OUTPUT_CAPACITY limits the fuzzout, stdout and stderr channels to the given number of bytes. Bytecode
+    // collecting workers print much more and keep the default for stdout.
+    char* output_capacity = getenv("REPRL_OUTPUT_CAPACITY");
+    for (int i = 0; i < REPRL_NUM_CHANNELS; i++) {
+        uint64_t capacity = config->channel_capacity[i];
+        if (capacity == 0 && output_capacity != NULL && i != REPRL_CHANNEL_SCRIPT &&
+            !(i == REPRL_CHANNEL_STDOUT && config->print_bytecode)) {
+            capacity = strtoull(output_capacity, NULL, 0);
+        }
+        current_reprl_context->channel_capacity[i] = MIN(capacity, REPRL_MAX_DATA_SIZE);
+    }
+    int ret = reprl_initialize_context(current_reprl_context, prog_argv, environment, config->capture_stdout, config->capture_stderr, worker_id);
 
     if(ret == -1) {
 		fprintf(stderr, "[libJSEngine] reprl_initialize_context() failed!\n");
-		exit(-1);
+		return -1;
 	}
 
     coverage_initialize( shm_id);		// Initialize the coverage map
+    cov_context_of(shm_id)->dirty_tracking_requested = dirty_tracking_requested;
+    // REPRL_SHARED_VIRGIN=1 only reports an edge in the first worker that finds it, see struct shared_virgin_map.
+    char* shared_virgin = getenv("REPRL_SHARED_VIRGIN");
+    cov_context_of(shm_id)->shared_virgin_requested = shared_virgin != NULL && strcmp(shared_virgin, "1") == 0;
     printf("Worker %d Initialized\n", worker_id);
+    return 0;
+}
+
+void init(int worker_id){
+    char *target = getenv("TARGET");
+    char *bin_path = getenv("BIN");
+    char *compiler = getenv("BASELINE");
+
+    if (target == NULL || bin_path == NULL) {
+        fprintf(stderr, "ERROR: TARGET and BIN environment variables must be set\n");
+        exit(1);
+    }
 
+    struct reprl_config config = {
+        .engine = target,
+        .binary = bin_path,
+        .extra_args = NULL,
+        .wasm_baseline = compiler != NULL,
+        // These workers collect bytecode, see BytecodeCollector::analyze_js_bytecode.
+        .print_bytecode = worker_id >= REPRL_BYTECODE_WORKER_BASE,
+        // Only the bytecode workers read the output of every execution.
+        .capture_stdout = worker_id >= REPRL_BYTECODE_WORKER_BASE ? REPRL_CAPTURE_ALWAYS : REPRL_CAPTURE_ON_CRASH,
+        .capture_stderr = REPRL_CAPTURE_ON_CRASH,
+        .spawn_timeout_ms = 0,
+        .channel_capacity = { 0 },
+    };
+    if (reprl_init_with_config(worker_id, &config) != 0) {
+        exit(1);
+    }
 }
 
 static int reprl_spawn_child(struct reprl_context* ctx);
 
 
 void spawn(int worker_id) {
-    struct reprl_context* current_reprl_context = reprl_contexts[worker_id];
+    struct reprl_context* current_reprl_context = reprl_context_of(worker_id);
     int ret = reprl_spawn_child(current_reprl_context);
     fprintf(stderr, "[libJSEngine] Spawning child process...\n");
     if(ret == -1) {
@@ -633,7 +2690,7 @@ void spawn(int worker_id) {
 }
 
 int execute_script(char* arg_script_string, int arg_timeout, int fresh_instance, int worker_id){
-    struct reprl_context* current_reprl_context = reprl_contexts[worker_id];
+    struct reprl_context* current_reprl_context = reprl_context_of(worker_id);
     uint64_t real_execution_time = 0;
     if (arg_script_string == NULL) {
         return -1;
@@ -644,8 +2701,7 @@ int execute_script(char* arg_script_string, int arg_timeout, int fresh_instance,
     // printf("execute_script: worker_id=%d, script='%s', length=%d, timeout=%d\n", 
     //        worker_id, arg_script_string, arg_script_length, arg_timeout);
 
-    arg_timeout = arg_timeout * 1000;
-    return_value = reprl_execute(current_reprl_context, arg_script_string, (int64_t)(arg_script_length), (int64_t)(arg_timeout), &real_execution_time, fresh_instance, worker_id);
+    return_value = reprl_execute(current_reprl_context, arg_script_string, (uint64_t)arg_script_length, (uint64_t)arg_timeout * 1000, &real_execution_time, fresh_instance, worker_id);
 
 
     // Fetch and print stdout
@@ -661,39 +2717,245 @@ int execute_script(char* arg_script_string, int arg_timeout, int fresh_instance,
 
 
 
+// Both control pipes are shared by all forks of the fork server. A child killed right after it reported its status
+// may leave that status in one of them, one killed before it read its command leaves the command in the other, and
+// the next child would otherwise take it for its own. Must only be called while no child is running.
+static void reprl_drain_control_pipes(struct reprl_context* ctx)
+{
+    int pipes[2] = { ctx->ctrl_in, ctx->ctrl_out_reader };
+    for (int i = 0; i < 2; i++) {
+        char stale[64];
+        int flags = fcntl(pipes[i], F_GETFL);
+        fcntl(pipes[i], F_SETFL, flags | O_NONBLOCK);
+        while (read(pipes[i], stale, sizeof(stale)) > 0) { }
+        fcntl(pipes[i], F_SETFL, flags);
+    }
+}
+
+// Asks the fork server for a new child. The child inherits the initialized engine state and the finished
+// handshake, so it directly waits for the next command on the control pipe.
+static int reprl_fork_from_server(struct reprl_context* ctx)
+{
+    int pid = 0;
+    if (write(ctx->fsrv_out, "fork", 4) != 4 || reprl_read_with_deadline(ctx->fsrv_in, &pid, 4, reprl_spawn_deadline(ctx)) != 0 || pid <= 0) {
+        reprl_terminate_server(ctx);
+        return reprl_error(ctx, "Fork server did not provide a new child");
+    }
+    ctx->pid = pid;
+    return 0;
+}
+
+// The spawn statistics are only written by the thread that owns the worker but read by others through
+// reprl_get_spawn_stats(), so like the phase histograms every field is accessed atomically.
+static inline void spawn_stat_add(uint64_t* counter, uint64_t value)
+{
+    __atomic_store_n(counter, *counter + value, __ATOMIC_RELAXED);
+}
+
+static int reprl_start_child(struct reprl_context* ctx);
+static int reprl_handshake(struct reprl_context* ctx);
+static void reprl_close_fork_server_pipes(struct reprl_context* ctx);
+
+// Exchanges the active child (pid and its pipes) with the one in the standby slot.
+static void reprl_swap_standby(struct reprl_context* ctx)
+{
+    int tmp;
+    tmp = ctx->pid; ctx->pid = ctx->standby_pid; ctx->standby_pid = tmp;
+    tmp = ctx->ctrl_in; ctx->ctrl_in = ctx->standby_ctrl_in; ctx->standby_ctrl_in = tmp;
+    tmp = ctx->ctrl_out; ctx->ctrl_out = ctx->standby_ctrl_out; ctx->standby_ctrl_out = tmp;
+    tmp = ctx->fsrv_in; ctx->fsrv_in = ctx->standby_fsrv_in; ctx->standby_fsrv_in = tmp;
+    tmp = ctx->fsrv_out; ctx->fsrv_out = ctx->standby_fsrv_out; ctx->standby_fsrv_out = tmp;
+    tmp = ctx->ctrl_out_reader; ctx->ctrl_out_reader = ctx->standby_ctrl_out_reader; ctx->standby_ctrl_out_reader = tmp;
+    struct data_channel* channel;
+    channel = ctx->stdout; ctx->stdout = ctx->standby_stdout; ctx->standby_stdout = channel;
+    channel = ctx->stderr; ctx->stderr = ctx->standby_stderr; ctx->standby_stderr = channel;
+    char** envp = ctx->envp; ctx->envp = ctx->standby_envp; ctx->standby_envp = envp;
+}
+
+// Environment of the standby child: the one of the active child, but with the shared memory objects of the standby.
+static char** reprl_standby_environment(struct reprl_context* ctx)
+{
+    struct cov_context* context = cov_context_of(ctx->worker_id);
+    const char* names[] = { "SHM_ID=", "SHM_COUNTERS_ID=", "SHM_CMPLOG_ID=" };
+    const char* kinds[] = { "id", "counters", "cmplog" };
+    int count = 0;
+    while (ctx->envp[count] != NULL) count++;
+    char** envp = calloc(count + 1, sizeof(char*));
+    if (envp == NULL) return NULL;
+    for (int i = 0; i < count; i++) {
+        for (int k = 0; k < 3 && envp[i] == NULL; k++) {
+            if (strncmp(ctx->envp[i], names[k], strlen(names[k])) == 0) {
+                char shm_name[128];
+                char assignment[160];
+                coverage_shm_key(shm_name, sizeof(shm_name), kinds[k], context->id, !context->standby_swapped);
+                snprintf(assignment, sizeof(assignment), "%s%s", names[k], shm_name);
+                envp[i] = dup_str(assignment);
+            }
+        }
+        if (envp[i] == NULL) envp[i] = dup_str(ctx->envp[i]);
+    }
+    return envp;
+}
+
+// Starts a new engine process in the standby slot. Only fork and execve happen here, the engine initializes
+// in the background and its HELO is answered once the standby is promoted.
+static void reprl_start_standby(struct reprl_context* ctx)
+{
+    if (!ctx->standby_enabled || ctx->standby_pid || ctx->server_pid) {
+        return;
+    }
+    if (ctx->standby_envp == NULL && (ctx->standby_envp = reprl_standby_environment(ctx)) == NULL) {
+        return;
+    }
+    if (coverage_initialize_standby(cov_context_of(ctx->worker_id)) != 0) {
+        return;
+    }
+    reprl_swap_standby(ctx);
+    // Output channels of its own, for the streams the active child writes into a channel.
+    if (ctx->standby_stdout && !ctx->stdout) {
+        ctx->stdout = reprl_create_output_channel(ctx, ctx->worker_id, REPRL_CHANNEL_STDOUT);
+    }
+    if (ctx->standby_stderr && !ctx->stderr) {
+        ctx->stderr = reprl_create_output_channel(ctx, ctx->worker_id, REPRL_CHANNEL_STDERR);
+    }
+    if ((ctx->standby_stdout && !ctx->stdout) || (ctx->standby_stderr && !ctx->stderr) || reprl_start_child(ctx) != 0) {
+        ctx->pid = 0;
+    }
+    reprl_swap_standby(ctx);
+}
+
+// Fills the standby slot once the active child delivered a result, so that the fork and execve of the next
+// standby neither delay the respawn it replaces nor the first execution of the new child.
+static void reprl_refill_standby(struct reprl_context* ctx)
+{
+    if (!ctx->standby_refill || !ctx->pid) {
+        return;
+    }
+    ctx->standby_refill = 0;
+    uint64_t start_time = current_usecs();
+    reprl_start_standby(ctx);
+    if (ctx->standby_pid) {
+        spawn_stat_add(&ctx->spawn_stats.standby_refills, 1);
+        spawn_stat_add(&ctx->spawn_stats.refill_us, current_usecs() - start_time);
+    }
+}
+
+static void reprl_terminate_standby(struct reprl_context* ctx)
+{
+    if (!ctx->standby_pid) return;
+    reprl_swap_standby(ctx);
+    reprl_terminate_child(ctx);
+    reprl_close_fork_server_pipes(ctx);
+    reprl_swap_standby(ctx);
+}
+
+static int reprl_launch_child(struct reprl_context* ctx)
+{
+    if (ctx->server_pid) {
+        reprl_drain_control_pipes(ctx);
+        if (reprl_fork_from_server(ctx) == 0) {
+            spawn_stat_add(&ctx->spawn_stats.forks, 1);
+            return 0;
+        }
+        // The fork server is gone, start over with a new engine process.
+    }
+
+    if (ctx->standby_pid) {
+        // Promote the standby. It had plenty of time to initialize, so its HELO is usually already waiting.
+        // Its coverage regions go along with its environment, even if it turns out to be dead.
+        reprl_swap_standby(ctx);
+        coverage_promote_standby(cov_context_of(ctx->worker_id));
+        // What it printed during startup is not part of the next execution, whose output channels were reset already.
+        struct data_channel* outputs[2] = { ctx->stdout, ctx->stderr };
+        for (int i = 0; i < 2; i++) {
+            if (outputs[i]) {
+                reprl_trim_output_channel(outputs[i]);
+                lseek(outputs[i]->fd, 0, SEEK_SET);
+            }
+        }
+        if (reprl_handshake(ctx) == 0) {
+            spawn_stat_add(&ctx->spawn_stats.standby_promotions, 1);
+            ctx->standby_refill = ctx->standby_enabled;
+            return 0;
+        }
+        // The standby died during startup, fall back to a synchronous spawn.
+    }
+
+    int ret = reprl_start_child(ctx);
+    if (ret != 0) return ret;
+
+    // No fixed sleep here, reprl_handshake() waits (up to spawn_timeout) until the engine is ready.
+    ret = reprl_handshake(ctx);
+    if (ret != 0) return ret;
+    ctx->standby_refill = ctx->standby_enabled;
+    return 0;
+}
+
+// Starts a new child (or forks one from the fork server, or promotes the standby) and records how long that took.
 static int reprl_spawn_child(struct reprl_context* ctx)
 {
-	int ret = 0;
-#ifdef __linux__
-    // This is also a good time to ensure the data channel backing files don't grow too large.
-    // On Linux with memfd, we can always ftruncate
-    ret = ftruncate(ctx->data_in->fd, REPRL_MAX_DATA_SIZE);
-	if(ret != 0) { fprintf(stderr, "ftruncate(data_in->fd=%d, size=%d) failed: %s\n", ctx->data_in->fd, REPRL_MAX_DATA_SIZE, strerror(errno)); return -1;}
-    ret = ftruncate(ctx->data_out->fd, REPRL_MAX_DATA_SIZE);
-	if(ret != 0) { fprintf(stderr, "ftruncate(data_out->fd=%d, size=%d) failed: %s\n", ctx->data_out->fd, REPRL_MAX_DATA_SIZE, strerror(errno)); return -1;}
-    if (ctx->stdout) {
-		ret = ftruncate(ctx->stdout->fd, REPRL_MAX_DATA_SIZE);
-		if(ret != 0) { fprintf(stderr, "ftruncate(stdout->fd=%d, size=%d) failed: %s\n", ctx->stdout->fd, REPRL_MAX_DATA_SIZE, strerror(errno)); return -1;}
-	}
-    if (ctx->stderr) {
-		ret = ftruncate(ctx->stderr->fd, REPRL_MAX_DATA_SIZE);
-		if(ret != 0) { fprintf(stderr, "ftruncate(stderr->fd=%d, size=%d) failed: %s\n", ctx->stderr->fd, REPRL_MAX_DATA_SIZE, strerror(errno)); return -1;}
-	}
-#else
-    // On macOS, after shm_unlink the fds become anonymous and ftruncate may fail
-    // We already sized them correctly in reprl_create_data_channel, so just reset the file position
-    lseek(ctx->data_in->fd, 0, SEEK_SET);
-    lseek(ctx->data_out->fd, 0, SEEK_SET);
-    if (ctx->stdout) {
-        lseek(ctx->stdout->fd, 0, SEEK_SET);
+    if (ctx == NULL) {
+        return -1;
     }
-    if (ctx->stderr) {
-        lseek(ctx->stderr->fd, 0, SEEK_SET);
+    uint64_t start_time = current_usecs();
+    int ret = reprl_launch_child(ctx);
+    uint64_t latency = current_usecs() - start_time;
+    if (ret != 0) {
+        spawn_stat_add(&ctx->spawn_stats.failures, 1);
+        return ret;
+    }
+    spawn_stat_add(&ctx->spawn_stats.spawns, 1);
+    spawn_stat_add(&ctx->spawn_stats.total_us, latency);
+    __atomic_store_n(&ctx->spawn_stats.last_us, latency, __ATOMIC_RELAXED);
+    if (latency > ctx->spawn_stats.max_us) {
+        __atomic_store_n(&ctx->spawn_stats.max_us, latency, __ATOMIC_RELAXED);
+    }
+    return 0;
+}
+
+// Reads exactly len bytes from fd, but gives up once the deadline (in the clock of current_usecs) has passed.
+// Returns 0 on success and -1 if the deadline passed, the other end was closed or an error occurred.
+static int reprl_read_with_deadline(int fd, void* buf, size_t len, uint64_t deadline)
+{
+    size_t done = 0;
+    while (done < len) {
+        uint64_t now = current_usecs();
+        if (now >= deadline) {
+            errno = ETIMEDOUT;
+            return -1;
+        }
+        struct pollfd fds = {.fd = fd, .events = POLLIN, .revents = 0};
+        int res = poll(&fds, 1, (int)((deadline - now + 999) / 1000));
+        if (res < 0 && errno == EINTR) continue;
+        if (res < 0) return -1;
+        if (res == 0) continue;
+        ssize_t n = read(fd, (char*)buf + done, len - done);
+        if (n <= 0) {
+            if (n == 0) errno = EPIPE;
+            return -1;
+        }
+        done += n;
+    }
+    return 0;
+}
+
+// Creates the pipes for a new engine process and starts it. The handshake is done separately by reprl_handshake().
+static int reprl_start_child(struct reprl_context* ctx)
+{
+    // This is also a good time to ensure the data channel backing files didn't grow too large.
+    // The files themselves are sized once in reprl_create_data_channel and stay sparse.
+    struct data_channel* channels[REPRL_NUM_CHANNELS] = { ctx->data_out, ctx->data_in, ctx->stdout, ctx->stderr };
+    for (int i = 0; i < REPRL_NUM_CHANNELS; i++) {
+        if (channels[i] && reprl_clamp_data_channel(channels[i]) != 0) {
+            fprintf(stderr, "ftruncate(fd=%d, size=%lu) failed: %s\n", channels[i]->fd, (unsigned long)channels[i]->capacity, strerror(errno));
+            return -1;
+        }
     }
-#endif
 
     int crpipe[2] = { 0, 0 };          // control pipe child -> reprl
     int cwpipe[2] = { 0, 0 };          // control pipe reprl -> child
+    int srpipe[2] = { 0, 0 };          // fork server pipe child -> reprl
+    int swpipe[2] = { 0, 0 };          // fork server pipe reprl -> child
 
     if (pipe(crpipe) != 0) {
         return reprl_error(ctx, "Could not create pipe for REPRL communication: %s", strerror(errno));
@@ -703,11 +2965,29 @@ static int reprl_spawn_child(struct reprl_context* ctx)
         close(crpipe[1]);
         return reprl_error(ctx, "Could not create pipe for REPRL communication: %s", strerror(errno));
     }
+    if (pipe(srpipe) != 0 || pipe(swpipe) != 0) {
+        close(crpipe[0]);
+        close(crpipe[1]);
+        close(cwpipe[0]);
+        close(cwpipe[1]);
+        if (srpipe[0]) {
+            close(srpipe[0]);
+            close(srpipe[1]);
+        }
+        return reprl_error(ctx, "Could not create pipe for REPRL communication: %s", strerror(errno));
+    }
 
     ctx->ctrl_in = crpipe[0];
     ctx->ctrl_out = cwpipe[1];
+    ctx->fsrv_in = srpipe[0];
+    ctx->fsrv_out = swpipe[1];
     fcntl(ctx->ctrl_in, F_SETFD, FD_CLOEXEC);
     fcntl(ctx->ctrl_out, F_SETFD, FD_CLOEXEC);
+    fcntl(ctx->fsrv_in, F_SETFD, FD_CLOEXEC);
+    fcntl(ctx->fsrv_out, F_SETFD, FD_CLOEXEC);
+    // Our copy of the child's end of the control pipe, see reprl_fork_from_server().
+    ctx->ctrl_out_reader = cwpipe[0];
+    fcntl(ctx->ctrl_out_reader, F_SETFD, FD_CLOEXEC);
 
     int pid = fork();
     if (pid == 0) {
@@ -720,22 +3000,26 @@ static int reprl_spawn_child(struct reprl_context* ctx)
         if (dup2(cwpipe[0], REPRL_CHILD_CTRL_IN) < 0 ||
             dup2(crpipe[1], REPRL_CHILD_CTRL_OUT) < 0 ||
             dup2(ctx->data_out->fd, REPRL_CHILD_DATA_IN) < 0 ||
-            dup2(ctx->data_in->fd, REPRL_CHILD_DATA_OUT) < 0) {
+            dup2(ctx->data_in->fd, REPRL_CHILD_DATA_OUT) < 0 ||
+            dup2(swpipe[0], REPRL_CHILD_FORKSRV_IN) < 0 ||
+            dup2(srpipe[1], REPRL_CHILD_FORKSRV_OUT) < 0) {
             fprintf(stderr, "dup2 failed in the child: %s\n", strerror(errno));
             _exit(-1);
         }
 
         close(cwpipe[0]);
         close(crpipe[1]);
+        close(swpipe[0]);
+        close(srpipe[1]);
 
         int devnull = open("/dev/null", O_RDWR);
         dup2(devnull, 0);
 
 		// The following lines can be commented out to see the stdout/stderr of the JS engine in the main console (for debugging)
         if ( getenv("DOUTPUT") == NULL) {
-            if (ctx->stdout) dup2(ctx->stdout->fd, 1);
+            if (reprl_output_connected(ctx, ctx->stdout, ctx->stdout_policy)) dup2(ctx->stdout->fd, 1);
             else dup2(devnull, 1);
-            if (ctx->stderr) dup2(ctx->stderr->fd, 2);
+            if (reprl_output_connected(ctx, ctx->stderr, ctx->stderr_policy)) dup2(ctx->stderr->fd, 2);
             else dup2(devnull, 2);
         }
         close(devnull);
@@ -750,7 +3034,8 @@ static int reprl_spawn_child(struct reprl_context* ctx)
         // close all other FDs. We try to use FD_CLOEXEC everywhere, but let's be extra sure we don't leak any fds to the child.
         int tablesize = getdtablesize();
         for (int i = 3; i < tablesize; i++) {
-            if (i == REPRL_CHILD_CTRL_IN || i == REPRL_CHILD_CTRL_OUT || i == REPRL_CHILD_DATA_IN || i == REPRL_CHILD_DATA_OUT) {
+            if (i == REPRL_CHILD_CTRL_IN || i == REPRL_CHILD_CTRL_OUT || i == REPRL_CHILD_DATA_IN || i == REPRL_CHILD_DATA_OUT ||
+                i == REPRL_CHILD_FORKSRV_IN || i == REPRL_CHILD_FORKSRV_OUT) {
                 continue;
             }
             close(i);
@@ -763,27 +3048,76 @@ static int reprl_spawn_child(struct reprl_context* ctx)
     }
 
     close(crpipe[1]);
-    close(cwpipe[0]);
+    close(srpipe[1]);
+    close(swpipe[0]);
 
     if (pid < 0) {
         close(ctx->ctrl_in);
         close(ctx->ctrl_out);
+        close(ctx->fsrv_in);
+        close(ctx->fsrv_out);
+        close(ctx->ctrl_out_reader);
+        ctx->ctrl_out_reader = -1;
         return reprl_error(ctx, "Failed to fork: %s", strerror(errno));
     }
     ctx->pid = pid;
-    
-    // Give the child a moment to initialize
-    usleep(10000); // 10ms
-    
+    return 0;
+}
+
+// The fork server pipes are only needed if the child turns into a fork server during the handshake. The same goes
+// for ctrl_out_reader, which would otherwise keep writes to the control pipe of a dead child from failing.
+static void reprl_close_fork_server_pipes(struct reprl_context* ctx)
+{
+    if (ctx->fsrv_in >= 0) close(ctx->fsrv_in);
+    if (ctx->fsrv_out >= 0) close(ctx->fsrv_out);
+    if (ctx->ctrl_out_reader >= 0) close(ctx->ctrl_out_reader);
+    ctx->fsrv_in = ctx->fsrv_out = ctx->ctrl_out_reader = -1;
+}
+
+static int reprl_exchange_helo(struct reprl_context* ctx);
+
+static int reprl_handshake(struct reprl_context* ctx)
+{
+    int ret = reprl_exchange_helo(ctx);
+    if (ret != 0 && !ctx->server_pid) {
+        reprl_close_fork_server_pipes(ctx);
+    }
+    return ret;
+}
+
+static int reprl_exchange_helo(struct reprl_context* ctx)
+{
     char helo[5] = { 0 };
+    uint64_t deadline = reprl_spawn_deadline(ctx);
     // fprintf(stderr, "Parent: Waiting for HELO from child on fd %d\n", ctx->ctrl_in);
-    ssize_t n = read(ctx->ctrl_in, helo, 4);
-    if (n != 4) {
+    if (reprl_read_with_deadline(ctx->ctrl_in, helo, 4, deadline) != 0) {
         // fprintf(stderr, "Parent: Failed to read HELO, got %zd bytes: %s\n", n, strerror(errno));
         reprl_terminate_child(ctx);
         return reprl_error(ctx, "Did not receive HELO message from child: %s", strerror(errno));
     }
     // fprintf(stderr, "Parent: Received: %c%c%c%c\n", helo[0], helo[1], helo[2], helo[3]);
+    ctx->capabilities = 0;
+    if (strncmp(helo, "HELX", 4) == 0) {
+        // Extended handshake, the child offers a set of protocol extensions and we reply with the ones we accept.
+        uint32_t offered = 0;
+        if (reprl_read_with_deadline(ctx->ctrl_in, &offered, 4, deadline) != 0) {
+            reprl_terminate_child(ctx);
+            return reprl_error(ctx, "Did not receive capabilities from child: %s", strerror(errno));
+        }
+        ctx->capabilities = offered & REPRL_SUPPORTED_CAPABILITIES;
+        if (write(ctx->ctrl_out, helo, 4) != 4 || write(ctx->ctrl_out, &ctx->capabilities, 4) != 4) {
+            reprl_terminate_child(ctx);
+            return reprl_error(ctx, "Failed to send HELX reply message to child: %s", strerror(errno));
+        }
+        if (ctx->capabilities & REPRL_CAP_FORKSERVER) {
+            // The process we just started stays warm as fork server, the scripts run in its forks.
+            ctx->server_pid = ctx->pid;
+            ctx->pid = 0;
+            return reprl_fork_from_server(ctx);
+        }
+        reprl_close_fork_server_pipes(ctx);
+        return 0;
+    }
     if (strncmp(helo, "HELO", 4) != 0) {
         reprl_terminate_child(ctx);
         return reprl_error(ctx, "Received invalid HELO message from child: %s", helo);
@@ -794,6 +3128,7 @@ static int reprl_spawn_child(struct reprl_context* ctx)
         reprl_terminate_child(ctx);
         return reprl_error(ctx, "Failed to send HELO reply message to child: %s", strerror(errno));
     }
+    reprl_close_fork_server_pipes(ctx);
     // fprintf(stderr, "Parent: HELO handshake complete\n");
 
     return 0;
@@ -818,6 +3153,8 @@ struct reprl_context* reprl_create_context()
             dup2(devnull, REPRL_CHILD_CTRL_OUT);
             dup2(devnull, REPRL_CHILD_DATA_IN);
             dup2(devnull, REPRL_CHILD_DATA_OUT);
+            dup2(devnull, REPRL_CHILD_FORKSRV_IN);
+            dup2(devnull, REPRL_CHILD_FORKSRV_OUT);
             close(devnull);
         }
     }
@@ -836,18 +3173,30 @@ int reprl_initialize_context(struct reprl_context* ctx, char** argv, char** envp
 
 	ctx->argv = argv;
 	ctx->envp = envp;
+	struct worker_slot* slot = worker_slot_of(worker_id);
+	if (slot == NULL) {
+		return reprl_error(ctx, "Invalid worker id %d", worker_id);
+	}
+	ctx->worker_id = worker_id;
+	ctx->phases = slot->phases;
     //ctx->argv = copy_string_array(argv);
     //ctx->envp = copy_string_array(envp);
 
-    ctx->data_in = reprl_create_data_channel(ctx, worker_id);
-    ctx->data_out = reprl_create_data_channel(ctx, worker_id);
-    if (capture_stdout) {
-        ctx->stdout = reprl_create_data_channel(ctx, worker_id);
+    // Scripts are written directly into the mapping (see reprl_get_script_buffer()), so it has to be complete and fixed.
+    uint64_t script_capacity = ctx->channel_capacity[REPRL_CHANNEL_SCRIPT] ? ctx->channel_capacity[REPRL_CHANNEL_SCRIPT] : REPRL_MAX_DATA_SIZE;
+    ctx->data_out = reprl_create_data_channel(ctx, worker_id, script_capacity, 1);
+    ctx->data_in = reprl_create_output_channel(ctx, worker_id, REPRL_CHANNEL_FUZZOUT);
+    // Channels of REPRL_CAPTURE_ON_CRASH streams are created on the first reprl_capture_next_execution().
+    ctx->stdout_policy = capture_stdout;
+    ctx->stderr_policy = capture_stderr;
+    if (capture_stdout == REPRL_CAPTURE_ALWAYS) {
+        ctx->stdout = reprl_create_output_channel(ctx, worker_id, REPRL_CHANNEL_STDOUT);
     }
-    if (capture_stderr) {
-        ctx->stderr = reprl_create_data_channel(ctx, worker_id);
+    if (capture_stderr == REPRL_CAPTURE_ALWAYS) {
+        ctx->stderr = reprl_create_output_channel(ctx, worker_id, REPRL_CHANNEL_STDERR);
     }
-    if (!ctx->data_in || !ctx->data_out || (capture_stdout && !ctx->stdout) || (capture_stderr && !ctx->stderr)) {
+    if (!ctx->data_in || !ctx->data_out || (capture_stdout == REPRL_CAPTURE_ALWAYS && !ctx->stdout) ||
+        (capture_stderr == REPRL_CAPTURE_ALWAYS && !ctx->stderr)) {
         // Proper error message will have been set by reprl_create_data_channel
         return -1;
     }
@@ -858,67 +3207,287 @@ int reprl_initialize_context(struct reprl_context* ctx, char** argv, char** envp
 
 
 
+static int reprl_restart_with_env(int worker_id, const char* assignment)
+{
+    struct reprl_context* ctx = reprl_context_of(worker_id);
+    if (ctx == NULL) {
+        return -1;
+    }
+    // Every process that is already running (or forks from a running one) still uses the old environment.
+    reprl_terminate_child(ctx);
+    reprl_terminate_server(ctx);
+    reprl_terminate_standby(ctx);
+
+    size_t name_len = strchr(assignment, '=') - assignment + 1;
+    int found = -1;
+    char** environments[2] = { ctx->envp, ctx->standby_envp };
+    for (int i = 0; i < 2 && environments[i] != NULL; i++) {
+        for (char** entry = environments[i]; *entry != NULL; entry++) {
+            if (strncmp(*entry, assignment, name_len) == 0) {
+                free(*entry);
+                *entry = dup_str(assignment);
+                found = 0;
+                break;
+            }
+        }
+    }
+    return found;
+}
+
 void reprl_destroy_context(int worker_id)
 {
-    struct reprl_context* current_reprl_context = reprl_contexts[worker_id];
+    struct reprl_context* current_reprl_context = reprl_context_of(worker_id);
+    if (current_reprl_context == NULL) {
+        return;
+    }
     reprl_terminate_child(current_reprl_context);
+    reprl_terminate_server(current_reprl_context);
+    reprl_terminate_standby(current_reprl_context);
 
     //free_string_array(ctx->argv);
     //free_string_array(ctx->envp);
 
-    reprl_destroy_data_channel(current_reprl_context, current_reprl_context->data_in);
-    reprl_destroy_data_channel(current_reprl_context, current_reprl_context->data_out);
-    reprl_destroy_data_channel(current_reprl_context, current_reprl_context->stdout);
-    reprl_destroy_data_channel(current_reprl_context, current_reprl_context->stderr);
+    reprl_destroy_data_channel(current_reprl_context, current_reprl_context->data_in);
+    reprl_destroy_data_channel(current_reprl_context, current_reprl_context->data_out);
+    reprl_destroy_data_channel(current_reprl_context, current_reprl_context->stdout);
+    reprl_destroy_data_channel(current_reprl_context, current_reprl_context->stderr);
+    reprl_destroy_data_channel(current_reprl_context, current_reprl_context->standby_stdout);
+    reprl_destroy_data_channel(current_reprl_context, current_reprl_context->standby_stderr);
+
+    free(current_reprl_context->last_error);
+    free(current_reprl_context);
+}
+
+
+// Resets the data channels and spawns a new child if there is none. Shared by all execute variants.
+static int reprl_prepare_execution(struct reprl_context* ctx, int worker_id)
+{
+    // The output of the previous execution has been consumed at this point.
+    reprl_trim_output_channel(ctx->data_in);
+    if (reprl_output_connected(ctx, ctx->stdout, ctx->stdout_policy)) {
+        reprl_trim_output_channel(ctx->stdout);
+    }
+    if (reprl_output_connected(ctx, ctx->stderr, ctx->stderr_policy)) {
+        reprl_trim_output_channel(ctx->stderr);
+    }
+
+    // Connecting or disconnecting the output of REPRL_CAPTURE_ON_CRASH streams needs new processes, since the fork
+    // server and the standby child inherited the old stdout and stderr.
+    if (ctx->capture_armed != ctx->capture_attached) {
+        if (ctx->capture_armed) {
+            if (ctx->stdout_policy == REPRL_CAPTURE_ON_CRASH && !ctx->stdout) {
+                ctx->stdout = reprl_create_output_channel(ctx, worker_id, REPRL_CHANNEL_STDOUT);
+            }
+            if (ctx->stderr_policy == REPRL_CAPTURE_ON_CRASH && !ctx->stderr) {
+                ctx->stderr = reprl_create_output_channel(ctx, worker_id, REPRL_CHANNEL_STDERR);
+            }
+        }
+        reprl_terminate_child(ctx);
+        reprl_terminate_server(ctx);
+        reprl_terminate_standby(ctx);
+        ctx->capture_attached = ctx->capture_armed;
+    }
+    ctx->capture_armed = 0;
+
+    // Reset file position so the child can simply read(2) and write(2) to these fds.
+    lseek(ctx->data_out->fd, 0, SEEK_SET);
+    lseek(ctx->data_in->fd, 0, SEEK_SET);
+    if (reprl_output_connected(ctx, ctx->stdout, ctx->stdout_policy)) {
+        lseek(ctx->stdout->fd, 0, SEEK_SET);
+    }
+    if (reprl_output_connected(ctx, ctx->stderr, ctx->stderr_policy)) {
+        lseek(ctx->stderr->fd, 0, SEEK_SET);
+    }
+
+    // Spawn a new instance if necessary.
+    if (!ctx->pid) {
+        uint64_t phase_start = current_nsecs();
+        int r = reprl_spawn_child(ctx);
+        record_phase(ctx->phases, REPRL_PHASE_RESPAWN, phase_start);
+        if (r != 0) return r;
+        // The new child may have touched the bitmap during startup.
+        cov_context_of(worker_id)->map_clean = 0;
+        cov_context_of(worker_id)->counters_clean = 0;
+    }
+    return 0;
+}
+
+static void reprl_prepare_coverage(int worker_id)
+{
+    // Note:
+    // I think resetting the current coverage map (in shared memory) here is not required because
+    // the code in d8 should already reset it. However, I detected some flaws (especially when the global coverage map
+    // was restored. I therefore added also the call here to just get 100% sure
+    // If I later start to boost performance I can maybe remove this code again
+    // (since this code will be executed in every iteration)
+    // TODO: Check this
+    // The clear is skipped if the result of the previous execution was consumed by cov_evaluate_and_reset().
+    // The same holds for the hit count map and cov_evaluate_counts().
+    uint64_t phase_start = current_nsecs();
+    struct worker_slot* slot = worker_slot_of(worker_id);
+    struct cov_context* cov = &slot->cov;
+    if (!cov->map_clean) {
+        clear_edge_bitmap(cov);
+    }
+    if (cov->hitcounts && !cov->counters_clean) {
+        memset(cov->counters->counters, 0, cov->counts_size);
+    }
+    cov->map_clean = 0;
+    cov->counters_clean = 0;
+    record_phase(slot->phases, REPRL_PHASE_CLEAR, phase_start);
+}
+
+// Converts the wait status of a terminated child into a REPRL exit status.
+static int reprl_decode_wait_status(struct reprl_context* ctx, int status)
+{
+    if (WIFEXITED(status)) {
+        return (WEXITSTATUS(status) << 8) & 0xffff;
+    } else if (WIFSIGNALED(status)) {
+        return WTERMSIG(status) & 0xffff;
+    }
+    // This shouldn't happen, since we don't specify WUNTRACED for waitpid...
+    return reprl_error(ctx, "Waitpid returned unexpected child state %i", status);
+}
+
+// Waits until the child reports the status of the script it is currently executing, it crashes, or the timeout
+// (in microseconds) expires. In the latter two cases the child is gone afterwards (ctx->pid is zero).
+static int reprl_read_status(struct reprl_context* ctx, struct pollfd* fds, uint64_t start_time, uint64_t timeout);
+
+// Reaps the child once it exited, waiting at most until deadline. Returns whether it was reaped.
+// Uses a pidfd where available, so that waiting for the exit doesn't spin.
+static int reprl_wait_for_exit(struct reprl_context* ctx, int* status, uint64_t deadline)
+{
+    if (waitpid(ctx->pid, status, WNOHANG) == ctx->pid) {
+        return 1;
+    }
+#if defined(__linux__) && defined(SYS_pidfd_open)
+    int pidfd = syscall(SYS_pidfd_open, ctx->pid, 0);
+    if (pidfd >= 0) {
+        uint64_t now = current_usecs();
+        struct pollfd fds = {.fd = pidfd, .events = POLLIN, .revents = 0};
+        int res = poll_usecs(&fds, 1, deadline > now ? deadline - now : 0);
+        close(pidfd);
+        return res > 0 && waitpid(ctx->pid, status, WNOHANG) == ctx->pid;
+    }
+#endif
+    // Kernels without pidfds: retry waitpid() a few times...
+    int success = 0;
+    do {
+        success = waitpid(ctx->pid, status, WNOHANG) == ctx->pid;
+        if (!success) usleep(10);
+    } while (!success && current_usecs() < deadline);
+    return success;
+}
+
+static int reprl_wait_for_status(struct reprl_context* ctx, uint64_t timeout, uint64_t* execution_time)
+{
+    uint64_t start_time = current_usecs();
+    uint64_t phase_start = current_nsecs();
+    // With a fork server, the control pipe never reaches EOF because the server holds it open as well.
+    // Instead, the server reports the wait status of the child once it terminated.
+    struct pollfd fds[2] = {
+        {.fd = ctx->ctrl_in, .events = POLLIN, .revents = 0},
+        {.fd = ctx->server_pid ? ctx->fsrv_in : -1, .events = POLLIN, .revents = 0},
+    };
+    int res = poll_usecs(fds, 2, timeout);
+    *execution_time = current_usecs() - start_time;
+    ctx->last_execution_time = *execution_time;
+    phase_start = record_phase(ctx->phases, REPRL_PHASE_RUN, phase_start);
+    if (res == 0) {
+        // Execution timed out. Kill child and return a timeout status.
+        reprl_terminate_child(ctx);
+        return 1 << 16;
+    } else if (res < 0) {
+        // An error occurred.
+        // We expect all signal handlers to be installed with SA_RESTART, so receiving EINTR here is unexpected and thus also an error.
+        return reprl_error(ctx, "Failed to poll: %s", strerror(errno));
+    }
+
+    int status = reprl_read_status(ctx, fds, start_time, timeout);
+    record_phase(ctx->phases, REPRL_PHASE_STATUS, phase_start);
+    return status;
+}
+
+// Reads the status of an execution once poll() reported one of fds (control pipe and fork server pipe) as ready.
+static int reprl_read_status(struct reprl_context* ctx, struct pollfd* fds, uint64_t start_time, uint64_t timeout)
+{
+    int status;
+    if (!(fds[0].revents & POLLIN) && fds[1].revents) {
+        if (reprl_read_with_deadline(ctx->fsrv_in, &status, 4, reprl_spawn_deadline(ctx)) != 0) {
+            reprl_terminate_server(ctx);
+            return reprl_error(ctx, "Lost connection to the fork server");
+        }
+        reprl_child_terminated(ctx);
+        return reprl_decode_wait_status(ctx, status);
+    }
+
+    // Poll succeeded, so there must be something to read now (either the status or EOF).
+    ssize_t rv = read(ctx->ctrl_in, &status, 4);
+    // printf("Read status: in worker %d: %d -> return status: %d\n", worker_id, status, rv);
+    if (rv < 0) {
+        return reprl_error(ctx, "Failed to read from control pipe: %s", strerror(errno));
+    } else if (rv != 4) {
+        // Most likely, the child process crashed and closed the write end of the control pipe.
+        // Unfortunately, there probably is nothing that guarantees that waitpid() will immediately succeed now,
+        // and we also don't want to block here. So wait for the exit until the timeout.
+        int success = reprl_wait_for_exit(ctx, &status, start_time + timeout);
+
+        if (!success) {
+            // Wait failed, so something weird must have happened. Maybe somehow the control pipe was closed without the child exiting?
+            // Probably the best we can do is kill the child and return an error.
+            reprl_terminate_child(ctx);
+            return reprl_error(ctx, "Child in weird state after execution");
+        }
+
+        // Cleanup any state related to this child process.
+        reprl_child_terminated(ctx);
+
+        return reprl_decode_wait_status(ctx, status);
+    }
 
-    free(current_reprl_context->last_error);
-    free(current_reprl_context);
-}
+    // The status must be a positive number, see the status encoding format below.
+    // We also don't allow the child process to indicate a timeout. If we wanted,
+    // we could treat it as an error if the upper bits are set.
+    status &= 0xffff;
 
+    return status;
+}
 
-int reprl_execute(struct reprl_context* ctx, const char* script, uint64_t script_length, uint64_t timeout, uint64_t* execution_time, int fresh_instance, int worker_id)
+// Hands a script to the child, spawning one if necessary, and returns once the "cexe" command was sent.
+static int reprl_submit(struct reprl_context* ctx, const char* script, uint64_t script_length, int fresh_instance, int worker_id)
 {
-    if (!ctx->initialized) {
+    if (ctx == NULL || !ctx->initialized) {
         return reprl_error(ctx, "REPRL context is not initialized");
     }
-    if (script_length > REPRL_MAX_DATA_SIZE) {
+    if (script_length > ctx->data_out->capacity) {
         return reprl_error(ctx, "Script too large");
     }
 
+    // A running child already delivered a result, so this is the time to start the next standby.
+    reprl_refill_standby(ctx);
+
     // Terminate any existing instance if requested.
     if (fresh_instance && ctx->pid) {
         reprl_terminate_child(ctx);
     }
 
-    // Reset file position so the child can simply read(2) and write(2) to these fds.
-    lseek(ctx->data_out->fd, 0, SEEK_SET);
-    lseek(ctx->data_in->fd, 0, SEEK_SET);
-    if (ctx->stdout) {
-        lseek(ctx->stdout->fd, 0, SEEK_SET);
-    }
-    if (ctx->stderr) {
-        lseek(ctx->stderr->fd, 0, SEEK_SET);
-    }
+    int r = reprl_prepare_execution(ctx, worker_id);
+    if (r != 0) return r;
 
-    // Spawn a new instance if necessary.
-    if (!ctx->pid) {
-        int r = reprl_spawn_child(ctx);
-        if (r != 0) return r;
+    // Copy the script to the data channel. Callers of reprl_execute_in_place() already wrote it there.
+    uint64_t phase_start = current_nsecs();
+    reprl_trim_data_channel(ctx->data_out, script_length);
+    if (script != ctx->data_out->mapping) {
+        memcpy(ctx->data_out->mapping, script, script_length);
     }
-
-    // Copy the script to the data channel.
-    memcpy(ctx->data_out->mapping, script, script_length);
+    ctx->data_out->high_water = MAX(ctx->data_out->high_water, script_length);
     
     // printf("reprl_execute: Sending script of length %llu to child\n", (unsigned long long)script_length);
 
-    // Note:
-    // I think resetting the current coverage map (in shared memory) here is not required because
-    // the code in d8 should already reset it. However, I detected some flaws (especially when the global coverage map
-    // was restored. I therefore added also the call here to just get 100% sure
-    // If I later start to boost performance I can maybe remove this code again
-    // (since this code will be executed in every iteration)
-    // TODO: Check this
-    coverage_clear_bitmap(worker_id);
+    phase_start = record_phase(ctx->phases, REPRL_PHASE_COPY, phase_start);
+
+    reprl_prepare_coverage(worker_id);
+    phase_start = current_nsecs();
 
     // Tell child to execute the script.
     if (write(ctx->ctrl_out, "cexe", 4) != 4 ||
@@ -936,72 +3505,433 @@ int reprl_execute(struct reprl_context* ctx, const char* script, uint64_t script
         }
         return reprl_error(ctx, "Failed to send command to child process: %s", strerror(errno));
     }
+    record_phase(ctx->phases, REPRL_PHASE_CONTROL, phase_start);
+    return 0;
+}
+
+int reprl_execute(struct reprl_context* ctx, const char* script, uint64_t script_length, uint64_t timeout, uint64_t* execution_time, int fresh_instance, int worker_id)
+{
+    int r = reprl_submit(ctx, script, script_length, fresh_instance, worker_id);
+    if (r != 0) return r;
 
     // Wait for child to finish execution (or crash).
-    int timeout_ms = timeout / 1000;
-    uint64_t start_time = current_usecs();
-    struct pollfd fds = {.fd = ctx->ctrl_in, .events = POLLIN, .revents = 0};
-    int res = poll(&fds, 1, timeout_ms);
-    *execution_time = current_usecs() - start_time;
-    if (res == 0) {
-        // Execution timed out. Kill child and return a timeout status.
-        reprl_terminate_child(ctx);
-        return 1 << 16;
-    } else if (res != 1) {
-        // An error occurred.
-        // We expect all signal handlers to be installed with SA_RESTART, so receiving EINTR here is unexpected and thus also an error.
-        return reprl_error(ctx, "Failed to poll: %s", strerror(errno));
+    return reprl_wait_for_status(ctx, timeout, execution_time);
+}
+
+int reprl_execute_batch(struct reprl_context* ctx, uint32_t count, const char** scripts, const uint64_t* lengths, const uint64_t* timeouts, int* statuses, uint64_t* execution_times, struct edge_set* new_edges, int worker_id)
+{
+    if (ctx == NULL || !ctx->initialized) {
+        return reprl_error(ctx, "REPRL context is not initialized");
+    }
+    if (count == 0) {
+        return 0;
+    }
+    if (count > REPRL_MAX_BATCH_SIZE) {
+        return reprl_error(ctx, "Batch too large");
+    }
+    uint64_t total_length = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (lengths[i] > ctx->data_out->capacity) {
+            return reprl_error(ctx, "Script too large");
+        }
+        total_length += lengths[i];
     }
 
-    // Poll succeeded, so there must be something to read now (either the status or EOF).
-    int status;
-    ssize_t rv = read(ctx->ctrl_in, &status, 4);
-    // printf("Read status: in worker %d: %d -> return status: %d\n", worker_id, status, rv);
-    if (rv < 0) {
-        return reprl_error(ctx, "Failed to read from control pipe: %s", strerror(errno));
-    } else if (rv != 4) {
-        // Most likely, the child process crashed and closed the write end of the control pipe.
-        // Unfortunately, there probably is nothing that guarantees that waitpid() will immediately succeed now,
-        // and we also don't want to block here. So just retry waitpid() a few times...
-        int success = 0;
-        do {
-            success = waitpid(ctx->pid, &status, WNOHANG) == ctx->pid;
-            if (!success) usleep(10);
-        } while (!success && current_usecs() - start_time < timeout);
+    reprl_refill_standby(ctx);
+    int r = reprl_prepare_execution(ctx, worker_id);
+    if (r != 0) return r;
 
-        if (!success) {
-            // Wait failed, so something weird must have happened. Maybe somehow the control pipe was closed without the child exiting?
-            // Probably the best we can do is kill the child and return an error.
-            reprl_terminate_child(ctx);
-            return reprl_error(ctx, "Child in weird state after execution");
+    // Children without the batch extension (or batches that don't fit into the data channel) are executed one by one.
+    if (!(ctx->capabilities & REPRL_CAP_BATCH) || total_length > ctx->data_out->capacity) {
+        for (uint32_t i = 0; i < count; i++) {
+            statuses[i] = reprl_execute(ctx, scripts[i], lengths[i], timeouts[i], &execution_times[i], 0, worker_id);
+            if (statuses[i] < 0) {
+                return i == 0 ? -1 : (int)i;
+            }
+            cov_evaluate_and_reset(worker_id, &new_edges[i]);
+            if (!ctx->pid) {
+                return i + 1;
+            }
         }
+        return count;
+    }
 
-        // Cleanup any state related to this child process.
-        reprl_child_terminated(ctx);
+    // Copy all scripts back-to-back into the data channel.
+    uint64_t phase_start = current_nsecs();
+    reprl_trim_data_channel(ctx->data_out, total_length);
+    ctx->data_out->high_water = MAX(ctx->data_out->high_water, total_length);
+    uint64_t offset = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        memcpy(ctx->data_out->mapping + offset, scripts[i], lengths[i]);
+        offset += lengths[i];
+    }
+    record_phase(ctx->phases, REPRL_PHASE_COPY, phase_start);
+
+    reprl_prepare_coverage(worker_id);
+    phase_start = current_nsecs();
+
+    struct batch_header {
+        char command[4];
+        uint32_t count;
+        uint64_t lengths[REPRL_MAX_BATCH_SIZE];
+    } header;
+    memcpy(header.command, "cbat", 4);
+    header.count = count;
+    memcpy(header.lengths, lengths, count * sizeof(uint64_t));
+    ssize_t header_size = 8 + count * sizeof(uint64_t);
+    if (write(ctx->ctrl_out, &header, header_size) != header_size) {
+        int status;
+        if (waitpid(ctx->pid, &status, WNOHANG) == ctx->pid) {
+            reprl_child_terminated(ctx);
+            return reprl_error(ctx, "Child unexpectedly terminated between executions");
+        }
+        return reprl_error(ctx, "Failed to send command to child process: %s", strerror(errno));
+    }
+    record_phase(ctx->phases, REPRL_PHASE_CONTROL, phase_start);
+
+    for (uint32_t i = 0; i < count; i++) {
+        statuses[i] = reprl_wait_for_status(ctx, timeouts[i], &execution_times[i]);
+        if (statuses[i] < 0) {
+            return i == 0 ? -1 : (int)i;
+        }
+        cov_evaluate_and_reset(worker_id, &new_edges[i]);
+
+        // A timeout or crash ends the batch, the remaining scripts are not executed.
+        if (!ctx->pid) {
+            return i + 1;
+        }
+        // The child waits for this token before it starts the next script, so the coverage of
+        // each script can be evaluated separately.
+        if (i + 1 < count) {
+            reprl_prepare_coverage(worker_id);
+            if (write(ctx->ctrl_out, "n", 1) != 1) {
+                reprl_terminate_child(ctx);
+                return i + 1;
+            }
+        }
+    }
+    return count;
+}
+
+void reprl_set_spawn_timeout(int worker_id, uint64_t timeout_ms)
+{
+    struct reprl_context* current_reprl_context = reprl_context_of(worker_id);
+    if (current_reprl_context != NULL) {
+        current_reprl_context->spawn_timeout = timeout_ms * 1000;
+    }
+}
+
+int reprl_max_workers()
+{
+    return REPRL_MAX_WORKERS;
+}
+
+int reprl_get_spawn_stats(int worker_id, struct reprl_spawn_stats* stats)
+{
+    struct reprl_context* current_reprl_context = reprl_context_of(worker_id);
+    if (current_reprl_context == NULL) {
+        return -1;
+    }
+    struct reprl_spawn_stats* current = &current_reprl_context->spawn_stats;
+    stats->spawns = __atomic_load_n(&current->spawns, __ATOMIC_RELAXED);
+    stats->forks = __atomic_load_n(&current->forks, __ATOMIC_RELAXED);
+    stats->standby_promotions = __atomic_load_n(&current->standby_promotions, __ATOMIC_RELAXED);
+    stats->failures = __atomic_load_n(&current->failures, __ATOMIC_RELAXED);
+    stats->total_us = __atomic_load_n(&current->total_us, __ATOMIC_RELAXED);
+    stats->max_us = __atomic_load_n(&current->max_us, __ATOMIC_RELAXED);
+    stats->last_us = __atomic_load_n(&current->last_us, __ATOMIC_RELAXED);
+    stats->standby_refills = __atomic_load_n(&current->standby_refills, __ATOMIC_RELAXED);
+    stats->refill_us = __atomic_load_n(&current->refill_us, __ATOMIC_RELAXED);
+    return 0;
+}
+
+int reprl_get_phase_histograms(int worker_id, struct reprl_histogram* histograms)
+{
+    if (worker_id < 0 || worker_id >= REPRL_MAX_WORKERS) {
+        return -1;
+    }
+    struct worker_slot* slot = __atomic_load_n(&worker_slots[worker_id], __ATOMIC_ACQUIRE);
+    if (slot == NULL) {
+        return -1;
+    }
+    for (int phase = 0; phase < REPRL_NUM_PHASES; phase++) {
+        struct reprl_histogram* histogram = &slot->phases[phase];
+        histograms[phase].count = __atomic_load_n(&histogram->count, __ATOMIC_RELAXED);
+        histograms[phase].total_ns = __atomic_load_n(&histogram->total_ns, __ATOMIC_RELAXED);
+        histograms[phase].max_ns = __atomic_load_n(&histogram->max_ns, __ATOMIC_RELAXED);
+        for (int i = 0; i < REPRL_HISTOGRAM_BUCKETS; i++) {
+            histograms[phase].buckets[i] = __atomic_load_n(&histogram->buckets[i], __ATOMIC_RELAXED);
+        }
+    }
+    return 0;
+}
+
+uint64_t reprl_last_execution_time(int worker_id)
+{
+    struct reprl_context* ctx = reprl_context_of(worker_id);
+    return ctx == NULL ? 0 : ctx->last_execution_time;
+}
+
+// Returns the mapping of the data channel that carries scripts to the child of this worker. A script written
+// to its start can be executed with reprl_execute_in_place() without being copied again. The mapping stays the
+// same for the whole lifetime of the worker, respawning the child keeps its content.
+char* reprl_get_script_buffer(int worker_id, uint64_t* size)
+{
+    struct reprl_context* current_reprl_context = reprl_context_of(worker_id);
+    if (current_reprl_context == NULL || !current_reprl_context->initialized) {
+        return NULL;
+    }
+    if (size != NULL) {
+        *size = current_reprl_context->data_out->capacity;
+    }
+    return current_reprl_context->data_out->mapping;
+}
+
+// Same as execute_script(), but executes the first length bytes of the script buffer. The script does not need to be NUL-terminated.
+int reprl_execute_in_place(int worker_id, uint64_t length, int timeout)
+{
+    return reprl_execute_in_place_us(worker_id, length, (uint64_t)timeout * 1000);
+}
 
-        if (WIFEXITED(status)) {
-            status = WEXITSTATUS(status) << 8;
-        } else if (WIFSIGNALED(status)) {
-            status = WTERMSIG(status);
+int reprl_execute_in_place_us(int worker_id, uint64_t length, uint64_t timeout_us)
+{
+    struct reprl_context* current_reprl_context = reprl_context_of(worker_id);
+    uint64_t real_execution_time = 0;
+    if (current_reprl_context == NULL || !current_reprl_context->initialized) {
+        return -1;
+    }
+    return reprl_execute(current_reprl_context, current_reprl_context->data_out->mapping, length, timeout_us, &real_execution_time, 0, worker_id);
+}
+
+int execute_script_batch(char** scripts, uint64_t* lengths, int* timeouts, int count, int* statuses, uint64_t* execution_times, struct edge_set* new_edges, int worker_id)
+{
+    struct reprl_context* current_reprl_context = reprl_context_of(worker_id);
+    if (scripts == NULL || count < 0 || count > REPRL_MAX_BATCH_SIZE) {
+        return -1;
+    }
+    uint64_t timeouts_us[REPRL_MAX_BATCH_SIZE];
+    for (int i = 0; i < count; i++) {
+        timeouts_us[i] = (uint64_t)timeouts[i] * 1000;
+    }
+    return reprl_execute_batch(current_reprl_context, count, (const char**)scripts, lengths, timeouts_us, statuses, execution_times, new_edges, worker_id);
+}
+
+struct reprl_executor* reprl_executor_create(uint32_t capacity)
+{
+    if (capacity == 0) {
+        return NULL;
+    }
+    struct reprl_executor* executor = calloc(1, sizeof(struct reprl_executor));
+    executor->pending = calloc(capacity, sizeof(struct reprl_pending));
+    executor->capacity = capacity;
+    executor->epoll_fd = -1;
+    executor->timer_fd = -1;
+    for (uint32_t i = 0; i < capacity; i++) {
+        executor->pending[i].worker_id = -1;
+    }
+#ifdef __linux__
+    executor->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    // Deadlines are tracked with a timerfd in the epoll set, epoll_wait() itself only has millisecond timeouts.
+    executor->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+    struct epoll_event event = { .events = EPOLLIN, .data.u32 = REPRL_EXECUTOR_TIMER };
+    if (executor->epoll_fd < 0 || executor->timer_fd < 0 ||
+        epoll_ctl(executor->epoll_fd, EPOLL_CTL_ADD, executor->timer_fd, &event) != 0) {
+        fprintf(stderr, "Failed to set up the executor: %s\n", strerror(errno));
+        reprl_executor_destroy(executor);
+        return NULL;
+    }
+#else
+    executor->epoll_fd = -1;
+    executor->timer_fd = -1;
+#endif
+    return executor;
+}
+
+void reprl_executor_destroy(struct reprl_executor* executor)
+{
+    if (executor == NULL) return;
+    // Children that are still executing are left running, the next execution on that worker waits for them.
+    if (executor->epoll_fd >= 0) {
+        close(executor->epoll_fd);
+    }
+    if (executor->timer_fd >= 0) {
+        close(executor->timer_fd);
+    }
+    free(executor->pending);
+    free(executor);
+}
+
+int reprl_executor_submit(struct reprl_executor* executor, int worker_id, const char* script, uint64_t length, int timeout)
+{
+    struct reprl_context* ctx = reprl_context_of(worker_id);
+    if (ctx == NULL) {
+        return -1;
+    }
+    struct reprl_pending* slot = NULL;
+    for (uint32_t i = 0; i < executor->capacity; i++) {
+        if (executor->pending[i].worker_id == worker_id) {
+            return reprl_error(ctx, "Worker %d is already executing", worker_id);
+        }
+        if (slot == NULL && executor->pending[i].worker_id < 0) {
+            slot = &executor->pending[i];
+        }
+    }
+    if (slot == NULL) {
+        return reprl_error(ctx, "Executor is full");
+    }
+
+    int r = reprl_submit(ctx, script, length, 0, worker_id);
+    if (r != 0) return r;
+
+    slot->worker_id = worker_id;
+    slot->start_time = current_usecs();
+    slot->timeout = (uint64_t)timeout * 1000;
+    slot->fds[0] = ctx->ctrl_in;
+    slot->fds[1] = ctx->server_pid ? ctx->fsrv_in : -1;
+    executor->in_flight++;
+#ifdef __linux__
+    for (int i = 0; i < 2; i++) {
+        if (slot->fds[i] < 0) continue;
+        struct epoll_event event = { .events = EPOLLIN, .data.u32 = slot - executor->pending };
+        if (epoll_ctl(executor->epoll_fd, EPOLL_CTL_ADD, slot->fds[i], &event) != 0) {
+            fprintf(stderr, "epoll_ctl() failed for fd %d: %s\n", slot->fds[i], strerror(errno));
+        }
+    }
+#endif
+    return 0;
+}
+
+// Stops watching the fds of a pending execution. Has to happen before the child is terminated: the registration
+// belongs to the open file, which the child keeps alive, so closing our fd alone would leave it in the epoll set.
+static void reprl_executor_unwatch(struct reprl_executor* executor, struct reprl_pending* slot)
+{
+#ifdef __linux__
+    for (int i = 0; i < 2; i++) {
+        if (slot->fds[i] >= 0) {
+            epoll_ctl(executor->epoll_fd, EPOLL_CTL_DEL, slot->fds[i], NULL);
+        }
+    }
+#else
+    (void)executor;
+    (void)slot;
+#endif
+}
+
+// Removes a pending execution from the executor and reports it.
+static void reprl_executor_complete(struct reprl_executor* executor, struct reprl_pending* slot, int status, struct reprl_completion* completion)
+{
+    completion->worker_id = slot->worker_id;
+    completion->status = status;
+    completion->execution_time = current_usecs() - slot->start_time;
+    slot->worker_id = -1;
+    executor->in_flight--;
+}
+
+// Waits until deadline (UINT64_MAX waits indefinitely) for pending executions to become ready and stores the
+// indices of their slots in ready.
+static int reprl_executor_poll(struct reprl_executor* executor, uint32_t* ready, uint64_t deadline)
+{
+#ifdef __linux__
+    struct itimerspec timer = { 0 };
+    if (deadline != UINT64_MAX) {
+        // A zero it_value would disarm the timer instead of expiring right away.
+        deadline = MAX(deadline, 1);
+        timer.it_value.tv_sec = deadline / 1000000;
+        timer.it_value.tv_nsec = (deadline % 1000000) * 1000;
+    }
+    timerfd_settime(executor->timer_fd, TFD_TIMER_ABSTIME, &timer, NULL);
+    struct epoll_event events[64];
+    int res = epoll_wait(executor->epoll_fd, events, 64, -1);
+    int n = 0;
+    for (int i = 0; i < res; i++) {
+        if (events[i].data.u32 == REPRL_EXECUTOR_TIMER) {
+            uint64_t expirations;
+            if (read(executor->timer_fd, &expirations, sizeof(expirations)) < 0) { }
         } else {
-            // This shouldn't happen, since we don't specify WUNTRACED for waitpid...
-            return reprl_error(ctx, "Waitpid returned unexpected child state %i", status);
+            ready[n++] = events[i].data.u32;
+        }
+    }
+    return res < 0 ? -1 : n;
+#else
+    struct pollfd fds[2 * executor->capacity];
+    for (uint32_t i = 0; i < executor->capacity; i++) {
+        int active = executor->pending[i].worker_id >= 0;
+        fds[2 * i] = (struct pollfd){ .fd = active ? executor->pending[i].fds[0] : -1, .events = POLLIN };
+        fds[2 * i + 1] = (struct pollfd){ .fd = active ? executor->pending[i].fds[1] : -1, .events = POLLIN };
+    }
+    uint64_t now = current_usecs();
+    int wait_ms = deadline == UINT64_MAX ? -1 : deadline > now ? (int)((deadline - now + 999) / 1000) : 0;
+    int res = poll(fds, 2 * executor->capacity, wait_ms);
+    int n = 0;
+    for (uint32_t i = 0; res > 0 && i < executor->capacity; i++) {
+        if (fds[2 * i].revents || fds[2 * i + 1].revents) {
+            ready[n++] = i;
         }
     }
+    return res < 0 ? -1 : n;
+#endif
+}
 
-    // The status must be a positive number, see the status encoding format below.
-    // We also don't allow the child process to indicate a timeout. If we wanted,
-    // we could treat it as an error if the upper bits are set.
-    status &= 0xffff;
+int reprl_executor_wait(struct reprl_executor* executor, struct reprl_completion* completions, uint32_t max, int wait_ms)
+{
+    uint64_t wait_deadline = wait_ms < 0 ? UINT64_MAX : current_usecs() + (uint64_t)wait_ms * 1000;
+    uint32_t ready[MAX(64, executor->capacity)];
+    uint32_t done = 0;
+    while (done == 0 && executor->in_flight > 0) {
+        // Executions that ran out of time are killed just like in reprl_wait_for_status.
+        uint64_t now = current_usecs();
+        uint64_t next_deadline = wait_deadline;
+        for (uint32_t i = 0; i < executor->capacity && done < max; i++) {
+            struct reprl_pending* slot = &executor->pending[i];
+            if (slot->worker_id < 0) continue;
+            if (now - slot->start_time >= slot->timeout) {
+                reprl_executor_unwatch(executor, slot);
+                struct reprl_context* ctx = reprl_context_of(slot->worker_id);
+                if (ctx != NULL) reprl_terminate_child(ctx);
+                reprl_executor_complete(executor, slot, 1 << 16, &completions[done++]);
+            } else {
+                next_deadline = MIN(next_deadline, slot->start_time + slot->timeout);
+            }
+        }
+        if (done > 0 || now >= wait_deadline) {
+            break;
+        }
 
-    return status;
+        int n = reprl_executor_poll(executor, ready, next_deadline);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            fprintf(stderr, "Failed to wait for executions: %s\n", strerror(errno));
+            return -1;
+        }
+        for (int i = 0; i < n && done < max; i++) {
+            struct reprl_pending* slot = &executor->pending[ready[i]];
+            // Both fds of a slot can be reported, the first one already completed it.
+            if (slot->worker_id < 0) continue;
+            struct reprl_context* ctx = reprl_context_of(slot->worker_id);
+            // Same precedence of the control pipe over the fork server as in reprl_wait_for_status.
+            struct pollfd fds[2] = {
+                {.fd = slot->fds[0], .events = POLLIN, .revents = 0},
+                {.fd = slot->fds[1], .events = POLLIN, .revents = 0},
+            };
+            if (poll(fds, 2, 0) <= 0) continue;
+            reprl_executor_unwatch(executor, slot);
+            // A worker destroyed while its execution was in flight has nothing left to read from.
+            int status = ctx != NULL ? reprl_read_status(ctx, fds, slot->start_time, slot->timeout) : -1;
+            reprl_executor_complete(executor, slot, status, &completions[done++]);
+        }
+    }
+    return done;
 }
 
 // Sets the coverage back to zero (should be called before every execution)
 void coverage_clear_bitmap(int worker_id) {
-    struct cov_context* context = &contexts[worker_id];
+    struct cov_context* context = cov_context_of(worker_id);
     if (context != NULL) {
-        memset(context->shmem->edges, 0, context->bitmap_size);
+        clear_edge_bitmap(context);
+        if (context->hitcounts) {
+            memset(context->counters->counters, 0, context->counts_size);
+            context->counters_clean = 1;
+        }
     }
     else{
         printf("Context is NULL for worker %d\n", worker_id);
@@ -1020,7 +3950,10 @@ int cov_get_edge_counts(struct cov_context* context, struct edge_counts* edges)
 
 void cov_clear_edge_data(int worker_id, uint32_t index)
 {
-    struct cov_context* context = &contexts[worker_id];
+    struct cov_context* context = cov_context_of(worker_id);
+    if (context == NULL) {
+        return;
+    }
     if (context->should_track_edges) {
         assert(context->edge_count[index]);
         context->edge_count[index] = 0;
@@ -1028,10 +3961,18 @@ void cov_clear_edge_data(int worker_id, uint32_t index)
     context->found_edges -= 1;
     // assert(!edge(context->virgin_bits, index));
     set_edge(context->virgin_bits, index);
+    delta_append(context, index, 1);
+    // Give the edge back, so that evaluating it again (e.g. to check flakiness) reports it in this worker.
+    if (context->shared_virgin != NULL) {
+        __atomic_fetch_or(&context->shared_virgin[index / 64], 1ULL << (index % 64), __ATOMIC_RELAXED);
+    }
 }
 void cov_set_edge_data(int worker_id, uint32_t index)
 {
-    struct cov_context* context = &contexts[worker_id];
+    struct cov_context* context = cov_context_of(worker_id);
+    if (context == NULL) {
+        return;
+    }
     if (context->should_track_edges) {
         assert(context->edge_count[index] == 0);
         context->edge_count[index] = 1;
@@ -1039,13 +3980,21 @@ void cov_set_edge_data(int worker_id, uint32_t index)
     context->found_edges += 1;
     // assert(!edge(context->virgin_bits, index));
     clear_edge(context->virgin_bits, index);
+    delta_append(context, index, 0);
+    if (context->shared_virgin != NULL) {
+        __atomic_fetch_and(&context->shared_virgin[index / 64], ~(1ULL << (index % 64)), __ATOMIC_RELAXED);
+    }
 }
 
 
 void cov_reset_state(int worker_id) {
-    struct cov_context* context = &contexts[worker_id];
+    struct cov_context* context = cov_context_of(worker_id);
+    if (context == NULL) {
+        return;
+    }
     memset(context->virgin_bits, 0xff, context->bitmap_size);
     memset(context->crash_bits, 0xff, context->bitmap_size);
+    delta_reset(context);
 
     if (context->edge_count != NULL) {
         memset(context->edge_count, 0, sizeof(uint32_t) * context->num_edges);
@@ -1059,18 +4008,46 @@ void cov_reset_state(int worker_id) {
 }
 
 
+// Returns the channel holding the given output of the last execution, NULL if it wasn't captured.
+static struct data_channel* reprl_output_channel(struct reprl_context* ctx, int channel)
+{
+    if (ctx == NULL || !ctx->initialized) {
+        return NULL;
+    }
+    switch (channel) {
+        case REPRL_CHANNEL_FUZZOUT:
+            return ctx->data_in;
+        case REPRL_CHANNEL_STDOUT:
+            return reprl_output_connected(ctx, ctx->stdout, ctx->stdout_policy) ? ctx->stdout : NULL;
+        case REPRL_CHANNEL_STDERR:
+            return reprl_output_connected(ctx, ctx->stderr, ctx->stderr_policy) ? ctx->stderr : NULL;
+        default:
+            return NULL;
+    }
+}
+
+// Maps the content of an output channel and one byte after it. Returns the length of the content or -1.
+static int64_t reprl_map_output(struct data_channel* channel)
+{
+    // The child shares the file offset with us, so the current position is the amount of data it wrote.
+    off_t written = lseek(channel->fd, 0, SEEK_CUR);
+    
+    // Ensure we don't exceed the channel capacity
+    uint64_t content_size = MIN((uint64_t)MAX(written, 0), channel->capacity - 1);
+    channel->high_water = MAX(channel->high_water, content_size);
+    if (reprl_map_data_channel(channel, content_size + 1) != 0) {
+        return -1;
+    }
+    return content_size;
+}
+
 static char* fetch_data_channel_content(struct data_channel* channel) {
     if (!channel) return "";
     
-    // Get the actual size of data written to the channel
-    off_t current_pos = lseek(channel->fd, 0, SEEK_CUR);
-    off_t file_size = lseek(channel->fd, 0, SEEK_END);
-    
-    // Restore the original position
-    lseek(channel->fd, current_pos, SEEK_SET);
-    
-    // Ensure we don't exceed the mapping size
-    size_t content_size = MIN(file_size, REPRL_MAX_DATA_SIZE - 1);
+    int64_t content_size = reprl_map_output(channel);
+    if (content_size < 0) {
+        return "";
+    }
     
     // Null-terminate the content
     channel->mapping[content_size] = 0;
@@ -1079,22 +4056,71 @@ static char* fetch_data_channel_content(struct data_channel* channel) {
 }
 
 char* reprl_fetch_fuzzout(int worker_id) {
-    struct reprl_context* current_reprl_context = reprl_contexts[worker_id];
-    return fetch_data_channel_content(current_reprl_context->data_in);
+    return fetch_data_channel_content(reprl_output_channel(reprl_context_of(worker_id), REPRL_CHANNEL_FUZZOUT));
 }
 
 char* reprl_fetch_stdout(int worker_id) {
-    struct reprl_context* current_reprl_context = reprl_contexts[worker_id];
-    return fetch_data_channel_content(current_reprl_context->stdout);
+    return fetch_data_channel_content(reprl_output_channel(reprl_context_of(worker_id), REPRL_CHANNEL_STDOUT));
 }
 
 char* reprl_fetch_stderr(int worker_id) {
-    struct reprl_context* current_reprl_context = reprl_contexts[worker_id];
-    return fetch_data_channel_content(current_reprl_context->stderr);
+    return fetch_data_channel_content(reprl_output_channel(reprl_context_of(worker_id), REPRL_CHANNEL_STDERR));
+}
+
+const char* reprl_fetch_output(int worker_id, int channel, uint64_t* length)
+{
+    *length = 0;
+    struct data_channel* data = reprl_output_channel(reprl_context_of(worker_id), channel);
+    if (data == NULL) {
+        return NULL;
+    }
+    int64_t content_size = reprl_map_output(data);
+    if (content_size < 0) {
+        return NULL;
+    }
+    *length = content_size;
+    return data->mapping;
+}
+
+const char* reprl_read_output(int worker_id, int channel, uint64_t* offset, uint64_t* length)
+{
+    *length = 0;
+    struct data_channel* data = reprl_output_channel(reprl_context_of(worker_id), channel);
+    if (data == NULL) {
+        return NULL;
+    }
+    // Same as reprl_map_output(), but the engine may still be writing, so only what it wrote so far is mapped.
+    off_t written = lseek(data->fd, 0, SEEK_CUR);
+    uint64_t end = MIN((uint64_t)MAX(written, 0), data->capacity - 1);
+    if (end <= *offset) {
+        return NULL;
+    }
+    data->high_water = MAX(data->high_water, end);
+    if (reprl_map_data_channel(data, end) != 0) {
+        return NULL;
+    }
+    const char* chunk = data->mapping + *offset;
+    *length = end - *offset;
+    *offset = end;
+    return chunk;
+}
+
+void reprl_capture_next_execution(int worker_id)
+{
+    struct reprl_context* ctx = reprl_context_of(worker_id);
+    if (ctx == NULL) {
+        return;
+    }
+    if (ctx->stdout_policy == REPRL_CAPTURE_ON_CRASH || ctx->stderr_policy == REPRL_CAPTURE_ON_CRASH) {
+        ctx->capture_armed = 1;
+    }
 }
 
 char* reprl_get_last_error(int worker_id) {
-    struct reprl_context* current_reprl_context = reprl_contexts[worker_id];
+    struct reprl_context* current_reprl_context = reprl_context_of(worker_id);
+    if (current_reprl_context == NULL) {
+        return "";
+    }
     // last_error is a char*, not a data_channel*
     // For now, return an empty string
     return current_reprl_context->last_error ? current_reprl_context->last_error : "";
@@ -30,31 +30,93 @@ struct edge_set {
 struct edge_counts {
     uint32_t count;
     uint32_t * edge_hit_count;
+    // How many of the edges were not hit by any execution before, the others only reached a new bucket
+    uint32_t new_edges;
 };
 
 
-// static const int kMaxCmpEvents = 1024000; // 1M
-// #define SHM_SIZE (0x1000000  + kMaxCmpEvents * 16) // 16MB
-
-// #define MAX_EDGES ((0x1000000 - 4) * 8)
-
-// struct shmem_data {
-//   uint32_t num_edges;
-//   uint64_t event_count;
-//   struct CmpEvent g_cmp_events[1024000]; 
-//   unsigned char edges[];
-  
-// };
-
-
+// Default size of the coverage region. REPRL_SHM_SIZE overrides it at runtime, the child then finds the size in SHM_SIZE.
 #define SHM_SIZE 0x100000
 #define MAX_EDGES ((SHM_SIZE - 4) * 8)
+// Largest region for which every edge index still fits into 32 bits.
+#define SHM_MAX_SIZE (512 << 20)
+#define SHM_MAX_EDGES_FOR_SIZE(size) (((uint64_t)(size) - 4) * 8)
 
 struct shmem_data {
   uint32_t num_edges;
   unsigned char edges[];
 };
 
+// Optional dirty block map, stored in the last bytes of the shared memory region so that the layout of struct shmem_data stays untouched.
+// If the child is started with SHM_DIRTY_TRACKING=1 in its environment and supports it, it sets magic during startup and afterwards marks
+// every SHM_DIRTY_BLOCK_SIZE block of shmem->edges it writes to:
+//     dirty->blocks[(index / 8 / SHM_DIRTY_BLOCK_SIZE) / 64] |= 1ULL << ((index / 8 / SHM_DIRTY_BLOCK_SIZE) % 64);
+// The harness then only evaluates and clears the marked blocks. A child can set overflow to request a full scan instead.
+#define SHM_DIRTY_MAGIC 0x44525459          // "DRTY"
+#define SHM_DIRTY_BLOCK_SIZE 64
+#define SHM_DIRTY_MAX_BLOCKS (SHM_SIZE / SHM_DIRTY_BLOCK_SIZE)
+
+struct shmem_dirty_map {
+  uint32_t magic;
+  uint32_t overflow;
+  uint64_t blocks[SHM_DIRTY_MAX_BLOCKS / 64];
+};
+
+#define SHM_DIRTY_MAP_OFFSET_FOR_SIZE(size) ((size) - sizeof(struct shmem_dirty_map))
+#define SHM_DIRTY_MAP_OFFSET SHM_DIRTY_MAP_OFFSET_FOR_SIZE(SHM_SIZE)
+
+// Optional hit count map in a second shared memory object. If REPRL_HITCOUNTS=1 is set, the harness creates it and passes its name
+// to the child as SHM_COUNTERS_ID. A supporting child sets magic during startup and increments counters[index] (wrapping at 255)
+// every time the edge with the given index is hit, in addition to setting the bit in shmem->edges.
+#define SHM_COUNTERS_MAGIC 0x544e4348       // "HCNT"
+
+struct shmem_counters {
+  uint32_t magic;
+  uint32_t reserved;
+  uint8_t counters[];
+};
+
+#define SHM_COUNTERS_SIZE_FOR_SIZE(size) (sizeof(struct shmem_counters) + SHM_MAX_EDGES_FOR_SIZE(size))
+#define SHM_COUNTERS_SIZE SHM_COUNTERS_SIZE_FOR_SIZE(SHM_SIZE)
+
+// Operands of one comparison in the engine.
+struct CmpEvent {
+  int64_t left;
+  int64_t right;
+};
+
+// Optional comparison log in a third shared memory object. If REPRL_CMPLOG=1 is set, the harness creates it and passes its name
+// to the child as SHM_CMPLOG_ID. A supporting child sets magic during startup and appends the operands of the comparisons it
+// wants to report to a single producer ring, dropping them while the ring is full:
+//     uint64_t head = log->head;
+//     if (head - __atomic_load_n(&log->tail, __ATOMIC_ACQUIRE) < SHM_CMPLOG_CAPACITY) {
+//         log->events[head & (SHM_CMPLOG_CAPACITY - 1)] = (struct CmpEvent){left, right};
+//         __atomic_store_n(&log->head, head + 1, __ATOMIC_RELEASE);
+//     } else {
+//         log->dropped++;
+//     }
+// The harness consumes events by moving tail up to head, so draining costs as much as the number of new events and nothing is cleared.
+#define SHM_CMPLOG_MAGIC 0x474f4c43         // "CLOG"
+#define SHM_CMPLOG_CAPACITY (1 << 16)       // Must be a power of two
+
+struct shmem_cmplog {
+  uint32_t magic;
+  uint32_t reserved;
+  // Only written by the child.
+  uint64_t head;
+  uint64_t dropped;
+  // Only written by the harness, on its own cache line.
+  uint64_t tail __attribute__((aligned(64)));
+  struct CmpEvent events[SHM_CMPLOG_CAPACITY] __attribute__((aligned(64)));
+};
+
+// Number of full edge arenas a worker may keep alive between two cov_reset_edge_arena() calls. Evaluations fail once
+// a further arena would be needed, see edge_arena_reserve().
+#define EDGE_ARENA_MAX_RETIRED 8
+
+// Slots of the table that removes duplicate operand pairs before they are handed out, see cov_fetch_cmp_events().
+#define CMPLOG_SEEN_SLOTS (1 << 16)
+
 
 
 struct cov_context {
@@ -65,8 +127,25 @@ struct cov_context {
 
     // Bitmap of edges that have been discovered so far.
     uint8_t* virgin_bits;
+    // Length of the private file mapping behind virgin_bits if it was loaded from a coverage snapshot,
+    // zero if virgin_bits comes from alloc_bitmap().
+    size_t virgin_mapping_size;
 
     uint8_t* virgin_bits_backup;
+
+    // Changes to virgin_bits since the last compaction, see the delta log in reprl.c.
+    uint32_t* delta_log;
+    uint64_t delta_count;
+    uint64_t delta_capacity;
+    // Number of log entries that are already in the delta file of the open checkpoint.
+    uint64_t delta_persisted;
+    // Log length at coverage_backup_virgin_bits(). If delta_marked is not set, virgin_bits_backup holds the rollback state.
+    uint64_t delta_mark;
+    int delta_marked;
+    // Open checkpoint, see coverage_checkpoint_open(). checkpoint_stale forces the next update to rewrite the snapshot.
+    char* checkpoint_path;
+    int checkpoint_fd;
+    int checkpoint_stale;
     // Bitmap of edges that have been discovered in crashing samples so far.
     uint8_t* crash_bits;
 
@@ -86,24 +165,199 @@ struct cov_context {
 
     // Pointer into the shared memory region.
     struct shmem_data* shmem;
+    // Size of the coverage region (and of the mapping of shmem), SHM_SIZE unless REPRL_SHM_SIZE is set.
+    uint64_t shm_size;
+    // REPRL_SHM_SIZE=auto, grow the region if the engine reports more edges than fit.
+    int shm_auto_size;
+    // Size of the current mapping of shmem, shm_size may already be larger while a region is recreated.
+    uint64_t shmem_mapped_size;
+
+    // Dirty block map at the end of the shared memory region, see struct shmem_dirty_map.
+    struct shmem_dirty_map* dirty;
+    // Whether the child was asked to maintain the dirty block map.
+    int dirty_tracking_requested;
+    // Whether the child confirmed that it maintains the dirty block map. Only then evaluation and clearing are restricted to dirty blocks.
+    int dirty_tracking;
+    // Set when the bitmap is known to be all zero, e.g. after cov_evaluate_and_reset. The next execution then skips clearing it.
+    int map_clean;
+
+    // Hit count map in its own shared memory region, see struct shmem_counters.
+    struct shmem_counters* counters;
+    uint64_t counters_size;
+    // Whether the hit count map was requested and whether the child confirmed that it maintains it.
+    int hitcounts_requested;
+    int hitcounts;
+    // Same as map_clean, for the hit count map.
+    int counters_clean;
+    // Number of counters that are evaluated, num_edges rounded up to 32.
+    uint32_t counts_size;
+    // Bucket bits that have not been seen so far, one byte per edge.
+    uint8_t* virgin_counts;
+    // Backs edge_counts->edge_hit_count of cov_evaluate_counts(), parallel to edge_arena.
+    uint32_t* bucket_arena;
+
+    // Comparison log in its own shared memory region, see struct shmem_cmplog.
+    struct shmem_cmplog* cmplog;
+    // Whether the comparison log was requested and whether the child confirmed that it writes it.
+    int cmplog_requested;
+    int cmplog_enabled;
+    // Hashes of the operand pairs handed out so far, open addressing with CMPLOG_SEEN_SLOTS slots. Zero marks a free slot.
+    uint64_t* cmp_seen;
+    uint32_t cmp_seen_used;
+    // New operand pairs of the last cov_fetch_cmp_events(), at most SHM_CMPLOG_CAPACITY.
+    struct CmpEvent* cmp_new;
+    uint64_t cmp_new_count;
+
+    // Coverage region, hit count map and comparison log of the standby child (see reprl_context), which would
+    // otherwise write its startup coverage into the ones of the active child. Created when the first standby is
+    // started and exchanged with the regions above when it is promoted. standby_swapped tells whether the
+    // active child currently uses the objects named ..._standby.
+    struct shmem_data* standby_shmem;
+    uint64_t standby_shmem_mapped_size;
+    struct shmem_dirty_map* standby_dirty;
+    struct shmem_counters* standby_counters;
+    uint64_t standby_counters_size;
+    struct shmem_cmplog* standby_cmplog;
+    int standby_swapped;
+
+    // Words of the virgin map shared by all workers, NULL unless REPRL_SHARED_VIRGIN=1 was set.
+    uint64_t* shared_virgin;
+    int shared_virgin_requested;
 
     // Count of occurrences per edge
     uint32_t * edge_count;
+
+    // Arena backing the edge_indices of every edge_set returned by cov_evaluate.
+    // Allocated once in coverage_finish_initialization, views are appended until cov_reset_edge_arena is called.
+    uint32_t* edge_arena;
+    // Number of indices the arena can hold, twice the number of bits in the bitmap.
+    uint64_t edge_arena_capacity;
+    // Number of indices currently handed out.
+    uint64_t edge_arena_used;
+    // Full arenas (and their bucket arenas) that views may still point into. They are replaced instead of reused
+    // and only freed by cov_reset_edge_arena.
+    uint32_t* retired_edge_arenas[EDGE_ARENA_MAX_RETIRED];
+    uint32_t* retired_bucket_arenas[EDGE_ARENA_MAX_RETIRED];
+    uint32_t retired_arena_count;
+
+    // Edges a minimization tries to preserve, laid out like shmem->edges (bitmap_size bytes).
+    // NULL until cov_set_target_edges() is called, dropped when the bitmap is resized.
+    uint64_t* target_mask;
 };
 
 /// Maximum size for data transferred through REPRL. In particular, this is the maximum size of scripts that can be executed.
 /// Currently, this is 16MB. Executing a 16MB script file is very likely to take longer than the typical timeout, so the limit on script size shouldn't be a problem in practice.
 #define REPRL_MAX_DATA_SIZE (16 << 20)
 
+/// Data channels of a context, used to index reprl_config.channel_capacity.
+#define REPRL_CHANNEL_SCRIPT 0
+#define REPRL_CHANNEL_FUZZOUT 1
+#define REPRL_CHANNEL_STDOUT 2
+#define REPRL_CHANNEL_STDERR 3
+#define REPRL_NUM_CHANNELS 4
+
+/// Capture policies for the stdout and stderr of the child, see reprl_config.capture_stdout.
+/// REPRL_CAPTURE_ON_CRASH keeps the output of the child on /dev/null until reprl_capture_next_execution() is called,
+/// usually to re-run a crashing sample for triage, so that regular executions don't pay for the capture.
+#define REPRL_CAPTURE_OFF 0
+#define REPRL_CAPTURE_ALWAYS 1
+#define REPRL_CAPTURE_ON_CRASH 2
+
+/// Output channels are mapped in steps of at least this size as the child writes more data.
+#define REPRL_CHANNEL_INITIAL_MAP (64 << 10)
+/// Once a channel held more than this, the pages above it are released again before the next execution.
+#define REPRL_CHANNEL_TRIM_THRESHOLD (1 << 20)
+
+/// Number of worker ids the context registry can hand out. Ids at or above REPRL_BYTECODE_WORKER_BASE are the
+/// contexts of the bytecode collecting pool, which run the engine with its bytecode printed to stdout.
+#define REPRL_MAX_WORKERS 2048
+#define REPRL_BYTECODE_WORKER_BASE (REPRL_MAX_WORKERS / 2)
+
+/// Default for how long a new child may take until it sends its HELO, in microseconds.
+#define REPRL_DEFAULT_SPAWN_TIMEOUT (10 * 1000 * 1000)
+
+/// Statistics about how long it takes to get a new child ready for executions.
+struct reprl_spawn_stats {
+    // Number of children that became ready, including forks and standby promotions.
+    uint64_t spawns;
+    // How many of them were forked from the fork server or were promoted standby children.
+    uint64_t forks;
+    uint64_t standby_promotions;
+    // Number of attempts that failed, e.g. because the engine did not send its HELO in time.
+    uint64_t failures;
+    // Time from the start of the spawn until the handshake completed, in microseconds.
+    uint64_t total_us;
+    uint64_t max_us;
+    uint64_t last_us;
+    // Standby children started to replace a promoted (or missing) one and the time their fork and execve took.
+    // Not part of the spawn times above, they are started after the new child delivered its first result.
+    uint64_t standby_refills;
+    uint64_t refill_us;
+};
+
+/// Phases of an execution that are timed separately, see reprl_get_phase_histograms().
+#define REPRL_PHASE_COPY 0      // Copying the script into the data channel
+#define REPRL_PHASE_CLEAR 1     // Clearing the coverage bitmap before the execution
+#define REPRL_PHASE_CONTROL 2   // Sending the command to the child
+#define REPRL_PHASE_RUN 3       // Waiting for the engine to finish the script
+#define REPRL_PHASE_STATUS 4    // Reading and decoding the status
+#define REPRL_PHASE_EVALUATE 5  // cov_evaluate() and cov_evaluate_and_reset()
+#define REPRL_PHASE_RESPAWN 6   // Getting a new child ready when there is none
+#define REPRL_NUM_PHASES 7
+
+/// Log-linear histogram of durations in nanoseconds. Values below 2^REPRL_HISTOGRAM_SUB_BITS have a bucket each,
+/// above that every power of two is split into 2^REPRL_HISTOGRAM_SUB_BITS buckets, so a bucket is at most 12.5% wide.
+/// The last bucket also holds everything beyond 2^40ns (about 18 minutes).
+#define REPRL_HISTOGRAM_SUB_BITS 3
+#define REPRL_HISTOGRAM_BUCKETS (38 << REPRL_HISTOGRAM_SUB_BITS)
+
+/// Only the worker's own thread writes its histograms, with relaxed atomic stores, so they can be read from the stats
+/// thread at any time without locking. A snapshot may be off by the execution that is in progress.
+struct reprl_histogram {
+    uint64_t count;
+    uint64_t total_ns;
+    uint64_t max_ns;
+    uint64_t buckets[REPRL_HISTOGRAM_BUCKETS];
+};
+
+/// Describes the engine a worker runs, see reprl_init_with_config().
+struct reprl_config {
+    // "v8", "firefox" or "jsc", selects the engine specific flags.
+    const char* engine;
+    // Path of the engine binary.
+    const char* binary;
+    // NULL terminated list of additional flags that are appended to the engine flags, may be NULL.
+    const char** extra_args;
+    // Firefox only, use the baseline instead of the ion wasm compiler.
+    int wasm_baseline;
+    // V8 only, print the bytecode of executed functions to stdout.
+    int print_bytecode;
+    // REPRL_CAPTURE_* policy for the output of the engine.
+    int capture_stdout;
+    int capture_stderr;
+    // Overrides REPRL_SPAWN_TIMEOUT_MS if not zero.
+    int spawn_timeout_ms;
+    // Maximum size of each data channel (REPRL_CHANNEL_*) in bytes. Zero selects REPRL_OUTPUT_CAPACITY for the
+    // output channels if it is set and REPRL_MAX_DATA_SIZE otherwise.
+    uint64_t channel_capacity[REPRL_NUM_CHANNELS];
+};
+
 /// Opaque struct representing a REPRL execution context.
 
-// A unidirectional communication channel for larger amounts of data, up to a maximum size (REPRL_MAX_DATA_SIZE).
+// A unidirectional communication channel for larger amounts of data, up to a maximum size (capacity).
 // Implemented as a (RAM-backed) file for which the file descriptor is shared with the child process and which is mapped into our address space.
+// The file is sparse, so only pages that were actually written use memory.
 struct data_channel {
     // File descriptor of the underlying file. Directly shared with the child process.
     int fd;
-    // Memory mapping of the file, always of size REPRL_MAX_DATA_SIZE.
+    // Memory mapping of the file. The script channel is mapped completely and never moves, output channels only map
+    // what has been written so far and may move when they grow.
     char* mapping;
+    uint64_t mapped_size;
+    // Size of the file and maximum amount of data the channel carries.
+    uint64_t capacity;
+    // Most data the channel held since its pages were last released, see reprl_trim_data_channel().
+    uint64_t high_water;
 };
 
 struct reprl_context {
@@ -123,6 +377,15 @@ struct reprl_context {
     // Optional data channel for the child's stdout and stderr.
     struct data_channel* stdout;
     struct data_channel* stderr;
+    // Capacities used by reprl_initialize_context(), indexed by REPRL_CHANNEL_*. Zero selects REPRL_MAX_DATA_SIZE.
+    uint64_t channel_capacity[REPRL_NUM_CHANNELS];
+    // REPRL_CAPTURE_* policies of the stdout and stderr channels. With REPRL_CAPTURE_ON_CRASH the channel is only
+    // created and connected to the child once capture_armed is set, capture_attached tells whether the running
+    // child, fork server and standby write into it.
+    int stdout_policy;
+    int stderr_policy;
+    int capture_armed;
+    int capture_attached;
 
     // PID of the child process. Will be zero if no child process is currently running.
     int pid;
@@ -133,8 +396,73 @@ struct reprl_context {
 
     // A malloc'd string containing a description of the last error that occurred.
     char* last_error;
+
+    // Protocol extensions (REPRL_CAP_*) negotiated with the current child during the handshake.
+    uint32_t capabilities;
+
+    // PID of the fork server if REPRL_CAP_FORKSERVER is in use, zero otherwise. pid is then a fork of this process.
+    int server_pid;
+    // Pipes to and from the fork server. Only valid if server_pid is nonzero.
+    int fsrv_in;
+    int fsrv_out;
+    // Read end of the control pipe REPRL -> child, kept while a fork server may use it to drain commands that a
+    // killed fork never read.
+    int ctrl_out_reader;
+
+    // Optional standby child that is started once the active one delivered a result and replaces it when it dies.
+    // It shares the script and fuzzout channels with the active child, which is safe because an engine only touches
+    // them while executing a command. Its output can arrive at any time, so it has its own stdout and stderr
+    // channels, and its own environment that points it to the standby regions of struct cov_context.
+    // Its handshake happens when it is promoted.
+    int standby_enabled;
+    int standby_pid;
+    int standby_ctrl_in;
+    int standby_ctrl_out;
+    int standby_fsrv_in;
+    int standby_fsrv_out;
+    int standby_ctrl_out_reader;
+    struct data_channel* standby_stdout;
+    struct data_channel* standby_stderr;
+    char** standby_envp;
+    // Set when the standby slot has to be filled again, see reprl_refill_standby().
+    int standby_refill;
+
+    // Maximum time a new child may take until it sends its HELO in microseconds, REPRL_DEFAULT_SPAWN_TIMEOUT if zero.
+    uint64_t spawn_timeout;
+    // Only updated by the thread that owns the worker, with atomic stores, since reprl_get_spawn_stats() may be
+    // called from any thread.
+    struct reprl_spawn_stats spawn_stats;
+
+    // Worker this context belongs to and its phase histograms (REPRL_NUM_PHASES entries), set by reprl_initialize_context().
+    int worker_id;
+    struct reprl_histogram* phases;
+    // Duration of the last execution in microseconds as measured around the wait for its status.
+    uint64_t last_execution_time;
 };
 
+/// Protocol extensions.
+///
+/// A child that supports extensions sends "HELX" followed by a 32-bit mask of REPRL_CAP_* flags instead of "HELO".
+/// The parent replies with "HELX" followed by the mask of the extensions it accepted. A plain "HELO" is answered
+/// with "HELO" as before and no extensions are used.
+///
+/// REPRL_CAP_BATCH: command "cbat", followed by a 32-bit count and count 64-bit script lengths. The scripts are
+/// stored back-to-back in the data channel. The child executes them in order and writes the 32-bit status of every
+/// script to the control pipe. Before starting the next script it waits for a single "n" byte from the parent, which
+/// the parent sends once it has evaluated the coverage. No token follows the last script.
+///
+/// REPRL_CAP_FORKSERVER: after the handshake the engine process does not execute scripts itself but acts as fork server
+/// on two additional fds, 104 (commands from the parent) and 105 (replies to the parent). On "fork" it forks, replies
+/// with the 32-bit pid of the new process, waits for that process to terminate and then sends its 32-bit wait status.
+/// The forked process shares the control and data fds with the server and directly waits for the next command on them.
+/// A fresh instance (after crashes, timeouts or with fresh_instance) therefore only costs a fork instead of an engine startup.
+#define REPRL_CAP_BATCH (1 << 0)
+#define REPRL_CAP_FORKSERVER (1 << 1)
+#define REPRL_SUPPORTED_CAPABILITIES (REPRL_CAP_BATCH | REPRL_CAP_FORKSERVER)
+
+/// Maximum number of scripts per reprl_execute_batch call.
+#define REPRL_MAX_BATCH_SIZE 256
+
 
 /// Allocates a new REPRL context.
 /// @return an uninitialzed REPRL context
@@ -145,20 +473,33 @@ struct reprl_context* reprl_create_context();
 /// @param ctx An uninitialized context
 /// @param argv The argv vector for the child processes
 /// @param envp The envp vector for the child processes
-/// @param capture_stdout Whether this REPRL context should capture the child's stdout
-/// @param capture_stderr Whether this REPRL context should capture the child's stderr
+/// @param capture_stdout REPRL_CAPTURE_* policy for the child's stdout
+/// @param capture_stderr REPRL_CAPTURE_* policy for the child's stderr
 /// @return zero in case of no errors, otherwise a negative value
 int reprl_initialize_context(struct reprl_context* ctx, char** argv, char** envp, int capture_stdout, int capture_stderr, int worker_id);
 
 void init(int worker_id);
+int reprl_init_with_config(int worker_id, const struct reprl_config* config);
+int reprl_max_workers();
 void spawn(int worker_id);
 
 void coverage_clear_bitmap(int worker_id);
 uint32_t coverage_finish_initialization(int worker_id, int should_track_edges);
 int cov_evaluate(int worker_id,struct edge_set* new_edges);
+int cov_evaluate_and_reset(int worker_id, struct edge_set* new_edges);
+void cov_reset_edge_arena(int worker_id);
+int cov_evaluate_counts(int worker_id, struct edge_set* new_edges, struct edge_counts* counts);
+int cov_hitcounts_enabled(int worker_id);
+int cov_merge_edges(int worker_id, const uint32_t* indices, uint32_t count, struct edge_set* merged);
+int cov_merge_counts(int worker_id, const uint32_t* indices, const uint32_t* buckets, uint32_t count);
+int cov_count_hit_edges(int worker_id, const uint32_t* indices, uint32_t count);
+int cov_set_target_edges(int worker_id, const uint32_t* indices, uint32_t count);
+int cov_count_target_hits(int worker_id);
+int cov_shared_virgin_enabled(int worker_id);
 struct CmpEvent* cov_fetch_cmp_events(int worker_id);
 uint64_t fetch_event_count(int worker_id);
 void cov_clear_cmp_events(int worker_id);
+int cov_cmplog_enabled(int worker_id);
 int execute_script(char* arg_script_string, int arg_timeout, int fresh_instance, int worker_id);
 
 
@@ -180,9 +521,117 @@ void reprl_destroy_context(int worker_id);
 /// @return A REPRL exit status (see below) or a negative number in case of an error
 int reprl_execute(struct reprl_context* ctx, const char* script, uint64_t script_length, uint64_t timeout, uint64_t* execution_time, int fresh_instance, int worker_id);
 
+/// Sets how long a new child of this worker may take until it is ready. Can also be set with REPRL_SPAWN_TIMEOUT_MS.
+void reprl_set_spawn_timeout(int worker_id, uint64_t timeout_ms);
+/// Copies the spawn statistics of this worker to stats. Returns -1 if the worker has no REPRL context.
+int reprl_get_spawn_stats(int worker_id, struct reprl_spawn_stats* stats);
+
+/// Copies the REPRL_NUM_PHASES phase histograms of this worker to histograms. Returns -1 for unknown workers.
+int reprl_get_phase_histograms(int worker_id, struct reprl_histogram* histograms);
+
+/// Returns the duration of the last execution of this worker in microseconds, without the harness overhead
+/// around it. Zero if the worker has no REPRL context.
+uint64_t reprl_last_execution_time(int worker_id);
+
+/// Returns the start of the data channel mapping through which scripts are handed to the child of this worker
+/// and writes its size to size. Scripts written there are executed with reprl_execute_in_place without another copy.
+char* reprl_get_script_buffer(int worker_id, uint64_t* size);
+/// Executes the first length bytes of the script buffer. The timeout is given in milliseconds, like for execute_script.
+int reprl_execute_in_place(int worker_id, uint64_t length, int timeout);
+/// Same as reprl_execute_in_place, but with the timeout in microseconds.
+int reprl_execute_in_place_us(int worker_id, uint64_t length, uint64_t timeout_us);
+
+/// Executes count scripts with a single command if the child supports REPRL_CAP_BATCH, one by one otherwise.
+/// The coverage of every script is evaluated (and reset) right after it finished and stored in new_edges[i],
+/// borrowing from the edge arena like cov_evaluate(). A timeout or crash ends the batch early.
+///
+/// @param timeouts The maximum allowed execution time of each script in microseconds
+/// @return The number of scripts for which statuses, execution_times and new_edges were written, or a negative number
+///         if not even the first script could be executed
+int reprl_execute_batch(struct reprl_context* ctx, uint32_t count, const char** scripts, const uint64_t* lengths, const uint64_t* timeouts, int* statuses, uint64_t* execution_times, struct edge_set* new_edges, int worker_id);
+int execute_script_batch(char** scripts, uint64_t* lengths, int* timeouts, int count, int* statuses, uint64_t* execution_times, struct edge_set* new_edges, int worker_id);
+
+/// One execution of a reprl_executor that is still running.
+struct reprl_pending {
+    // Worker the execution belongs to, -1 if the slot is free.
+    int worker_id;
+    uint64_t start_time;
+    // In microseconds.
+    uint64_t timeout;
+    // Control pipe and (with a fork server) fork server pipe of the child, watched for the status.
+    int fds[2];
+};
+
+/// Lets a single thread drive the children of several workers at once: scripts are submitted to their children without
+/// waiting, and reprl_executor_wait() returns the executions as they finish (or time out) in any order. That way a
+/// thread can keep more children busy than there are threads, see reprl_executor_create().
+struct reprl_executor {
+    // epoll instance the fds of all pending executions are registered with, and a timerfd for the next deadline
+    // (Linux only).
+    int epoll_fd;
+    int timer_fd;
+    uint32_t capacity;
+    uint32_t in_flight;
+    struct reprl_pending* pending;
+};
+
+/// epoll data of the executor's timerfd, pending executions use their slot index.
+#define REPRL_EXECUTOR_TIMER UINT32_MAX
+
+/// A finished execution returned by reprl_executor_wait().
+struct reprl_completion {
+    int worker_id;
+    // Status as returned by reprl_execute, negative on errors.
+    int status;
+    // In microseconds, measured from the submission.
+    uint64_t execution_time;
+};
+
+/// Creates an executor for up to capacity concurrent executions, each on a different worker. Returns NULL on failure.
+struct reprl_executor* reprl_executor_create(uint32_t capacity);
+void reprl_executor_destroy(struct reprl_executor* executor);
+
+/// Hands the script to the child of the worker (spawning one if needed) and returns without waiting for it.
+/// The coverage of the execution can be evaluated as usual once it was returned by reprl_executor_wait().
+/// The timeout is given in milliseconds, like for execute_script.
+/// @return zero on success, a negative value on errors or if the worker is already executing or the executor is full
+int reprl_executor_submit(struct reprl_executor* executor, int worker_id, const char* script, uint64_t length, int timeout);
+
+/// Waits until at least one submitted execution finished, or for at most wait_ms milliseconds (-1 waits indefinitely).
+/// Executions that exceed their timeout are killed and reported with the timeout status.
+/// @return The number of completions written (at most max), zero if nothing finished in time, negative on errors
+int reprl_executor_wait(struct reprl_executor* executor, struct reprl_completion* completions, uint32_t max, int wait_ms);
+
+/// Writes the virgin bits of this worker to a coverage snapshot: a page-sized header with the engine build id,
+/// num_edges, bitmap_size and a checksum, followed by the bitmap. The file is replaced atomically.
+/// @return The number of discovered edges, -1 on errors
 int coverage_save_virgin_bits_in_file(int worker_id, const char *filepath);
 
+/// Loads a snapshot written by coverage_save_virgin_bits_in_file(). The bitmap is mapped copy-on-write, so workers
+/// that load the same snapshot share its pages until they discover new edges. Raw bitmaps of older versions are
+/// still accepted if their size matches.
+/// @return The number of discovered edges, -1 if the snapshot is unreadable or belongs to a different engine build
 int coverage_load_virgin_bits_from_file(int worker_id,const char *filepath);
+
+/// Starts checkpointing the virgin bits of this worker to path: a snapshot as written by
+/// coverage_save_virgin_bits_in_file() and a delta log in path.delta with the edges discovered since.
+/// @return 0 on success, -1 if the snapshot can't be written
+int coverage_checkpoint_open(int worker_id, const char* path);
+
+/// Appends the edges discovered since the last call to the delta log of the open checkpoint. Once the log is as
+/// large as the bitmap, the snapshot is rewritten instead and the log starts over.
+/// @return The number of bytes written, -1 on errors or if no checkpoint is open
+int64_t coverage_checkpoint(int worker_id);
+
+/// Writes the remaining changes and stops checkpointing.
+void coverage_checkpoint_close(int worker_id);
+
+/// Loads a checkpoint written with coverage_checkpoint_open(): the snapshot plus the delta log, if it belongs to it.
+/// @return The number of discovered edges, -1 on errors like coverage_load_virgin_bits_from_file()
+int coverage_load_checkpoint(int worker_id, const char* path);
+/// Identifies the edge numbering of a worker, i.e. its engine build and number of edges.
+/// Edge indices can only be exchanged between processes whose fingerprints match.
+uint64_t coverage_fingerprint(int worker_id);
 /// Returns true if the execution terminated due to a signal.
 ///
 /// The 32bit REPRL exit status as returned by reprl_execute has the following format:
@@ -218,25 +667,40 @@ static inline int REXITSTATUS(int status)
 }
 
 /// Returns the stdout data of the last successful execution if the context is capturing stdout, otherwise an empty string.
-/// The output is limited to REPRL_MAX_DATA_SIZE (currently 16MB).
+/// The output is limited to the capacity of the channel (by default REPRL_MAX_DATA_SIZE, currently 16MB).
 ///
 /// @param ctx The REPRL context
 /// @return A string pointer which is owned by the REPRL context and thus should not be freed by the caller
 char* reprl_fetch_stdout(int worker_id);
 
 /// Returns the stderr data of the last successful execution if the context is capturing stderr, otherwise an empty string.
-/// The output is limited to REPRL_MAX_DATA_SIZE (currently 16MB).
+/// The output is limited to the capacity of the channel (by default REPRL_MAX_DATA_SIZE, currently 16MB).
 ///
 /// @param ctx The REPRL context
 /// @return A string pointer which is owned by the REPRL context and thus should not be freed by the caller
 char* reprl_fetch_stderr(int worker_id);
 
 /// Returns the fuzzout data of the last successful execution.
-/// The output is limited to REPRL_MAX_DATA_SIZE (currently 16MB).
+/// The output is limited to the capacity of the channel (by default REPRL_MAX_DATA_SIZE, currently 16MB).
 ///
 /// @param ctx The REPRL context
 /// @return A string pointer which is owned by the REPRL context and thus should not be freed by the caller
 char* reprl_fetch_fuzzout(int worker_id);
+
+/// Returns the output of the last execution on one of the output channels (REPRL_CHANNEL_FUZZOUT, _STDOUT or
+/// _STDERR) together with its length. Unlike the reprl_fetch_* functions this doesn't terminate the data, so the
+/// result is not a C string. Returns NULL and a length of zero if the channel didn't capture the last execution.
+const char* reprl_fetch_output(int worker_id, int channel, uint64_t* length);
+
+/// Streaming variant of reprl_fetch_output(): returns what was written to the channel after *offset and advances
+/// *offset past it. Can be called while the execution is still running (see reprl_executor_submit()) to process
+/// the output as the engine produces it. Start with an offset of zero for every execution. The chunk stays valid
+/// until the next call for this worker. Returns NULL and a length of zero if there is nothing new.
+const char* reprl_read_output(int worker_id, int channel, uint64_t* offset, uint64_t* length);
+
+/// Captures stdout and stderr of the next execution of the worker even if their policy is REPRL_CAPTURE_ON_CRASH.
+/// The engine is restarted with its output connected before and after that execution.
+void reprl_capture_next_execution(int worker_id);
 /// Returns a string describing the last error that occurred in the given context.
 ///
 /// @param ctx The REPRL context
@@ -0,0 +1,407 @@
+use std::collections::{HashMap, HashSet};
+use std::io::{self, BufReader, BufWriter, Read, Write};
+use std::net::{SocketAddr, TcpListener, TcpStream};
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::{mpsc, Arc, Mutex};
+use std::thread;
+use std::time::Duration;
+use crate::corpus_arena::ProgramText;
+
+// Frames on a sync link: a little-endian u32 length, then the kind byte and the fields of the message.
+// Integers are little-endian, byte strings and index lists are prefixed with their u32 length.
+const SYNC_VERSION: u32 = 1;
+const FRAME_HELLO: u8 = 1;  // version u32, fingerprint u64
+const FRAME_HAVE: u8 = 2;   // hashes of the entries the sender knows
+const FRAME_ENTRY: u8 = 3;  // hash u64, program IR, JS code, edges
+const MAX_FRAME_SIZE: usize = 64 << 20;
+
+// How long to wait before connecting to a peer again
+const RECONNECT_INTERVAL: Duration = Duration::from_secs(5);
+
+/// Content address of a corpus entry, FNV-1a of its JS code so that it is the same on every node
+pub fn entry_hash(js_code: &str) -> u64 {
+    let mut hash = 0xcbf29ce484222325u64;
+    for byte in js_code.as_bytes() {
+        hash = (hash ^ *byte as u64).wrapping_mul(0x100000001b3);
+    }
+    hash
+}
+
+/// Corpus entry of another node with the edges it found there
+pub struct SyncEntry {
+    pub program_ir: String,
+    pub js_code: String,
+    pub edges: Vec<u32>,
+}
+
+enum SyncMessage {
+    Hello { version: u32, fingerprint: u64 },
+    Have { hashes: Vec<u64> },
+    Entry { hash: u64, program_ir: String, js_code: String, edges: Vec<u32> },
+}
+
+impl SyncMessage {
+    fn write_to(&self, out: &mut impl Write) -> io::Result<()> {
+        let mut frame = Vec::new();
+        match self {
+            SyncMessage::Hello { version, fingerprint } => {
+                frame.push(FRAME_HELLO);
+                frame.extend_from_slice(&version.to_le_bytes());
+                frame.extend_from_slice(&fingerprint.to_le_bytes());
+            }
+            SyncMessage::Have { hashes } => {
+                frame.push(FRAME_HAVE);
+                frame.extend_from_slice(&(hashes.len() as u32).to_le_bytes());
+                for hash in hashes {
+                    frame.extend_from_slice(&hash.to_le_bytes());
+                }
+            }
+            SyncMessage::Entry { hash, program_ir, js_code, edges } => {
+                frame.push(FRAME_ENTRY);
+                frame.extend_from_slice(&hash.to_le_bytes());
+                for text in [program_ir, js_code] {
+                    frame.extend_from_slice(&(text.len() as u32).to_le_bytes());
+                    frame.extend_from_slice(text.as_bytes());
+                }
+                frame.extend_from_slice(&(edges.len() as u32).to_le_bytes());
+                for edge in edges {
+                    frame.extend_from_slice(&edge.to_le_bytes());
+                }
+            }
+        }
+        out.write_all(&(frame.len() as u32).to_le_bytes())?;
+        out.write_all(&frame)
+    }
+
+    fn read_from(input: &mut impl Read) -> io::Result<SyncMessage> {
+        let mut length = [0u8; 4];
+        input.read_exact(&mut length)?;
+        let length = u32::from_le_bytes(length) as usize;
+        if length == 0 || length > MAX_FRAME_SIZE {
+            return Err(invalid("bad frame length"));
+        }
+        let mut frame = vec![0u8; length];
+        input.read_exact(&mut frame)?;
+        let mut fields = FrameReader { data: &frame[1..] };
+        let message = match frame[0] {
+            FRAME_HELLO => SyncMessage::Hello { version: fields.u32()?, fingerprint: fields.u64()? },
+            FRAME_HAVE => {
+                let count = fields.u32()? as usize;
+                let hashes = (0..count).map(|_| fields.u64()).collect::<io::Result<_>>()?;
+                SyncMessage::Have { hashes }
+            }
+            FRAME_ENTRY => {
+                let hash = fields.u64()?;
+                let program_ir = fields.string()?;
+                let js_code = fields.string()?;
+                let count = fields.u32()? as usize;
+                let edges = (0..count).map(|_| fields.u32()).collect::<io::Result<_>>()?;
+                SyncMessage::Entry { hash, program_ir, js_code, edges }
+            }
+            _ => return Err(invalid("unknown frame kind")),
+        };
+        Ok(message)
+    }
+}
+
+fn invalid(message: &str) -> io::Error {
+    io::Error::new(io::ErrorKind::InvalidData, message)
+}
+
+struct FrameReader<'a> {
+    data: &'a [u8],
+}
+
+impl<'a> FrameReader<'a> {
+    fn take(&mut self, length: usize) -> io::Result<&'a [u8]> {
+        if length > self.data.len() {
+            return Err(invalid("truncated frame"));
+        }
+        let (field, rest) = self.data.split_at(length);
+        self.data = rest;
+        Ok(field)
+    }
+
+    fn u32(&mut self) -> io::Result<u32> {
+        Ok(u32::from_le_bytes(self.take(4)?.try_into().unwrap()))
+    }
+
+    fn u64(&mut self) -> io::Result<u64> {
+        Ok(u64::from_le_bytes(self.take(8)?.try_into().unwrap()))
+    }
+
+    fn string(&mut self) -> io::Result<String> {
+        let length = self.u32()? as usize;
+        String::from_utf8(self.take(length)?.to_vec()).map_err(|_| invalid("entry is not UTF-8"))
+    }
+}
+
+/// An entry peers that connect later can be caught up with. The texts point into the corpus arena,
+/// the ENTRY frame is only built when a peer misses the entry.
+struct CatalogEntry {
+    program_ir: &'static str,
+    js_code: &'static str,
+    edges: Box<[u32]>,
+}
+
+/// State shared by the links of a node
+struct SyncShared {
+    fingerprint: u64,
+    // Hashes of every entry this node published or was sent, this is what HAVE lists
+    known: Mutex<HashSet<u64>>,
+    // The known entries whose texts are in the corpus arena, so the arena bounds it as well
+    catalog: Mutex<HashMap<u64, CatalogEntry>>,
+    // Outgoing queues of the open links by link id
+    links: Mutex<HashMap<u64, mpsc::Sender<Arc<SyncMessage>>>>,
+    next_link: AtomicU64,
+    incoming: Mutex<mpsc::Sender<SyncEntry>>,
+}
+
+/// Exchanges new corpus entries with the masters of other nodes over TCP.
+///
+/// Entries are content addressed by entry_hash and carry the edge indices they found, so a node
+/// merges them into its virgin map with cov_merge_edges instead of executing them. On connect
+/// both sides send the hash list of their entries and then only the entries the other one misses.
+/// New entries are not forwarded to third nodes, so every node should list all others as peers.
+/// Peers refuse each other if their coverage_fingerprint differs.
+pub struct SyncService {
+    shared: Arc<SyncShared>,
+    incoming: mpsc::Receiver<SyncEntry>,
+    local_addr: Option<SocketAddr>,
+}
+
+impl SyncService {
+    pub fn start(listen: Option<&str>, peers: &[String], fingerprint: u64) -> io::Result<Self> {
+        let (incoming_tx, incoming) = mpsc::channel();
+        let shared = Arc::new(SyncShared {
+            fingerprint,
+            known: Mutex::new(HashSet::new()),
+            catalog: Mutex::new(HashMap::new()),
+            links: Mutex::new(HashMap::new()),
+            next_link: AtomicU64::new(0),
+            incoming: Mutex::new(incoming_tx),
+        });
+        let mut local_addr = None;
+        if let Some(address) = listen {
+            let listener = TcpListener::bind(address)?;
+            local_addr = Some(listener.local_addr()?);
+            let shared = shared.clone();
+            thread::spawn(move || {
+                for stream in listener.incoming().flatten() {
+                    let shared = shared.clone();
+                    thread::spawn(move || Self::run_link(stream, &shared));
+                }
+            });
+        }
+        for peer in peers {
+            let peer = peer.clone();
+            let shared = shared.clone();
+            thread::spawn(move || loop {
+                if let Ok(stream) = TcpStream::connect(&peer) {
+                    println!("[SYNC] Connected to {}", peer);
+                    Self::run_link(stream, &shared);
+                    println!("[SYNC] Lost connection to {}", peer);
+                }
+                thread::sleep(RECONNECT_INTERVAL);
+            });
+        }
+        Ok(SyncService { shared, incoming, local_addr })
+    }
+
+    /// Address the service listens on, None without a listen address
+    pub fn local_addr(&self) -> Option<SocketAddr> {
+        self.local_addr
+    }
+
+    /// Sends an entry this node found to all peers that do not have it yet
+    pub fn publish(&self, program_ir: &ProgramText, js_code: &ProgramText, edges: &[u32]) {
+        let hash = entry_hash(js_code);
+        if !self.shared.known.lock().unwrap().insert(hash) {
+            return;
+        }
+        self.add_to_catalog(hash, program_ir, js_code, edges);
+        let message = Arc::new(SyncMessage::Entry {
+            hash,
+            program_ir: program_ir.to_string(),
+            js_code: js_code.to_string(),
+            edges: edges.to_vec(),
+        });
+        for link in self.shared.links.lock().unwrap().values() {
+            link.send(message.clone()).ok();
+        }
+    }
+
+    /// Offers an entry a peer sent to the peers that connect later, once it is in the corpus
+    pub fn remember(&self, program_ir: &ProgramText, js_code: &ProgramText, edges: &[u32]) {
+        self.add_to_catalog(entry_hash(js_code), program_ir, js_code, edges);
+    }
+
+    // Entries that did not fit into the corpus arena stay known, but are not offered to later peers
+    fn add_to_catalog(&self, hash: u64, program_ir: &ProgramText, js_code: &ProgramText, edges: &[u32]) {
+        if let (ProgramText::Shared(program_ir), ProgramText::Shared(js_code)) = (program_ir, js_code) {
+            let entry = CatalogEntry { program_ir, js_code, edges: edges.into() };
+            self.shared.catalog.lock().unwrap().insert(hash, entry);
+        }
+    }
+
+    /// Entries the peers sent since the last call, each one only once
+    pub fn poll(&self) -> Vec<SyncEntry> {
+        self.incoming.try_iter().collect()
+    }
+
+    fn run_link(stream: TcpStream, shared: &Arc<SyncShared>) {
+        stream.set_nodelay(true).ok();
+        let Ok(write_stream) = stream.try_clone() else { return };
+        let id = shared.next_link.fetch_add(1, Ordering::Relaxed);
+        // Hashes the peer is known to have, nothing in here is sent to it
+        let peer_known = Arc::new(Mutex::new(HashSet::new()));
+
+        let (tx, rx) = mpsc::channel::<Arc<SyncMessage>>();
+        tx.send(Arc::new(SyncMessage::Hello { version: SYNC_VERSION, fingerprint: shared.fingerprint })).ok();
+        {
+            // Registered together with the hash list so that no entry published in between is missed
+            let known = shared.known.lock().unwrap();
+            tx.send(Arc::new(SyncMessage::Have { hashes: known.iter().copied().collect() })).ok();
+            shared.links.lock().unwrap().insert(id, tx.clone());
+        }
+        let writer = {
+            let peer_known = peer_known.clone();
+            thread::spawn(move || Self::write_link(write_stream, rx, peer_known))
+        };
+
+        if let Err(e) = Self::read_link(&stream, shared, &peer_known, &tx) {
+            if e.kind() != io::ErrorKind::UnexpectedEof {
+                println!("[SYNC] Closing link: {}", e);
+            }
+        }
+        shared.links.lock().unwrap().remove(&id);
+        drop(tx);
+        stream.shutdown(std::net::Shutdown::Both).ok();
+        writer.join().ok();
+    }
+
+    fn write_link(stream: TcpStream, rx: mpsc::Receiver<Arc<SyncMessage>>, peer_known: Arc<Mutex<HashSet<u64>>>) {
+        let mut out = BufWriter::new(stream);
+        while let Ok(first) = rx.recv() {
+            // Everything queued so far goes out in one write
+            let mut next = Some(first);
+            while let Some(message) = next {
+                let skip = match *message {
+                    SyncMessage::Entry { hash, .. } => !peer_known.lock().unwrap().insert(hash),
+                    _ => false,
+                };
+                if !skip && message.write_to(&mut out).is_err() {
+                    return;
+                }
+                next = rx.try_recv().ok();
+            }
+            if out.flush().is_err() {
+                return;
+            }
+        }
+    }
+
+    fn read_link(stream: &TcpStream, shared: &SyncShared, peer_known: &Mutex<HashSet<u64>>, tx: &mpsc::Sender<Arc<SyncMessage>>) -> io::Result<()> {
+        let mut input = BufReader::new(stream);
+        match SyncMessage::read_from(&mut input)? {
+            SyncMessage::Hello { version, fingerprint } if version == SYNC_VERSION && fingerprint == shared.fingerprint => {}
+            SyncMessage::Hello { .. } => return Err(invalid("peer runs a different engine build or protocol version")),
+            _ => return Err(invalid("expected hello")),
+        }
+        loop {
+            match SyncMessage::read_from(&mut input)? {
+                SyncMessage::Have { hashes } => {
+                    peer_known.lock().unwrap().extend(hashes);
+                    // Catch the peer up, the writer drops whatever it turns out to have
+                    let peer_known = peer_known.lock().unwrap();
+                    for (&hash, entry) in shared.catalog.lock().unwrap().iter() {
+                        if !peer_known.contains(&hash) {
+                            tx.send(Arc::new(SyncMessage::Entry {
+                                hash,
+                                program_ir: entry.program_ir.to_string(),
+                                js_code: entry.js_code.to_string(),
+                                edges: entry.edges.to_vec(),
+                            })).ok();
+                        }
+                    }
+                }
+                SyncMessage::Entry { hash, program_ir, js_code, edges } => {
+                    if entry_hash(&js_code) != hash {
+                        return Err(invalid("entry does not match its hash"));
+                    }
+                    peer_known.lock().unwrap().insert(hash);
+                    if shared.known.lock().unwrap().insert(hash) {
+                        shared.incoming.lock().unwrap().send(SyncEntry { program_ir, js_code, edges }).ok();
+                    }
+                }
+                SyncMessage::Hello { .. } => return Err(invalid("unexpected hello")),
+            }
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::time::Instant;
+
+    fn wait_for(service: &SyncService, count: usize) -> Vec<SyncEntry> {
+        let start = Instant::now();
+        let mut entries = Vec::new();
+        while entries.len() < count && start.elapsed() < Duration::from_secs(5) {
+            entries.extend(service.poll());
+            thread::sleep(Duration::from_millis(10));
+        }
+        entries
+    }
+
+    fn publish(service: &SyncService, program_ir: &str, js_code: &str, edges: &[u32]) {
+        let (program_ir, js_code) = ProgramText::intern(program_ir.to_string(), js_code.to_string());
+        service.publish(&program_ir, &js_code, edges);
+    }
+
+    #[test]
+    fn test_sync_exchanges_each_entry_once() {
+        let a = SyncService::start(Some("127.0.0.1:0"), &[], 7).unwrap();
+        publish(&a, "{}", "var a = 1;", &[1, 2, 3]);
+        let b = SyncService::start(None, &[a.local_addr().unwrap().to_string()], 7).unwrap();
+        // Known before the link existed, sent after the hash lists were exchanged
+        let entries = wait_for(&b, 1);
+        assert_eq!(entries.len(), 1);
+        assert_eq!(entries[0].js_code, "var a = 1;");
+        assert_eq!(entries[0].edges, vec![1, 2, 3]);
+
+        publish(&b, "", "var b = 2;", &[4]);
+        publish(&b, "", "var a = 1;", &[1]);
+        publish(&a, "{}", "var a = 1;", &[1, 2, 3]);
+        let entries = wait_for(&a, 1);
+        assert_eq!(entries.len(), 1);
+        assert_eq!(entries[0].js_code, "var b = 2;");
+        thread::sleep(Duration::from_millis(200));
+        assert!(a.poll().is_empty());
+        assert!(b.poll().is_empty());
+    }
+
+    #[test]
+    fn test_sync_refuses_other_fingerprint() {
+        let a = SyncService::start(Some("127.0.0.1:0"), &[], 1).unwrap();
+        publish(&a, "", "var a = 1;", &[1]);
+        let b = SyncService::start(None, &[a.local_addr().unwrap().to_string()], 2).unwrap();
+        thread::sleep(Duration::from_millis(300));
+        assert!(b.poll().is_empty());
+    }
+
+    #[test]
+    fn test_frame_round_trip() {
+        let mut buffer = Vec::new();
+        SyncMessage::Entry { hash: entry_hash("x"), program_ir: "ir".into(), js_code: "x".into(), edges: vec![9, 10] }.write_to(&mut buffer).unwrap();
+        match SyncMessage::read_from(&mut buffer.as_slice()).unwrap() {
+            SyncMessage::Entry { hash, program_ir, js_code, edges } => {
+                assert_eq!((hash, program_ir.as_str(), js_code.as_str(), edges), (entry_hash("x"), "ir", "x", vec![9, 10]));
+            }
+            _ => panic!("wrong kind"),
+        }
+        // Truncated frames are rejected
+        assert!(SyncMessage::read_from(&mut &buffer[..buffer.len() - 1]).is_err());
+    }
+}